@@ -77,10 +77,10 @@
  * Enabled for clang & gcc >=4.8 on x86 when BMI2 isn't enabled by default.
  */
 #ifndef DYNAMIC_BMI2
-  #if (defined(__clang__) && __has_attribute(__target__)) \
+  #if ((defined(__clang__) && __has_attribute(__target__)) \
       || (defined(__GNUC__) \
-          && (__GNUC__ >= 5 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 8))) \
-      && (defined(__x86_64__) || defined(_M_X86)) \
+          && (__GNUC__ >= 5 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 8)))) \
+      && (defined(__x86_64__) || defined(_M_X64)) \
       && !defined(__BMI2__)
   #  define DYNAMIC_BMI2 1
   #else
@@ -88,6 +88,51 @@
   #endif
 #endif
 
+/* Enable runtime AVX2 dispatch, like BMI2 but from gcc 4.9, the first version
+ * whose immintrin.h declares AVX2 intrinsics without -mavx2.
+ * AVX2 variants are compiled for BMI2 too, and only selected on CPUs with both.
+ */
+#ifndef DYNAMIC_AVX2
+  #if ((defined(__clang__) && __has_attribute(__target__)) \
+      || (defined(__GNUC__) \
+          && (__GNUC__ >= 5 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))) \
+      && (defined(__x86_64__) || defined(_M_X64)) \
+      && !defined(__AVX2__)
+  #  define DYNAMIC_AVX2 1
+  #else
+  #  define DYNAMIC_AVX2 0
+  #endif
+#endif
+
+/* AVX-512BW variants need gcc 5 or later */
+#ifndef DYNAMIC_AVX512
+  #if DYNAMIC_AVX2 && (defined(__clang__) || __GNUC__ >= 5)
+  #  define DYNAMIC_AVX512 1
+  #else
+  #  define DYNAMIC_AVX512 0
+  #endif
+#endif
+
+/* Dispatch tables indexed by ZSTD1_cpuImpl_e (zstd.h) : fn##_default always
+ * exists, fn##_bmi2 and fn##_avx2 only when runtime dispatch is enabled.
+ * Tiers without their own variant use the next lower one. */
+#if DYNAMIC_BMI2
+#  define BMI2_VARIANT(fn) fn##_bmi2
+#else
+#  define BMI2_VARIANT(fn) fn##_default
+#endif
+#if DYNAMIC_AVX2
+#  define AVX2_VARIANT(fn) fn##_avx2
+#else
+#  define AVX2_VARIANT(fn) BMI2_VARIANT(fn)
+#endif
+#define CPU_IMPL_TABLE(fn) { \
+    fn##_default,      /* ZSTD1_cpu_auto, resolved before use */ \
+    fn##_default,      /* ZSTD1_cpu_generic */ \
+    BMI2_VARIANT(fn),  /* ZSTD1_cpu_bmi2 */ \
+    AVX2_VARIANT(fn),  /* ZSTD1_cpu_avx2 */ \
+    AVX2_VARIANT(fn)   /* ZSTD1_cpu_avx512 */ }
+
 /* prefetch */
 #if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_I86))  /* _mm_prefetch() is not defined outside of x86/x64 */
 #  include <mmintrin.h>   /* https://msdn.microsoft.com/fr-fr/library/84szxsww(v=vs.90).aspx */
@@ -43,7 +43,6 @@
 /*-*************************************
 *  Console display
 ***************************************/
-static int g_displayLevel = 2;
 #define DISPLAY(...)                                                           \
   {                                                                            \
     fprintf(stderr, __VA_ARGS__);                                              \
@@ -53,7 +52,9 @@ static int g_displayLevel = 2;
   if (displayLevel >= l) {                                                     \
     DISPLAY(__VA_ARGS__);                                                      \
   } /* 0 : no display;   1: errors;   2: default;  3: details;  4: debug */
-#define DISPLAYLEVEL(l, ...) LOCALDISPLAYLEVEL(g_displayLevel, l, __VA_ARGS__)
+/* Training may run on several threads at once : the level is a local
+ * `displayLevel` of the calling function rather than a global */
+#define DISPLAYLEVEL(l, ...) LOCALDISPLAYLEVEL(displayLevel, l, __VA_ARGS__)
 
 #define LOCALDISPLAYUPDATE(displayLevel, l, ...)                               \
   if (displayLevel >= l) {                                                     \
@@ -62,7 +63,7 @@ static int g_displayLevel = 2;
       DISPLAY(__VA_ARGS__);                                                    \
     }                                                                          \
   }
-#define DISPLAYUPDATE(l, ...) LOCALDISPLAYUPDATE(g_displayLevel, l, __VA_ARGS__)
+#define DISPLAYUPDATE(l, ...) LOCALDISPLAYUPDATE(displayLevel, l, __VA_ARGS__)
 static const clock_t refreshRate = CLOCKS_PER_SEC * 15 / 100;
 static clock_t g_time = 0;
 
@@ -210,9 +211,6 @@ typedef struct {
   unsigned d;
 } COVER_ctx_t;
 
-/* We need a global context for qsort... */
-static COVER_ctx_t *g_ctx = NULL;
-
 /*-*************************************
 *  Helper functions
 ***************************************/
@@ -252,27 +250,241 @@ static int COVER_cmp8(COVER_ctx_t *ctx, const void *lp, const void *rp) {
   return (lhs > rhs);
 }
 
+/*-*************************************
+*  Suffix sort
+***************************************
+* Suffixes are sorted by their first d bytes, then by position, so that each
+* dmer group is sorted by position in input.  The context is passed along
+* rather than through a global as qsort() would need, so that several
+* trainings can run at once, and large arrays are sorted on a pool.
+*/
+
+/* Ranges up to this size are insertion sorted */
+#define COVER_SORT_INSERTION 16
+/* Arrays below this size are not worth sorting on a pool */
+#define COVER_SORT_PARALLEL_MIN (1 << 16)
+
 /**
- * Same as COVER_cmp() except ties are broken by pointer value
- * NOTE: g_ctx must be set to call this function.  A global is required because
- * qsort doesn't take an opaque pointer.
+ * Returns whether the suffix at l sorts before the suffix at r.
+ * `d8` selects COVER_cmp8(), rather than calling through a pointer.
  */
-static int COVER_strict_cmp(const void *lp, const void *rp) {
-  int result = COVER_cmp(g_ctx, lp, rp);
-  if (result == 0) {
-    result = lp < rp ? -1 : 1;
+MEM_STATIC int COVER_less(COVER_ctx_t *ctx, int d8, const U32 *l,
+                          const U32 *r) {
+  const int result = d8 ? COVER_cmp8(ctx, l, r) : COVER_cmp(ctx, l, r);
+  return result < 0 || (result == 0 && *l < *r);
+}
+
+static void COVER_swap(U32 *l, U32 *r) {
+  const U32 tmp = *l;
+  *l = *r;
+  *r = tmp;
+}
+
+static void COVER_insertionSort(COVER_ctx_t *ctx, int d8,
+                                U32 *suffix, size_t n) {
+  size_t i;
+  for (i = 1; i < n; ++i) {
+    const U32 value = suffix[i];
+    size_t j = i;
+    while (j > 0 && COVER_less(ctx, d8, &value, &suffix[j - 1])) {
+      suffix[j] = suffix[j - 1];
+      --j;
+    }
+    suffix[j] = value;
+  }
+}
+
+static void COVER_siftDown(COVER_ctx_t *ctx, int d8, U32 *suffix,
+                           size_t root, size_t n) {
+  for (;;) {
+    size_t child = 2 * root + 1;
+    if (child >= n) {
+      return;
+    }
+    if (child + 1 < n &&
+        COVER_less(ctx, d8, &suffix[child], &suffix[child + 1])) {
+      ++child;
+    }
+    if (!COVER_less(ctx, d8, &suffix[root], &suffix[child])) {
+      return;
+    }
+    COVER_swap(&suffix[root], &suffix[child]);
+    root = child;
+  }
+}
+
+static void COVER_heapSort(COVER_ctx_t *ctx, int d8, U32 *suffix,
+                           size_t n) {
+  size_t i;
+  for (i = n / 2; i-- > 0;) {
+    COVER_siftDown(ctx, d8, suffix, i, n);
+  }
+  for (i = n; i-- > 1;) {
+    COVER_swap(&suffix[0], &suffix[i]);
+    COVER_siftDown(ctx, d8, suffix, 0, i);
   }
-  return result;
 }
+
 /**
- * Faster version for d <= 8.
+ * Partitions suffix, of more than 3 elements, around the median of its first,
+ * middle and last elements and returns the final position of that pivot.
+ * Suffixes never compare equal since ties are broken by position.
  */
-static int COVER_strict_cmp8(const void *lp, const void *rp) {
-  int result = COVER_cmp8(g_ctx, lp, rp);
-  if (result == 0) {
-    result = lp < rp ? -1 : 1;
+static size_t COVER_partition(COVER_ctx_t *ctx, int d8, U32 *suffix,
+                              size_t n) {
+  const size_t mid = n / 2;
+  size_t i = 0;
+  size_t j = n - 2;
+  U32 pivot;
+  if (COVER_less(ctx, d8, &suffix[mid], &suffix[0])) {
+    COVER_swap(&suffix[mid], &suffix[0]);
   }
-  return result;
+  if (COVER_less(ctx, d8, &suffix[n - 1], &suffix[mid])) {
+    COVER_swap(&suffix[n - 1], &suffix[mid]);
+    if (COVER_less(ctx, d8, &suffix[mid], &suffix[0])) {
+      COVER_swap(&suffix[mid], &suffix[0]);
+    }
+  }
+  /* suffix[0] and suffix[n - 1] now stop the scans below */
+  COVER_swap(&suffix[mid], &suffix[n - 2]);
+  pivot = suffix[n - 2];
+  for (;;) {
+    while (COVER_less(ctx, d8, &suffix[++i], &pivot)) {
+    }
+    while (COVER_less(ctx, d8, &pivot, &suffix[--j])) {
+    }
+    if (i >= j) {
+      break;
+    }
+    COVER_swap(&suffix[i], &suffix[j]);
+  }
+  COVER_swap(&suffix[i], &suffix[n - 2]);
+  return i;
+}
+
+/**
+ * Introsort: quicksort falling back to heapsort after `depth` partitions, so
+ * that it stays O(n log n) whatever the input.
+ */
+static void COVER_introSort(COVER_ctx_t *ctx, int d8, U32 *suffix,
+                            size_t n, unsigned depth) {
+  while (n > COVER_SORT_INSERTION) {
+    size_t p;
+    if (depth == 0) {
+      COVER_heapSort(ctx, d8, suffix, n);
+      return;
+    }
+    --depth;
+    p = COVER_partition(ctx, d8, suffix, n);
+    /* Recurse into the smaller side and loop on the larger one */
+    if (p < n - p - 1) {
+      COVER_introSort(ctx, d8, suffix, p, depth);
+      suffix += p + 1;
+      n -= p + 1;
+    } else {
+      COVER_introSort(ctx, d8, suffix + p + 1, n - p - 1, depth);
+      n = p;
+    }
+  }
+  COVER_insertionSort(ctx, d8, suffix, n);
+}
+
+/**
+ * Counts the sort jobs running on a pool.
+ */
+typedef struct {
+  ZSTD1_pthread_mutex_t mutex;
+  ZSTD1_pthread_cond_t cond;
+  size_t liveJobs;
+} COVER_sortGroup_t;
+
+typedef struct {
+  COVER_ctx_t *ctx;
+  int d8;
+  U32 *suffix;
+  size_t n;
+  unsigned depth;
+  COVER_sortGroup_t *group;
+} COVER_sortJob_t;
+
+/**
+ * Sorts a range on a pool thread.  Takes ownership of its argument.
+ */
+static void COVER_sortJob(void *opaque) {
+  COVER_sortJob_t *const job = (COVER_sortJob_t *)opaque;
+  COVER_sortGroup_t *const group = job->group;
+  COVER_introSort(job->ctx, job->d8, job->suffix, job->n, job->depth);
+  free(job);
+  ZSTD1_pthread_mutex_lock(&group->mutex);
+  if (--group->liveJobs == 0) {
+    ZSTD1_pthread_cond_broadcast(&group->cond);
+  }
+  ZSTD1_pthread_mutex_unlock(&group->mutex);
+}
+
+/**
+ * Partitions suffix until the ranges are at most `chunk` long, and sorts them
+ * on the pool.
+ */
+static void COVER_parallelSort(COVER_ctx_t *ctx, int d8, U32 *suffix,
+                               size_t n, unsigned depth, POOL_ctx *pool,
+                               COVER_sortGroup_t *group, size_t chunk) {
+  COVER_sortJob_t *job;
+  while (n > chunk && depth > 0) {
+    const size_t p = COVER_partition(ctx, d8, suffix, n);
+    --depth;
+    if (p < n - p - 1) {
+      COVER_parallelSort(ctx, d8, suffix, p, depth, pool, group, chunk);
+      suffix += p + 1;
+      n -= p + 1;
+    } else {
+      COVER_parallelSort(ctx, d8, suffix + p + 1, n - p - 1, depth, pool,
+                         group, chunk);
+      n = p;
+    }
+  }
+  job = (COVER_sortJob_t *)malloc(sizeof(COVER_sortJob_t));
+  if (!job) {
+    COVER_introSort(ctx, d8, suffix, n, depth);
+    return;
+  }
+  job->ctx = ctx;
+  job->d8 = d8;
+  job->suffix = suffix;
+  job->n = n;
+  job->depth = depth;
+  job->group = group;
+  ZSTD1_pthread_mutex_lock(&group->mutex);
+  ++group->liveJobs;
+  ZSTD1_pthread_mutex_unlock(&group->mutex);
+  POOL_add(pool, &COVER_sortJob, job);
+}
+
+/**
+ * Sorts ctx->suffix, on `pool` if it is not NULL.
+ */
+static void COVER_sort(COVER_ctx_t *ctx, POOL_ctx *pool, unsigned nbThreads) {
+  const int d8 = ctx->d <= 8;
+  const size_t n = ctx->suffixSize;
+  const unsigned depth = 2 * (ZSTD1_highbit32((U32)n) + 1);
+  COVER_sortGroup_t group;
+  if (!pool || nbThreads <= 1 || n < COVER_SORT_PARALLEL_MIN) {
+    COVER_introSort(ctx, d8, ctx->suffix, n, depth);
+    return;
+  }
+  (void)ZSTD1_pthread_mutex_init(&group.mutex, NULL);
+  (void)ZSTD1_pthread_cond_init(&group.cond, NULL);
+  group.liveJobs = 0;
+  /* A few ranges per thread balance the uneven partitions */
+  COVER_parallelSort(ctx, d8, ctx->suffix, n, depth, pool, &group,
+                     MAX(n / (4 * nbThreads), COVER_SORT_PARALLEL_MIN));
+  ZSTD1_pthread_mutex_lock(&group.mutex);
+  while (group.liveJobs != 0) {
+    ZSTD1_pthread_cond_wait(&group.cond, &group.mutex);
+  }
+  ZSTD1_pthread_mutex_unlock(&group.mutex);
+  ZSTD1_pthread_mutex_destroy(&group.mutex);
+  ZSTD1_pthread_cond_destroy(&group.cond);
 }
 
 /**
@@ -526,12 +738,14 @@ static void COVER_ctx_destroy(COVER_ctx_t *ctx) {
  * Prepare a context for dictionary building.
  * The context is only dependent on the parameter `d` and can used multiple
  * times.
+ * The suffix array is sorted on `pool` if it is not NULL.
  * Returns 1 on success or zero on error.
  * The context must be destroyed with `COVER_ctx_destroy()`.
  */
 static int COVER_ctx_init(COVER_ctx_t *ctx, const void *samplesBuffer,
                           const size_t *samplesSizes, unsigned nbSamples,
-                          unsigned d) {
+                          unsigned d, POOL_ctx *pool, unsigned nbThreads,
+                          int displayLevel) {
   const BYTE *const samples = (const BYTE *)samplesBuffer;
   const size_t totalSamplesSize = COVER_sum(samplesSizes, nbSamples);
   /* Checks */
@@ -581,10 +795,7 @@ static int COVER_ctx_init(COVER_ctx_t *ctx, const void *samplesBuffer,
     for (i = 0; i < ctx->suffixSize; ++i) {
       ctx->suffix[i] = i;
     }
-    /* qsort doesn't take an opaque pointer, so pass as a global */
-    g_ctx = ctx;
-    qsort(ctx->suffix, ctx->suffixSize, sizeof(U32),
-          (ctx->d <= 8 ? &COVER_strict_cmp8 : &COVER_strict_cmp));
+    COVER_sort(ctx, pool, nbThreads);
   }
   DISPLAYLEVEL(2, "Computing frequencies\n");
   /* For each dmer group (group of positions with the same first d bytes):
@@ -609,6 +820,7 @@ static size_t COVER_buildDictionary(const COVER_ctx_t *ctx, U32 *freqs,
                                     size_t dictBufferCapacity,
                                     ZDICT_cover_params_t parameters) {
   BYTE *const dict = (BYTE *)dictBuffer;
+  const int displayLevel = parameters.zParams.notificationLevel;
   size_t tail = dictBufferCapacity;
   /* Divide the data up into epochs of equal size.
    * We will select at least one segment from each epoch.
@@ -656,11 +868,11 @@ ZDICTLIB_API size_t ZDICT_trainFromBuffer_cover(
     ZDICT_cover_params_t parameters)
 {
   BYTE* const dict = (BYTE*)dictBuffer;
+  const int displayLevel = parameters.zParams.notificationLevel;
   COVER_ctx_t ctx;
   COVER_map_t activeDmers;
+  POOL_ctx *pool = NULL;
 
-  /* Initialize global data */
-  g_displayLevel = parameters.zParams.notificationLevel;
   /* Checks */
   if (!COVER_checkParameters(parameters, dictBufferCapacity)) {
     DISPLAYLEVEL(1, "Cover parameters incorrect\n");
@@ -675,10 +887,18 @@ ZDICTLIB_API size_t ZDICT_trainFromBuffer_cover(
                  ZDICT_DICTSIZE_MIN);
     return ERROR(dstSize_tooSmall);
   }
-  /* Initialize context and activeDmers */
-  if (!COVER_ctx_init(&ctx, samplesBuffer, samplesSizes, nbSamples,
-                      parameters.d)) {
-    return ERROR(GENERIC);
+  /* Initialize context and activeDmers, sorting on nbThreads threads */
+  if (parameters.nbThreads > 1) {
+    pool = POOL_create(parameters.nbThreads, 1);
+  }
+  {
+    const int initialized = COVER_ctx_init(&ctx, samplesBuffer, samplesSizes,
+                                           nbSamples, parameters.d, pool,
+                                           parameters.nbThreads, displayLevel);
+    POOL_free(pool);
+    if (!initialized) {
+      return ERROR(GENERIC);
+    }
   }
   if (!COVER_map_init(&activeDmers, parameters.k - parameters.d + 1)) {
     DISPLAYLEVEL(1, "Failed to allocate dmer map: out of memory\n");
@@ -829,8 +1049,40 @@ typedef struct COVER_tryParameters_data_s {
   COVER_best_t *best;
   size_t dictBufferCapacity;
   ZDICT_cover_params_t parameters;
+  ZDICT_cover_control_t *control;
 } COVER_tryParameters_data_t;
 
+/* The control fields may be accessed by another thread during training */
+#define COVER_CONTROL_LOAD(control, field)                                     \
+  ((control) ? __atomic_load_n(&(control)->field, __ATOMIC_SEQ_CST) : 0)
+#define COVER_CONTROL_STORE(control, field, value)                             \
+  if (control) {                                                               \
+    __atomic_store_n(&(control)->field, (value), __ATOMIC_SEQ_CST);            \
+  }
+
+/**
+ * Returns the memory used by COVER_ctx_init(), shared by the trials.
+ */
+static size_t COVER_ctxMemory(size_t totalSamplesSize, unsigned nbSamples) {
+  /* suffix, becoming freqs, and dmerAt */
+  return 2 * totalSamplesSize * sizeof(U32) + (nbSamples + 1) * sizeof(size_t);
+}
+
+/**
+ * Returns the memory allocated by one COVER_tryParameters() job.
+ */
+static size_t COVER_trialMemory(size_t totalSamplesSize, size_t maxSampleSize,
+                                size_t dictBufferCapacity, unsigned k,
+                                unsigned d, int compressionLevel) {
+  const size_t mapSize = (size_t)1 << (ZSTD1_highbit32(k - d + 1) + 2);
+  const ZSTD1_compressionParameters cParams =
+      ZSTD1_getCParams(compressionLevel, maxSampleSize, dictBufferCapacity);
+  return totalSamplesSize * sizeof(U32) + mapSize * sizeof(COVER_map_pair_t) +
+         dictBufferCapacity + ZSTD1_compressBound(maxSampleSize) +
+         ZSTD1_estimateCCtxSize_usingCParams(cParams) +
+         ZSTD1_estimateCDictSize(dictBufferCapacity, compressionLevel);
+}
+
 /**
  * Tries a set of parameters and upates the COVER_best_t with the results.
  * This function is thread safe if zstd is compiled with multithreaded support.
@@ -841,12 +1093,20 @@ static void COVER_tryParameters(void *opaque) {
   COVER_tryParameters_data_t *const data = (COVER_tryParameters_data_t *)opaque;
   const COVER_ctx_t *const ctx = data->ctx;
   const ZDICT_cover_params_t parameters = data->parameters;
+  const int displayLevel = parameters.zParams.notificationLevel;
   size_t dictBufferCapacity = data->dictBufferCapacity;
+  ZDICT_cover_control_t *const control = data->control;
   size_t totalCompressedSize = ERROR(GENERIC);
   /* Allocate space for hash table, dict, and freqs */
   COVER_map_t activeDmers;
-  BYTE *const dict = (BYTE * const)malloc(dictBufferCapacity);
-  U32 *freqs = (U32 *)malloc(ctx->suffixSize * sizeof(U32));
+  BYTE *dict = NULL;
+  U32 *freqs = NULL;
+  memset(&activeDmers, 0, sizeof(activeDmers));
+  if (COVER_CONTROL_LOAD(control, stop)) {
+    goto _cleanup;
+  }
+  dict = (BYTE *)malloc(dictBufferCapacity);
+  freqs = (U32 *)malloc(ctx->suffixSize * sizeof(U32));
   if (!COVER_map_init(&activeDmers, parameters.k - parameters.d + 1)) {
     DISPLAYLEVEL(1, "Failed to allocate dmer map: out of memory\n");
     goto _cleanup;
@@ -919,6 +1179,9 @@ _cleanup:
   COVER_best_finish(data->best, totalCompressedSize, parameters, dict,
                     dictBufferCapacity);
   free(data);
+  if (control) {
+    __atomic_fetch_add(&control->completed, 1, __ATOMIC_SEQ_CST);
+  }
   COVER_map_destroy(&activeDmers);
   if (dict) {
     free(dict);
@@ -932,8 +1195,17 @@ ZDICTLIB_API size_t ZDICT_optimizeTrainFromBuffer_cover(
     void *dictBuffer, size_t dictBufferCapacity, const void *samplesBuffer,
     const size_t *samplesSizes, unsigned nbSamples,
     ZDICT_cover_params_t *parameters) {
+  return ZDICT_optimizeTrainFromBuffer_cover_control(
+      dictBuffer, dictBufferCapacity, samplesBuffer, samplesSizes, nbSamples,
+      parameters, NULL);
+}
+
+ZDICTLIB_API size_t ZDICT_optimizeTrainFromBuffer_cover_control(
+    void *dictBuffer, size_t dictBufferCapacity, const void *samplesBuffer,
+    const size_t *samplesSizes, unsigned nbSamples,
+    ZDICT_cover_params_t *parameters, ZDICT_cover_control_t *control) {
   /* constants */
-  const unsigned nbThreads = parameters->nbThreads;
+  unsigned nbThreads = parameters->nbThreads;
   const unsigned kMinD = parameters->d == 0 ? 6 : parameters->d;
   const unsigned kMaxD = parameters->d == 0 ? 8 : parameters->d;
   const unsigned kMinK = parameters->k == 0 ? 50 : parameters->k;
@@ -944,6 +1216,9 @@ ZDICTLIB_API size_t ZDICT_optimizeTrainFromBuffer_cover(
       (1 + (kMaxD - kMinD) / 2) * (1 + (kMaxK - kMinK) / kStepSize);
   /* Local variables */
   const int displayLevel = parameters->zParams.notificationLevel;
+  /* Turn down the display level of the trials to clean up display at level 2
+   * and below */
+  const int trialDisplayLevel = displayLevel == 0 ? 0 : displayLevel - 1;
   unsigned iteration = 1;
   unsigned d;
   unsigned k;
@@ -964,6 +1239,28 @@ ZDICTLIB_API size_t ZDICT_optimizeTrainFromBuffer_cover(
                  ZDICT_DICTSIZE_MIN);
     return ERROR(dstSize_tooSmall);
   }
+  /* Lower the number of threads until the trials fit in the budget */
+  if (control && control->maxMemory > 0 && nbThreads > 1) {
+    const size_t totalSamplesSize = COVER_sum(samplesSizes, nbSamples);
+    const size_t ctxMemory = COVER_ctxMemory(totalSamplesSize, nbSamples);
+    size_t maxSampleSize = 0;
+    size_t trialMemory;
+    unsigned i;
+    for (i = 0; i < nbSamples; ++i) {
+      maxSampleSize = MAX(samplesSizes[i], maxSampleSize);
+    }
+    trialMemory = COVER_trialMemory(totalSamplesSize, maxSampleSize,
+                                    dictBufferCapacity, kMaxK, kMinD,
+                                    parameters->zParams.compressionLevel);
+    if (control->maxMemory < ctxMemory + nbThreads * trialMemory) {
+      const size_t fit = control->maxMemory > ctxMemory
+                             ? (control->maxMemory - ctxMemory) / trialMemory
+                             : 0;
+      nbThreads = (unsigned)MAX(fit, 1);
+    }
+  }
+  COVER_CONTROL_STORE(control, threads, MAX(nbThreads, 1));
+  COVER_CONTROL_STORE(control, total, kIterations);
   if (nbThreads > 1) {
     pool = POOL_create(nbThreads, 1);
     if (!pool) {
@@ -972,8 +1269,6 @@ ZDICTLIB_API size_t ZDICT_optimizeTrainFromBuffer_cover(
   }
   /* Initialization */
   COVER_best_init(&best);
-  /* Turn down global display level to clean up display at level 2 and below */
-  g_displayLevel = displayLevel == 0 ? 0 : displayLevel - 1;
   /* Loop through d first because each new value needs a new context */
   LOCALDISPLAYLEVEL(displayLevel, 2, "Trying %u different sets of parameters\n",
                     kIterations);
@@ -981,14 +1276,16 @@ ZDICTLIB_API size_t ZDICT_optimizeTrainFromBuffer_cover(
     /* Initialize the context for this value of d */
     COVER_ctx_t ctx;
     LOCALDISPLAYLEVEL(displayLevel, 3, "d=%u\n", d);
-    if (!COVER_ctx_init(&ctx, samplesBuffer, samplesSizes, nbSamples, d)) {
+    if (!COVER_ctx_init(&ctx, samplesBuffer, samplesSizes, nbSamples, d, pool,
+                        nbThreads, trialDisplayLevel)) {
       LOCALDISPLAYLEVEL(displayLevel, 1, "Failed to initialize context\n");
       COVER_best_destroy(&best);
       POOL_free(pool);
       return ERROR(GENERIC);
     }
     /* Loop through k reusing the same context */
-    for (k = kMinK; k <= kMaxK; k += kStepSize) {
+    for (k = kMinK; k <= kMaxK && !COVER_CONTROL_LOAD(control, stop);
+         k += kStepSize) {
       /* Prepare the arguments */
       COVER_tryParameters_data_t *data = (COVER_tryParameters_data_t *)malloc(
           sizeof(COVER_tryParameters_data_t));
@@ -1007,11 +1304,15 @@ ZDICTLIB_API size_t ZDICT_optimizeTrainFromBuffer_cover(
       data->parameters.k = k;
       data->parameters.d = d;
       data->parameters.steps = kSteps;
-      data->parameters.zParams.notificationLevel = g_displayLevel;
+      data->parameters.zParams.notificationLevel = trialDisplayLevel;
+      data->control = control;
       /* Check the parameters */
       if (!COVER_checkParameters(data->parameters, dictBufferCapacity)) {
-        DISPLAYLEVEL(1, "Cover parameters incorrect\n");
+        LOCALDISPLAYLEVEL(trialDisplayLevel, 1, "Cover parameters incorrect\n");
         free(data);
+        if (control) {
+          __atomic_fetch_add(&control->completed, 1, __ATOMIC_SEQ_CST);
+        }
         continue;
       }
       /* Call the function and pass ownership of data to it */
@@ -1028,6 +1329,11 @@ ZDICTLIB_API size_t ZDICT_optimizeTrainFromBuffer_cover(
     }
     COVER_best_wait(&best);
     COVER_ctx_destroy(&ctx);
+    if (COVER_CONTROL_LOAD(control, stop)) {
+      COVER_best_destroy(&best);
+      POOL_free(pool);
+      return ERROR(GENERIC);
+    }
   }
   LOCALDISPLAYLEVEL(displayLevel, 2, "\r%79s\r", "");
   /* Fill the output buffer and parameters with output of the best parameters */
@@ -1046,3 +1352,256 @@ ZDICTLIB_API size_t ZDICT_optimizeTrainFromBuffer_cover(
     return dictSize;
   }
 }
+
+/*-*************************************
+*  Incremental training
+***************************************
+* COVER's frequencies are indexed by position in the samples, so they are
+* rebuilt from scratch with every set of samples.  The cover state instead
+* counts dmers by hash, which can be updated with new samples as they come,
+* and aged so that old samples weigh less.  Dictionaries are then built from
+* those frequencies, picking segments from a (smaller) set of samples.
+*/
+
+struct ZDICT_cover_state_s {
+  unsigned d;
+  unsigned hashLog;
+  U32 *freqs;
+};
+
+/**
+ * Returns the hash of the dmer at p, which must be readable for 8 bytes.
+ */
+static U32 COVER_hashDmer(const BYTE *p, unsigned d, unsigned hashLog) {
+  const U64 mask = (d == 8) ? (U64)-1 : (((U64)1 << (8 * d)) - 1);
+  return (U32)(((MEM_readLE64(p) & mask) * 0xCF1BBCDCB7A56463ULL) >>
+               (64 - hashLog));
+}
+
+/**
+ * Returns the number of dmers hashed in a sample of `size` bytes.
+ */
+static size_t COVER_nbHashedDmers(size_t size) {
+  return size < sizeof(U64) ? 0 : size - sizeof(U64) + 1;
+}
+
+ZDICTLIB_API ZDICT_cover_state_t *ZDICT_createCoverState(unsigned d,
+                                                        unsigned hashLog) {
+  ZDICT_cover_state_t *state;
+  if (d < ZDICT_COVER_STATE_DMIN || d > ZDICT_COVER_STATE_DMAX ||
+      hashLog < ZDICT_COVER_STATE_HASHLOG_MIN ||
+      hashLog > ZDICT_COVER_STATE_HASHLOG_MAX) {
+    return NULL;
+  }
+  state = (ZDICT_cover_state_t *)malloc(sizeof(ZDICT_cover_state_t));
+  if (!state) {
+    return NULL;
+  }
+  state->d = d;
+  state->hashLog = hashLog;
+  state->freqs = (U32 *)calloc((size_t)1 << hashLog, sizeof(U32));
+  if (!state->freqs) {
+    free(state);
+    return NULL;
+  }
+  return state;
+}
+
+ZDICTLIB_API void ZDICT_freeCoverState(ZDICT_cover_state_t *state) {
+  if (!state) {
+    return;
+  }
+  free(state->freqs);
+  free(state);
+}
+
+ZDICTLIB_API void ZDICT_coverState_update(ZDICT_cover_state_t *state,
+                                          const void *samplesBuffer,
+                                          const size_t *samplesSizes,
+                                          unsigned nbSamples) {
+  const BYTE *sample = (const BYTE *)samplesBuffer;
+  unsigned i;
+  for (i = 0; i < nbSamples; ++i) {
+    const size_t nbDmers = COVER_nbHashedDmers(samplesSizes[i]);
+    size_t pos;
+    for (pos = 0; pos < nbDmers; ++pos) {
+      U32 *const freq =
+          &state->freqs[COVER_hashDmer(sample + pos, state->d, state->hashLog)];
+      if (*freq != (U32)-1) {
+        ++*freq;
+      }
+    }
+    sample += samplesSizes[i];
+  }
+}
+
+ZDICTLIB_API void ZDICT_coverState_age(ZDICT_cover_state_t *state) {
+  const size_t size = (size_t)1 << state->hashLog;
+  size_t i;
+  for (i = 0; i < size; ++i) {
+    state->freqs[i] >>= 1;
+  }
+}
+
+/**
+ * Same as COVER_selectSegment(), on hashed dmers: `dmerAt` holds the hash of
+ * the dmer at every position, and `activeDmers` counts the occurrences of
+ * every hash in the active segment.  It must be all zero, and is left so.
+ */
+static COVER_segment_t COVER_selectHashedSegment(const U32 *dmerAt, U32 *freqs,
+                                                 U32 *activeDmers, U32 begin,
+                                                 U32 end, U32 k, U32 d) {
+  const U32 dmersInK = k - d + 1;
+  COVER_segment_t bestSegment = {0, 0, 0};
+  COVER_segment_t activeSegment;
+  activeSegment.begin = begin;
+  activeSegment.end = begin;
+  activeSegment.score = 0;
+  while (activeSegment.end < end) {
+    const U32 newDmer = dmerAt[activeSegment.end];
+    if (activeDmers[newDmer] == 0) {
+      activeSegment.score += freqs[newDmer];
+    }
+    activeSegment.end += 1;
+    activeDmers[newDmer] += 1;
+    if (activeSegment.end - activeSegment.begin == dmersInK + 1) {
+      const U32 delDmer = dmerAt[activeSegment.begin];
+      activeSegment.begin += 1;
+      activeDmers[delDmer] -= 1;
+      if (activeDmers[delDmer] == 0) {
+        activeSegment.score -= freqs[delDmer];
+      }
+    }
+    if (activeSegment.score > bestSegment.score) {
+      bestSegment = activeSegment;
+    }
+  }
+  /* Empty the active segment for the next call */
+  while (activeSegment.begin < activeSegment.end) {
+    activeDmers[dmerAt[activeSegment.begin++]] -= 1;
+  }
+  {
+    /* Trim off the zero frequency head and tail from the segment. */
+    U32 newBegin = bestSegment.end;
+    U32 newEnd = bestSegment.begin;
+    U32 pos;
+    for (pos = bestSegment.begin; pos != bestSegment.end; ++pos) {
+      if (freqs[dmerAt[pos]] != 0) {
+        newBegin = MIN(newBegin, pos);
+        newEnd = pos + 1;
+      }
+    }
+    bestSegment.begin = newBegin;
+    bestSegment.end = newEnd;
+  }
+  {
+    /* Zero out the frequency of each dmer covered by the chosen segment. */
+    U32 pos;
+    for (pos = bestSegment.begin; pos != bestSegment.end; ++pos) {
+      freqs[dmerAt[pos]] = 0;
+    }
+  }
+  return bestSegment;
+}
+
+ZDICTLIB_API size_t ZDICT_trainFromCoverState(
+    void *dictBuffer, size_t dictBufferCapacity,
+    const ZDICT_cover_state_t *state, const void *samplesBuffer,
+    const size_t *samplesSizes, unsigned nbSamples,
+    ZDICT_cover_params_t parameters) {
+  BYTE *const dict = (BYTE *)dictBuffer;
+  const BYTE *const samples = (const BYTE *)samplesBuffer;
+  const size_t totalSamplesSize = COVER_sum(samplesSizes, nbSamples);
+  const size_t hashSize = (size_t)1 << state->hashLog;
+  size_t tail = dictBufferCapacity;
+  size_t nbDmers = 0;
+  U32 *dmerAt;
+  U32 *hashes;
+  U32 *freqs;
+  U32 *activeDmers;
+  const int displayLevel = parameters.zParams.notificationLevel;
+
+  parameters.d = state->d;
+  if (!COVER_checkParameters(parameters, dictBufferCapacity)) {
+    DISPLAYLEVEL(1, "Cover parameters incorrect\n");
+    return ERROR(GENERIC);
+  }
+  if (dictBufferCapacity < ZDICT_DICTSIZE_MIN) {
+    DISPLAYLEVEL(1, "dictBufferCapacity must be at least %u\n",
+                 ZDICT_DICTSIZE_MIN);
+    return ERROR(dstSize_tooSmall);
+  }
+  if (totalSamplesSize >= (size_t)COVER_MAX_SAMPLES_SIZE) {
+    DISPLAYLEVEL(1, "Total samples size is too large (%u MB), maximum size is %u MB\n",
+                 (U32)(totalSamplesSize>>20), (COVER_MAX_SAMPLES_SIZE >> 20));
+    return ERROR(srcSize_wrong);
+  }
+  /* The position and hash of every dmer, not crossing samples */
+  dmerAt = (U32 *)malloc(totalSamplesSize * sizeof(U32) + 1);
+  hashes = (U32 *)malloc(totalSamplesSize * sizeof(U32) + 1);
+  freqs = (U32 *)malloc(hashSize * sizeof(U32));
+  activeDmers = (U32 *)calloc(hashSize, sizeof(U32));
+  if (!dmerAt || !hashes || !freqs || !activeDmers) {
+    DISPLAYLEVEL(1, "Failed to allocate buffers: out of memory\n");
+    free(dmerAt);
+    free(hashes);
+    free(freqs);
+    free(activeDmers);
+    return ERROR(memory_allocation);
+  }
+  {
+    size_t offset = 0;
+    unsigned i;
+    for (i = 0; i < nbSamples; ++i) {
+      const size_t sampleDmers = COVER_nbHashedDmers(samplesSizes[i]);
+      size_t pos;
+      for (pos = 0; pos < sampleDmers; ++pos) {
+        dmerAt[nbDmers] = (U32)(offset + pos);
+        hashes[nbDmers] =
+            COVER_hashDmer(samples + offset + pos, state->d, state->hashLog);
+        ++nbDmers;
+      }
+      offset += samplesSizes[i];
+    }
+  }
+  /* The selection zeroes the frequencies it picks: work on a copy */
+  memcpy(freqs, state->freqs, hashSize * sizeof(U32));
+  if (nbDmers > 0) {
+    /* Same loop as COVER_buildDictionary() */
+    const U32 epochs =
+        (U32)MIN(MAX(1, dictBufferCapacity / parameters.k), nbDmers);
+    const U32 epochSize = (U32)(nbDmers / epochs);
+    size_t epoch;
+    for (epoch = 0; tail > 0; epoch = (epoch + 1) % epochs) {
+      const U32 epochBegin = (U32)(epoch * epochSize);
+      const U32 epochEnd = epochBegin + epochSize;
+      size_t segmentSize;
+      const COVER_segment_t segment = COVER_selectHashedSegment(
+          hashes, freqs, activeDmers, epochBegin, epochEnd, parameters.k,
+          parameters.d);
+      if (segment.score == 0) {
+        break;
+      }
+      /* Copy from the first dmer to the end of the last one, which may be in
+       * the next sample */
+      segmentSize = MIN(dmerAt[segment.end - 1] - dmerAt[segment.begin] +
+                            parameters.d,
+                        tail);
+      if (segmentSize < parameters.d) {
+        break;
+      }
+      tail -= segmentSize;
+      memcpy(dict + tail, samples + dmerAt[segment.begin], segmentSize);
+    }
+  }
+  free(dmerAt);
+  free(hashes);
+  free(freqs);
+  free(activeDmers);
+  DISPLAYLEVEL(2, "Building dictionary of %u bytes\n",
+               (U32)(dictBufferCapacity - tail));
+  return ZDICT_finalizeDictionary(dict, dictBufferCapacity, dict + tail,
+                                  dictBufferCapacity - tail, samplesBuffer,
+                                  samplesSizes, nbSamples,
+                                  parameters.zParams);
+}
@@ -29,6 +29,7 @@ typedef struct {
     U32 f1d;
     U32 f7b;
     U32 f7c;
+    U32 xcr0;
 } ZSTD1_cpuid_t;
 
 MEM_STATIC ZSTD1_cpuid_t ZSTD1_cpuid(void) {
@@ -36,6 +37,7 @@ MEM_STATIC ZSTD1_cpuid_t ZSTD1_cpuid(void) {
     U32 f1d = 0;
     U32 f7b = 0;
     U32 f7c = 0;
+    U32 xcr0 = 0;
 #ifdef _MSC_VER
     int reg[4];
     __cpuid((int*)reg, 0);
@@ -100,12 +102,23 @@ MEM_STATIC ZSTD1_cpuid_t ZSTD1_cpuid(void) {
               : "edx");
     }
 #endif
+    if (f1c & (1U << 27)) {
+        /* OSXSAVE: xgetbv tells which register states the OS saves */
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        xcr0 = (U32)_xgetbv(0);
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        U32 xcr0h;
+        __asm__("xgetbv" : "=a"(xcr0), "=d"(xcr0h) : "c"(0));
+        (void)xcr0h;
+#endif
+    }
     {
         ZSTD1_cpuid_t cpuid;
         cpuid.f1c = f1c;
         cpuid.f1d = f1d;
         cpuid.f7b = f7b;
         cpuid.f7c = f7c;
+        cpuid.xcr0 = xcr0;
         return cpuid;
     }
 }
@@ -213,4 +226,17 @@ MEM_STATIC ZSTD1_cpuid_t ZSTD1_cpuid(void) {
 
 #undef X
 
+/* The CPU flags above only say what the processor implements.  AVX registers
+ * can be used only if the OS also saves them on context switches, as
+ * reported in XCR0: SSE (bit 1) and AVX (bit 2) state. */
+MEM_STATIC int ZSTD1_cpuid_avx2usable(ZSTD1_cpuid_t const cpuid) {
+    return ZSTD1_cpuid_avx2(cpuid) && (cpuid.xcr0 & 6) == 6;
+}
+
+/* AVX-512 also needs the opmask and upper ZMM states (bits 5 to 7). */
+MEM_STATIC int ZSTD1_cpuid_avx512usable(ZSTD1_cpuid_t const cpuid) {
+    return ZSTD1_cpuid_avx512f(cpuid) && ZSTD1_cpuid_avx512bw(cpuid)
+        && (cpuid.xcr0 & 0xE6) == 0xE6;
+}
+
 #endif /* ZSTD1_COMMON_CPU_H */
@@ -3,6 +3,7 @@ package zstd1
 /*
 #define ZSTD1_STATIC_LINKING_ONLY
 #include "zstd.h"
+#include "zstd_errors.h"
 */
 import "C"
 
@@ -33,3 +34,10 @@ func IsDstSizeTooSmallError(e error) bool {
 	}
 	return false
 }
+
+// isSrcSizeWrongError returns whether the error is zstd's srcSize_wrong, which
+// is how it reports input that ends in the middle of a frame
+func isSrcSizeWrongError(e error) bool {
+	code, ok := e.(ErrorCode)
+	return ok && C.ZSTD1_getErrorCode(C.size_t(code)) == C.ZSTD1_error_srcSize_wrong
+}
@@ -72,6 +72,61 @@ static DTableDesc HUF1_getDTableDesc(const HUF1_DTable* table)
 }
 
 
+/*-***************************/
+/*  4 streams fast loops     */
+/*-***************************/
+/* The BMI2 variants of the 4 streams decoders start with a loop that decodes
+ * several symbols per stream between refills, and checks its bounds once for
+ * a run of iterations rather than at every refill.  Each stream keeps its bits
+ * left-aligned above a marker bit, which counts the bits consumed since the
+ * last refill.  The symbols decoded between refills and the up to 8 bits left
+ * over must fit in the 63 bits above the marker, hence the table log limits :
+ * 5 symbols per refill for single-symbol tables, 4 for double-symbols ones. */
+#define HUF1_DECODER_FAST_TABLELOG_FOR(nbSymbols) ((63 - 8) / (nbSymbols))
+#define HUF1_DECODER_FAST_TABLELOG    HUF1_DECODER_FAST_TABLELOG_FOR(5)   /* 11 */
+#define HUF1_DECODER_FAST_TABLELOG_X4 HUF1_DECODER_FAST_TABLELOG_FOR(4)   /* 13 */
+
+MEM_STATIC unsigned HUF1_countTrailingZeros64(U64 val)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long r = 0;
+    _BitScanForward64(&r, val);
+    return (unsigned)r;
+#elif defined(__GNUC__) && (__GNUC__ >= 4)
+    return (unsigned)__builtin_ctzll(val);
+#else
+    unsigned r = 0;
+    while (!(val & 1)) { val >>= 1; r++; }
+    return r;
+#endif
+}
+
+/* refills stream s, at most 7 bytes back */
+#define HUF1_4X_RELOAD(s) {                                       \
+        unsigned const ctz = HUF1_countTrailingZeros64(bits[s]); \
+        ip[s] -= ctz >> 3;                                       \
+        bits[s] = (MEM_readLE64(ip[s]) | 1) << (ctz & 7);        \
+    }
+
+/* converts the streams to the fast loop representation */
+#define HUF1_4X_FASTLOOP_INIT {                                              \
+        for (s = 0; s < 4; s++) {                                           \
+            op[s] = opPtr[s];                                               \
+            ip[s] = (const BYTE*)bitD[s]->ptr;                              \
+            bits[s] = (bitD[s]->bitContainer | 1) << bitD[s]->bitsConsumed; \
+    }   }
+
+/* hands the streams back to the regular loop, if the fast loop ran */
+#define HUF1_4X_FASTLOOP_END {                                                  \
+        if (op[0] == opPtr[0]) return;                                         \
+        for (s = 0; s < 4; s++) {                                              \
+            opPtr[s] = op[s];                                                  \
+            bitD[s]->ptr = (const char*)ip[s];                                 \
+            bitD[s]->bitsConsumed = HUF1_countTrailingZeros64(bits[s]);         \
+            bitD[s]->bitContainer = MEM_readLEST(ip[s]);                       \
+    }   }
+
+
 /*-***************************/
 /*  single-symbol decoding   */
 /*-***************************/
@@ -188,11 +243,57 @@ HUF1_decodeStreamX2(BYTE* p, BIT_DStream_t* const bitDPtr, BYTE* const pEnd, con
     return pEnd-pStart;
 }
 
+/* HUF1_decompress4X2_fastLoop() :
+ * Decodes the 4 streams until one of them gets within 7 bytes of its start or
+ * the last segment within 5 bytes of its end.  Requires 64-bit registers and
+ * dtLog <= HUF1_DECODER_FAST_TABLELOG. */
+FORCE_INLINE_TEMPLATE void
+HUF1_decompress4X2_fastLoop(BYTE* opPtr[4], BYTE* const oend, BIT_DStream_t* const bitD[4],
+                           const HUF1_DEltX2* const dt, U32 const dtLog)
+{
+    U32 const shift = 64 - dtLog;
+    BYTE* op[4];
+    const BYTE* ip[4];
+    U64 bits[4];
+    int s;
+
+    HUF1_4X_FASTLOOP_INIT;
+    for (;;) {
+        /* segments advance in lock step, the last one is the shortest */
+        size_t iters = (size_t)(oend - op[3]) / 5;
+        for (s = 0; s < 4; s++) {
+            size_t const iitersS = (size_t)(ip[s] - (const BYTE*)bitD[s]->start) / 7;
+            if (iitersS < iters) iters = iitersS;
+        }
+        if (iters == 0) break;
+        do {
+#define HUF1_4X2_DECODE_SYMBOL(s, n) {              \
+                HUF1_DEltX2 const e = dt[bits[s] >> shift]; \
+                bits[s] <<= e.nbBits;                  \
+                op[s][n] = e.byte;                     \
+            }
+#define HUF1_4X2_DECODE_SYMBOLS(n)                         \
+            HUF1_4X2_DECODE_SYMBOL(0, n) HUF1_4X2_DECODE_SYMBOL(1, n) \
+            HUF1_4X2_DECODE_SYMBOL(2, n) HUF1_4X2_DECODE_SYMBOL(3, n)
+            HUF1_4X2_DECODE_SYMBOLS(0)
+            HUF1_4X2_DECODE_SYMBOLS(1)
+            HUF1_4X2_DECODE_SYMBOLS(2)
+            HUF1_4X2_DECODE_SYMBOLS(3)
+            HUF1_4X2_DECODE_SYMBOLS(4)
+#undef HUF1_4X2_DECODE_SYMBOLS
+#undef HUF1_4X2_DECODE_SYMBOL
+            op[0] += 5; op[1] += 5; op[2] += 5; op[3] += 5;
+            HUF1_4X_RELOAD(0) HUF1_4X_RELOAD(1) HUF1_4X_RELOAD(2) HUF1_4X_RELOAD(3)
+        } while (--iters);
+    }
+    HUF1_4X_FASTLOOP_END;
+}
+
 FORCE_INLINE_TEMPLATE size_t
 HUF1_decompress1X2_usingDTable_internal_body(
           void* dst,  size_t dstSize,
     const void* cSrc, size_t cSrcSize,
-    const HUF1_DTable* DTable)
+    const HUF1_DTable* DTable, int const fastLoop)
 {
     BYTE* op = (BYTE*)dst;
     BYTE* const oend = op + dstSize;
@@ -201,6 +302,7 @@ HUF1_decompress1X2_usingDTable_internal_body(
     BIT_DStream_t bitD;
     DTableDesc const dtd = HUF1_getDTableDesc(DTable);
     U32 const dtLog = dtd.tableLog;
+    (void)fastLoop;   /* 4 streams only */
 
     CHECK_F( BIT_initDStream(&bitD, cSrc, cSrcSize) );
 
@@ -215,7 +317,7 @@ FORCE_INLINE_TEMPLATE size_t
 HUF1_decompress4X2_usingDTable_internal_body(
           void* dst,  size_t dstSize,
     const void* cSrc, size_t cSrcSize,
-    const HUF1_DTable* DTable)
+    const HUF1_DTable* DTable, int const fastLoop)
 {
     /* Check */
     if (cSrcSize < 10) return ERROR(corruption_detected);  /* strict minimum : jump table + 1 byte per stream */
@@ -257,6 +359,14 @@ HUF1_decompress4X2_usingDTable_internal_body(
         CHECK_F( BIT_initDStream(&bitD3, istart3, length3) );
         CHECK_F( BIT_initDStream(&bitD4, istart4, length4) );
 
+        if (fastLoop && MEM_64bits() && dtLog <= HUF1_DECODER_FAST_TABLELOG) {
+            BIT_DStream_t* const bitD[4] = { &bitD1, &bitD2, &bitD3, &bitD4 };
+            BYTE* op[4];
+            op[0] = op1; op[1] = op2; op[2] = op3; op[3] = op4;
+            HUF1_decompress4X2_fastLoop(op, oend, bitD, dt, dtLog);
+            op1 = op[0]; op2 = op[1]; op3 = op[2]; op4 = op[3];
+        }
+
         /* up to 16 symbols per loop (4 symbols per stream) in 64-bit mode */
         endSignal = BIT_reloadDStream(&bitD1) | BIT_reloadDStream(&bitD2) | BIT_reloadDStream(&bitD3) | BIT_reloadDStream(&bitD4);
         while ( (endSignal==BIT_DStream_unfinished) && (op4<(oend-3)) ) {
@@ -369,13 +479,62 @@ HUF1_decodeStreamX4(BYTE* p, BIT_DStream_t* bitDPtr, BYTE* const pEnd,
     return p-pStart;
 }
 
+/* HUF1_decompress4X4_fastLoop() :
+ * Decodes the 4 streams until one of them gets within 7 bytes of its start or
+ * its segment within 8 bytes of its end.  Requires 64-bit registers and
+ * dtLog <= HUF1_DECODER_FAST_TABLELOG_X4. */
+FORCE_INLINE_TEMPLATE void
+HUF1_decompress4X4_fastLoop(BYTE* opPtr[4], BYTE* const opEnd[4], BIT_DStream_t* const bitD[4],
+                           const HUF1_DEltX4* const dt, U32 const dtLog)
+{
+    U32 const shift = 64 - dtLog;
+    BYTE* op[4];
+    const BYTE* ip[4];
+    U64 bits[4];
+    int s;
+    /* double-symbols tables of every supported log take this loop */
+    HUF1_STATIC_ASSERT(HUF1_TABLELOG_MAX <= HUF1_DECODER_FAST_TABLELOG_X4);
+
+    HUF1_4X_FASTLOOP_INIT;
+    for (;;) {
+        size_t iters = (size_t)-1;
+        for (s = 0; s < 4; s++) {
+            size_t const oitersS = (size_t)(opEnd[s] - op[s]) / 8;
+            size_t const iitersS = (size_t)(ip[s] - (const BYTE*)bitD[s]->start) / 7;
+            if (oitersS < iters) iters = oitersS;
+            if (iitersS < iters) iters = iitersS;
+        }
+        if (iters == 0) break;
+        do {
+#define HUF1_4X4_DECODE_SYMBOL(s) {                 \
+                HUF1_DEltX4 const e = dt[bits[s] >> shift]; \
+                MEM_write16(op[s], e.sequence);        \
+                bits[s] <<= e.nbBits;                  \
+                op[s] += e.length;                     \
+            }
+#define HUF1_4X4_DECODE_SYMBOLS                         \
+            HUF1_4X4_DECODE_SYMBOL(0) HUF1_4X4_DECODE_SYMBOL(1) \
+            HUF1_4X4_DECODE_SYMBOL(2) HUF1_4X4_DECODE_SYMBOL(3)
+            HUF1_4X4_DECODE_SYMBOLS
+            HUF1_4X4_DECODE_SYMBOLS
+            HUF1_4X4_DECODE_SYMBOLS
+            HUF1_4X4_DECODE_SYMBOLS
+#undef HUF1_4X4_DECODE_SYMBOLS
+#undef HUF1_4X4_DECODE_SYMBOL
+            HUF1_4X_RELOAD(0) HUF1_4X_RELOAD(1) HUF1_4X_RELOAD(2) HUF1_4X_RELOAD(3)
+        } while (--iters);
+    }
+    HUF1_4X_FASTLOOP_END;
+}
+
 FORCE_INLINE_TEMPLATE size_t
 HUF1_decompress1X4_usingDTable_internal_body(
           void* dst,  size_t dstSize,
     const void* cSrc, size_t cSrcSize,
-    const HUF1_DTable* DTable)
+    const HUF1_DTable* DTable, int const fastLoop)
 {
     BIT_DStream_t bitD;
+    (void)fastLoop;   /* 4 streams only */
 
     /* Init */
     CHECK_F( BIT_initDStream(&bitD, cSrc, cSrcSize) );
@@ -401,7 +560,7 @@ FORCE_INLINE_TEMPLATE size_t
 HUF1_decompress4X4_usingDTable_internal_body(
           void* dst,  size_t dstSize,
     const void* cSrc, size_t cSrcSize,
-    const HUF1_DTable* DTable)
+    const HUF1_DTable* DTable, int const fastLoop)
 {
     if (cSrcSize < 10) return ERROR(corruption_detected);   /* strict minimum : jump table + 1 byte per stream */
 
@@ -442,6 +601,15 @@ HUF1_decompress4X4_usingDTable_internal_body(
         CHECK_F( BIT_initDStream(&bitD3, istart3, length3) );
         CHECK_F( BIT_initDStream(&bitD4, istart4, length4) );
 
+        if (fastLoop && MEM_64bits() && dtLog <= HUF1_DECODER_FAST_TABLELOG_X4) {
+            BIT_DStream_t* const bitD[4] = { &bitD1, &bitD2, &bitD3, &bitD4 };
+            BYTE* const opEnd[4] = { opStart2, opStart3, opStart4, oend };
+            BYTE* op[4];
+            op[0] = op1; op[1] = op2; op[2] = op3; op[3] = op4;
+            HUF1_decompress4X4_fastLoop(op, opEnd, bitD, dt, dtLog);
+            op1 = op[0]; op2 = op[1]; op3 = op[2]; op4 = op[3];
+        }
+
         /* 16-32 symbols per loop (4-8 symbols per stream) */
         endSignal = BIT_reloadDStream(&bitD1) | BIT_reloadDStream(&bitD2) | BIT_reloadDStream(&bitD3) | BIT_reloadDStream(&bitD4);
         for ( ; (endSignal==BIT_DStream_unfinished) & (op4<(oend-(sizeof(bitD4.bitContainer)-1))) ; ) {
@@ -491,6 +659,7 @@ typedef size_t (*HUF1_decompress_usingDTable_t)(void *dst, size_t dstSize,
                                                const void *cSrc,
                                                size_t cSrcSize,
                                                const HUF1_DTable *DTable);
+/* The fast loops pay off where variable shifts are cheap, i.e. with BMI2 */
 #if DYNAMIC_BMI2
 
 #define X(fn)                                                               \
@@ -500,7 +669,7 @@ typedef size_t (*HUF1_decompress_usingDTable_t)(void *dst, size_t dstSize,
             const void* cSrc, size_t cSrcSize,                              \
             const HUF1_DTable* DTable)                                       \
     {                                                                       \
-        return fn##_body(dst, dstSize, cSrc, cSrcSize, DTable);             \
+        return fn##_body(dst, dstSize, cSrc, cSrcSize, DTable, 0);          \
     }                                                                       \
                                                                             \
     static TARGET_ATTRIBUTE("bmi2") size_t fn##_bmi2(                       \
@@ -508,7 +677,7 @@ typedef size_t (*HUF1_decompress_usingDTable_t)(void *dst, size_t dstSize,
             const void* cSrc, size_t cSrcSize,                              \
             const HUF1_DTable* DTable)                                       \
     {                                                                       \
-        return fn##_body(dst, dstSize, cSrc, cSrcSize, DTable);             \
+        return fn##_body(dst, dstSize, cSrc, cSrcSize, DTable, 1);          \
     }                                                                       \
                                                                             \
     static size_t fn(void* dst, size_t dstSize, void const* cSrc,           \
@@ -522,12 +691,18 @@ typedef size_t (*HUF1_decompress_usingDTable_t)(void *dst, size_t dstSize,
 
 #else
 
+#ifdef __BMI2__
+#  define HUF1_BMI2 1
+#else
+#  define HUF1_BMI2 0
+#endif
+
 #define X(fn)                                                               \
     static size_t fn(void* dst, size_t dstSize, void const* cSrc,           \
                      size_t cSrcSize, HUF1_DTable const* DTable, int bmi2)   \
     {                                                                       \
         (void)bmi2;                                                         \
-        return fn##_body(dst, dstSize, cSrc, cSrcSize, DTable);             \
+        return fn##_body(dst, dstSize, cSrc, cSrcSize, DTable, HUF1_BMI2);   \
     }
 
 #endif
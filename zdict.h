@@ -85,7 +85,7 @@ typedef struct {
     unsigned k;                  /* Segment size : constraint: 0 < k : Reasonable range [16, 2048+] */
     unsigned d;                  /* dmer size : constraint: 0 < d <= k : Reasonable range [6, 16] */
     unsigned steps;              /* Number of steps : Only used for optimization : 0 means default (32) : Higher means more parameters checked */
-    unsigned nbThreads;          /* Number of threads : constraint: 0 < nbThreads : 1 means single-threaded : Only used for optimization : Ignored if ZSTD1_MULTITHREAD is not defined */
+    unsigned nbThreads;          /* Number of threads : constraint: 0 < nbThreads : 1 means single-threaded : Sorts the samples, and tries parameters concurrently in optimization : Ignored if ZSTD1_MULTITHREAD is not defined */
     ZDICT_params_t zParams;
 } ZDICT_cover_params_t;
 
@@ -129,6 +129,64 @@ ZDICTLIB_API size_t ZDICT_optimizeTrainFromBuffer_cover(
     const void* samplesBuffer, const size_t* samplesSizes, unsigned nbSamples,
           ZDICT_cover_params_t* parameters);
 
+/*! ZDICT_cover_control_t:
+ *  Controls ZDICT_optimizeTrainFromBuffer_cover_control() while it runs.
+ *  `maxMemory` bounds the memory used by the context and the concurrent
+ *  trials, lowering the number of threads so it fits; 0 means no limit.  At
+ *  least one trial runs whatever the budget.
+ *  `threads`, `total` and `completed` are written by the trainer: the number of
+ *  threads used, of parameter sets to try, and of those tried so far.
+ *  Setting `stop` to non-zero skips the remaining trials and makes the trainer
+ *  return an error.
+ *  Fields other than `maxMemory` may be accessed by other threads during
+ *  training, with atomic operations only.
+ */
+typedef struct {
+    size_t   maxMemory;
+    unsigned threads;
+    unsigned total;
+    unsigned completed;
+    int      stop;
+} ZDICT_cover_control_t;
+
+/*! ZDICT_optimizeTrainFromBuffer_cover_control():
+ *  Same as ZDICT_optimizeTrainFromBuffer_cover(), with a memory budget, progress
+ *  and cancellation through `control`, which may be NULL.
+ */
+ZDICTLIB_API size_t ZDICT_optimizeTrainFromBuffer_cover_control(
+          void* dictBuffer, size_t dictBufferCapacity,
+    const void* samplesBuffer, const size_t* samplesSizes, unsigned nbSamples,
+          ZDICT_cover_params_t* parameters, ZDICT_cover_control_t* control);
+
+/*! ZDICT_cover_state_t:
+ *  Incremental training.  The state counts the dmers of the samples given to
+ *  ZDICT_coverState_update() by hash, in 2^hashLog counters, so that new
+ *  samples are merged without going over the previous ones again.
+ *  ZDICT_coverState_age() halves the counts, so that old samples fade away.
+ *  ZDICT_trainFromCoverState() builds a dictionary out of segments of the
+ *  samples it is given, scored with the frequencies of the state: those
+ *  samples can be a small subset of all the samples seen.  Its `parameters.d`
+ *  is ignored in favor of the d of the state.
+ *  d must be in [ZDICT_COVER_STATE_DMIN, ZDICT_COVER_STATE_DMAX], and hashLog
+ *  in [ZDICT_COVER_STATE_HASHLOG_MIN, ZDICT_COVER_STATE_HASHLOG_MAX].
+ *  ZDICT_trainFromCoverState() uses 8 bytes of memory per sample byte, plus 8
+ *  per counter.
+ */
+#define ZDICT_COVER_STATE_DMIN 4
+#define ZDICT_COVER_STATE_DMAX 8
+#define ZDICT_COVER_STATE_HASHLOG_MIN 12
+#define ZDICT_COVER_STATE_HASHLOG_MAX 26
+typedef struct ZDICT_cover_state_s ZDICT_cover_state_t;
+ZDICTLIB_API ZDICT_cover_state_t* ZDICT_createCoverState(unsigned d, unsigned hashLog);
+ZDICTLIB_API void ZDICT_freeCoverState(ZDICT_cover_state_t* state);
+ZDICTLIB_API void ZDICT_coverState_update(ZDICT_cover_state_t* state,
+                                          const void* samplesBuffer, const size_t* samplesSizes, unsigned nbSamples);
+ZDICTLIB_API void ZDICT_coverState_age(ZDICT_cover_state_t* state);
+ZDICTLIB_API size_t ZDICT_trainFromCoverState(void* dictBuffer, size_t dictBufferCapacity,
+                                const ZDICT_cover_state_t* state,
+                                const void* samplesBuffer, const size_t* samplesSizes, unsigned nbSamples,
+                                ZDICT_cover_params_t parameters);
+
 /*! ZDICT_finalizeDictionary():
  * Given a custom content as a basis for dictionary, and a set of samples,
  * finalize dictionary by adding headers and statistics.
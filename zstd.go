@@ -1,28 +1,19 @@
 package zstd1
 
 /*
+// Build the vendored library with its thread pool (pool.c, threading.c)
+// so that ZSTDMT and the dictionary builder can use worker threads.
+#cgo CFLAGS: -DZSTD1_MULTITHREAD
+#cgo !windows LDFLAGS: -pthread
+
 #define ZSTD1_STATIC_LINKING_ONLY
 #include "zstd.h"
-#include "stdint.h"  // for uintptr_t
-
-// The following *_wrapper function are used for removing superflouos
-// memory allocations when calling the wrapped functions from Go code.
-// See https://github.com/golang/go/issues/24450 for details.
-
-static size_t ZSTD1_compress_wrapper(uintptr_t dst, size_t maxDstSize, const uintptr_t src, size_t srcSize, int compressionLevel) {
-	return ZSTD1_compress((void*)dst, maxDstSize, (const void*)src, srcSize, compressionLevel);
-}
-
-static size_t ZSTD1_decompress_wrapper(uintptr_t dst, size_t maxDstSize, uintptr_t src, size_t srcSize) {
-	return ZSTD1_decompress((void*)dst, maxDstSize, (const void *)src, srcSize);
-}
-
 */
 import "C"
 import (
 	"bytes"
 	"errors"
-	"io/ioutil"
+	"io"
 	"unsafe"
 )
 
@@ -31,13 +22,30 @@ const (
 	BestSpeed          = 1
 	BestCompression    = 20
 	DefaultCompression = 5
+
+	// MinCompressionLevel is the lowest negative level.  Levels below
+	// BestSpeed skip more of the input while looking for matches, and
+	// store literals without entropy coding: level -N uses an acceleration
+	// factor of N, trading ratio for speed.
+	MinCompressionLevel = -(1 << 17)
 )
 
 var (
 	// ErrEmptySlice is returned when there is nothing to compress
 	ErrEmptySlice = errors.New("Bytes slice is empty")
+	// ErrContextAllocation is returned when zstd fails to allocate a context
+	ErrContextAllocation = errors.New("Failed to allocate context")
 )
 
+// checkLevel rejects levels below MinCompressionLevel, whose acceleration
+// factor is meaningless
+func checkLevel(level int) error {
+	if level < MinCompressionLevel {
+		return errParamOutOfBound
+	}
+	return nil
+}
+
 // CompressBound returns the worst case size needed for a destination buffer,
 // which can be used to preallocate a destination buffer or select a previously
 // allocated buffer from a pool.
@@ -68,75 +76,97 @@ func CompressLevel(dst, src []byte, level int) ([]byte, error) {
 	if len(src) == 0 {
 		return []byte{}, ErrEmptySlice
 	}
-	bound := CompressBound(len(src))
-	if cap(dst) >= bound {
-		dst = dst[0:bound] // Reuse dst buffer
-	} else {
-		dst = make([]byte, bound)
-	}
-
-	cWritten := C.ZSTD1_compress_wrapper(
-		C.uintptr_t(uintptr(unsafe.Pointer(&dst[0]))),
-		C.size_t(len(dst)),
-		C.uintptr_t(uintptr(unsafe.Pointer(&src[0]))),
-		C.size_t(len(src)),
-		C.int(level))
-
-	written := int(cWritten)
-	// Check if the return is an Error code
-	if err := getError(written); err != nil {
+	// Contexts come from a pool keyed by level and window size so that the
+	// C context is reused in place instead of being allocated per call.
+	c, err := getCompressCtx(level, len(src))
+	if err != nil {
 		return nil, err
 	}
-	return dst[:written], nil
+	defer putCompressCtx(c)
+	return c.CompressLevel(dst, src, level)
 }
 
 // Decompress src into dst.  If you have a buffer to use, you can pass it to
 // prevent allocation.  If it is too small, or if nil is passed, a new buffer
-// will be allocated and returned.
+// will be allocated and returned.  The buffer is sized from the content size
+// stored in the frame headers; when it is missing the payload is decompressed
+// in streaming mode, growing the buffer as needed.
 func Decompress(dst, src []byte) ([]byte, error) {
 	if len(src) == 0 {
 		return []byte{}, ErrEmptySlice
 	}
-	decompress := func(dst, src []byte) ([]byte, error) {
+	d, err := getDecompressCtx()
+	if err != nil {
+		return nil, err
+	}
+	defer putDecompressCtx(d)
+	return d.Decompress(dst, src)
+}
 
-		cWritten := C.ZSTD1_decompress_wrapper(
-			C.uintptr_t(uintptr(unsafe.Pointer(&dst[0]))),
-			C.size_t(len(dst)),
-			C.uintptr_t(uintptr(unsafe.Pointer(&src[0]))),
-			C.size_t(len(src)))
+// maxCompressionRatio bounds the decompressed size a valid frame can
+// declare: an RLE block expands 4 bytes into at most 128 KB.  Larger declared
+// sizes are not trusted for allocating the destination buffer.
+const maxCompressionRatio = 1 << 15
+
+// decompressSized decompresses src into dst.  When the frames of src declare
+// their content size, dst is sized once and decompress is called a single
+// time; it returns the raw zstd return code.  Otherwise src is decompressed
+// in one pass with a reader returned by newReader, growing dst as output is
+// produced, so no work is repeated and memory stays proportional to the
+// output.
+func decompressSized(dst, src []byte, decompress func(dst, src []byte) int, newReader func(io.Reader) io.ReadCloser) ([]byte, error) {
+	if len(src) == 0 {
+		return []byte{}, ErrEmptySlice
+	}
 
-		written := int(cWritten)
-		// Check error
+	size := uint64(C.ZSTD1_findDecompressedSize(unsafe.Pointer(&src[0]), C.size_t(len(src))))
+	if size != C.ZSTD1_CONTENTSIZE_UNKNOWN && size != C.ZSTD1_CONTENTSIZE_ERROR &&
+		size <= uint64(len(src))*maxCompressionRatio {
+		if size == 0 {
+			return []byte{}, nil
+		}
+		if uint64(cap(dst)) >= size {
+			dst = dst[:size]
+		} else {
+			dst = make([]byte, size)
+		}
+		written := decompress(dst, src)
 		if err := getError(written); err != nil {
 			return nil, err
 		}
 		return dst[:written], nil
 	}
 
-	if dst == nil {
-		// Attempt to use zStd to determine decompressed size (may result in error or 0)
-		size := int(C.size_t(C.ZSTD1_getDecompressedSize(unsafe.Pointer(&src[0]), C.size_t(len(src)))))
-
-		if err := getError(size); err != nil {
-			return nil, err
-		}
+	// The size is unknown, stream into dst instead
+	r := newReader(bytes.NewReader(src))
+	defer r.Close()
+	return readAllInto(dst[:0], r)
+}
 
-		if size > 0 {
-			dst = make([]byte, size)
-		} else {
-			dst = make([]byte, len(src)*3) // starting guess
+// readAllInto appends everything read from r to dst, growing it
+// geometrically like ioutil.ReadAll but starting from the capacity of dst.
+func readAllInto(dst []byte, r io.Reader) ([]byte, error) {
+	for {
+		if len(dst) == cap(dst) {
+			// Check for EOF before growing a buffer that may be just right
+			var probe [1]byte
+			n, err := r.Read(probe[:])
+			if n == 0 && err == io.EOF {
+				return dst, nil
+			}
+			grown := make([]byte, len(dst), 2*cap(dst)+int(C.ZSTD1_DStreamOutSize()))
+			copy(grown, dst)
+			dst = append(grown, probe[:n]...)
+			if err != nil && err != io.EOF {
+				return nil, err
+			}
 		}
-	}
-	for i := 0; i < 3; i++ { // 3 tries to allocate a bigger buffer
-		result, err := decompress(dst, src)
-		if !IsDstSizeTooSmallError(err) {
-			return result, err
+		n, err := r.Read(dst[len(dst):cap(dst)])
+		dst = dst[:len(dst)+n]
+		if err == io.EOF {
+			return dst, nil
+		} else if err != nil {
+			return nil, err
 		}
-		dst = make([]byte, len(dst)*2) // Grow buffer by 2
 	}
-
-	// We failed getting a dst buffer of correct size, use stream API
-	r := NewReader(bytes.NewReader(src))
-	defer r.Close()
-	return ioutil.ReadAll(r)
 }
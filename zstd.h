@@ -939,6 +939,14 @@ typedef enum {
                               * Decoder cannot recognise automatically this format, requiring instructions. */
 } ZSTD1_format_e;
 
+typedef enum {
+    ZSTD1_dictDefaultAttach = 0, /* Use the default heuristic : attach the CDict when the input is small
+                                 * (or of unknown size) and its strategy supports it, copy it otherwise. */
+    ZSTD1_dictForceAttach   = 1, /* Search the CDict's tables in place instead of copying them into the context.
+                                 * Strategies above ZSTD1_lazy2 always copy. */
+    ZSTD1_dictForceCopy     = 2, /* Always copy the CDict's tables into the working context. */
+} ZSTD1_dictAttachPref_e;
+
 typedef enum {
     /* compression format */
     ZSTD1_p_format = 10,      /* See ZSTD1_format_e enum definition.
@@ -1055,6 +1063,10 @@ typedef enum {
 
     ZSTD1_p_forceMaxWindow=1100, /* Force back-reference distances to remain < windowSize,
                               * even when referencing into Dictionary content (default:0) */
+    ZSTD1_p_forceAttachDict,  /* How a CDict is used by the next frames, see ZSTD1_dictAttachPref_e.
+                              * Attaching saves copying the dictionary's tables into the context, which
+                              * dominates the cost of compressing small inputs with a large dictionary,
+                              * at the price of a slower search per byte (default:ZSTD1_dictDefaultAttach) */
 
 } ZSTD1_cParameter;
 
@@ -1354,6 +1366,40 @@ ZSTDLIB_API void ZSTD1_DCtx_reset(ZSTD1_DCtx* dctx);
 
 
 
+/* =========================================== */
+/**       CPU-specific implementations         */
+/* =========================================== */
+
+/* The hot kernels (Huffman and sequence coding, match copying and counting)
+ * have variants using the instructions of successive x86-64 generations.
+ * The best one the CPU and OS support is selected once, on first use,
+ * and applies to the frames contexts start from then on.
+ * Tiers without a dedicated variant of a kernel use the next lower one. */
+typedef enum {
+    ZSTD1_cpu_auto = 0,    /* best supported tier, the default */
+    ZSTD1_cpu_generic,     /* portable code only */
+    ZSTD1_cpu_bmi2,        /* BMI2 bit manipulation in the entropy coders */
+    ZSTD1_cpu_avx2,        /* + AVX2 32-byte copies and compares */
+    ZSTD1_cpu_avx512       /* + AVX-512BW */
+} ZSTD1_cpuImpl_e;
+
+/*! ZSTD1_getCpuImpl() :
+ *  @return : the tier in use, never ZSTD1_cpu_auto */
+ZSTDLIB_API ZSTD1_cpuImpl_e ZSTD1_getCpuImpl(void);
+
+/*! ZSTD1_isCpuImplSupported() :
+ *  @return : 1 if the CPU and OS support the instructions of `impl`, 0 otherwise */
+ZSTDLIB_API unsigned ZSTD1_isCpuImplSupported(ZSTD1_cpuImpl_e impl);
+
+/*! ZSTD1_forceCpuImpl() :
+ *  Selects the tier used from now on, in every thread, or restores automatic
+ *  selection with ZSTD1_cpu_auto.  Meant for testing and benchmarking.
+ * @return : 0, or an error code if the CPU does not support `impl`
+ *           (which can be tested with ZSTD1_isError()) */
+ZSTDLIB_API size_t ZSTD1_forceCpuImpl(ZSTD1_cpuImpl_e impl);
+
+
+
 /* ============================ */
 /**       Block level API       */
 /* ============================ */
@@ -0,0 +1,238 @@
+package zstd1
+
+/*
+#define ZSTD1_STATIC_LINKING_ONLY
+#include "zstd.h"
+*/
+import "C"
+import (
+	"io"
+	"time"
+)
+
+// adaptiveInterval is the amount of input between two level decisions, and
+// adaptiveHold the number of intervals spent at a level faster than both its
+// neighbours before measuring them again
+const (
+	adaptiveInterval = 1 << 20
+	adaptiveHold     = 4
+)
+
+// levelStats are moving averages of what a level costs per input byte
+type levelStats struct {
+	compressNs float64 // time spent compressing
+	ratio      float64 // output bytes
+}
+
+// adaptiveLevel tracks where a Writer spends its time, to pick the level
+// with the lowest time per input byte, compression and writing included.
+//
+// When compressing in the calling goroutine, compression and writes take
+// turns.  Every level that was used gets its compression time and ratio
+// recorded, while the speed of the underlying writer is shared by all
+// levels.  This way a level is judged on the bytes it writes, rather than on
+// the time its writes happened to take: the latter varies a lot with the
+// network.
+//
+// With workers, compression runs while the goroutine writes, and the output
+// of a job is written long after its input was consumed.  The time blocked
+// on either side is then what matters: the level goes up while the writer
+// waits on the link, down while it waits on the workers.
+type adaptiveLevel struct {
+	minLevel, maxLevel int
+	interval           int
+	pipelined          bool
+
+	stats  map[int]levelStats
+	linkNs float64 // time to write one byte
+	step   int     // direction of the last move, 0 before the first one
+	hold   int     // intervals left before moving again
+
+	consumed     int
+	written      int
+	compressTime time.Duration
+	writeTime    time.Duration
+}
+
+// NewWriterAdaptive is like NewWriterParallel but moves the compression
+// level between minLevel and maxLevel as it goes.  For every megabyte of
+// input, it measures the time spent compressing and the time spent blocked in
+// the underlying writer, and moves to a neighbouring level: up while writing
+// dominates, trading CPU for fewer bytes to write, and down while compressing
+// does.  Without workers it picks the level that costs the least time per
+// input byte; with workers, the one that keeps both sides busy.  This keeps a
+// writer feeding a network connection close to link speed without tuning the
+// level by hand.
+//
+// Without workers a new level can only apply to a new frame, so every
+// change ends the current frame; the output is a series of concatenated
+// frames, which every zstd decoder reads as a single stream.  With workers,
+// jobs are 1 MB and the level changes from the next job on, within the same
+// frame.  The current level is available in CompressionLevel.
+func NewWriterAdaptive(w io.Writer, minLevel, maxLevel int, workers int) *Writer {
+	if minLevel > maxLevel {
+		minLevel, maxLevel = maxLevel, minLevel
+	}
+	level := DefaultCompression
+	if level < minLevel {
+		level = minLevel
+	} else if level > maxLevel {
+		level = maxLevel
+	}
+	zw := newWriter(w, Params{Level: level}, workers, nil, nil)
+	zw.adapt = &adaptiveLevel{
+		minLevel:  minLevel,
+		maxLevel:  maxLevel,
+		interval:  adaptiveInterval,
+		pipelined: workers > 0,
+		stats:     make(map[int]levelStats),
+	}
+	if zw.firstError == nil {
+		zw.firstError = zw.adaptiveParams()
+	}
+	return zw
+}
+
+// adaptiveParams applies the parameters of adaptive writers to the context
+func (w *Writer) adaptiveParams() error {
+	if w.workers == 0 {
+		return nil
+	}
+	// Smaller jobs than the default give more chances to adapt
+	return getError(int(C.ZSTD1_CCtx_setParameter(w.ctx, C.ZSTD1_p_jobSize, adaptiveInterval)))
+}
+
+// reset forgets all measures, for a new stream
+func (a *adaptiveLevel) reset() {
+	for level := range a.stats {
+		delete(a.stats, level)
+	}
+	a.linkNs, a.step, a.hold = 0, 0, 0
+	a.consumed, a.written, a.compressTime, a.writeTime = 0, 0, 0, 0
+}
+
+// observe records the measures of the last interval, spent at level
+func (a *adaptiveLevel) observe(level int) {
+	consumed := float64(a.consumed)
+	cur := levelStats{
+		compressNs: float64(a.compressTime) / consumed,
+		ratio:      float64(a.written) / consumed,
+	}
+	if prev, ok := a.stats[level]; ok {
+		cur.compressNs = (cur.compressNs + prev.compressNs) / 2
+		cur.ratio = (cur.ratio + prev.ratio) / 2
+	}
+	a.stats[level] = cur
+	linkNs := float64(a.writeTime) / float64(a.written)
+	if a.linkNs == 0 {
+		a.linkNs = linkNs
+	} else {
+		a.linkNs = (3*a.linkNs + linkNs) / 4
+	}
+}
+
+// cost estimates the time per input byte at a level that was measured
+func (a *adaptiveLevel) cost(level int) (float64, bool) {
+	s, ok := a.stats[level]
+	return s.compressNs + s.ratio*a.linkNs, ok
+}
+
+// neighbour returns the next level in the direction of step, skipping 0
+// which selects the default level, or level itself at the bounds
+func (a *adaptiveLevel) neighbour(level, step int) int {
+	next := level + step
+	if next == 0 {
+		next += step
+	}
+	if next < a.minLevel || next > a.maxLevel {
+		return level
+	}
+	return next
+}
+
+// nextLevel returns the level for the next interval.  Without workers, it
+// moves to a neighbour measured to be faster, and otherwise measures the
+// neighbour in the current direction.  The first move is towards the cheaper
+// side: up when writing takes longer than compressing, down otherwise.  A
+// level faster than both its neighbours is kept for a few intervals before
+// they are measured again.
+func (a *adaptiveLevel) nextLevel(level int) int {
+	if a.pipelined {
+		return a.balanceLevel(level)
+	}
+	a.observe(level)
+	if a.hold > 0 {
+		a.hold--
+		return level
+	}
+	if a.step == 0 {
+		a.step = -1
+		if a.writeTime > a.compressTime {
+			a.step = 1
+		}
+	}
+
+	cost, _ := a.cost(level)
+	for _, step := range []int{a.step, -a.step} {
+		next := a.neighbour(level, step)
+		if nextCost, ok := a.cost(next); ok && next != level && nextCost < cost {
+			a.step = step
+			return next
+		}
+	}
+	for i := 0; i < 2; i++ {
+		next := a.neighbour(level, a.step)
+		if _, ok := a.stats[next]; !ok {
+			return next
+		}
+		a.step = -a.step
+	}
+
+	// Both neighbours are slower.  The input and the link may change, so
+	// forget them to measure them again after a while.
+	delete(a.stats, a.neighbour(level, 1))
+	delete(a.stats, a.neighbour(level, -1))
+	a.hold = adaptiveHold
+	return level
+}
+
+// balanceLevel returns the level for the next interval with workers.  It goes
+// up when the writer spent more time blocked writing than compressing, and
+// down when compressing took more than twice as long, so that it does not
+// oscillate around the balance.
+func (a *adaptiveLevel) balanceLevel(level int) int {
+	if a.writeTime > a.compressTime {
+		return a.neighbour(level, 1)
+	} else if a.compressTime > 2*a.writeTime {
+		return a.neighbour(level, -1)
+	}
+	return level
+}
+
+// adjustLevel moves the level of w once enough input was compressed since
+// the last decision, and some output written: zstd buffers its input, up to
+// a block or a job with workers, before producing anything.
+func (w *Writer) adjustLevel() error {
+	a := w.adapt
+	if a.consumed < a.interval || a.written == 0 {
+		return nil
+	}
+	level := a.nextLevel(w.CompressionLevel)
+	a.consumed, a.written, a.compressTime, a.writeTime = 0, 0, 0, 0
+	if level == w.CompressionLevel {
+		return nil
+	}
+	if w.workers == 0 {
+		// The single threaded compressor only applies parameters when a
+		// frame starts
+		if err := w.drain(C.ZSTD1_e_end); err != nil {
+			return err
+		}
+	}
+	if err := getError(int(C.ZSTD1_CCtx_setParameter(w.ctx, C.ZSTD1_p_compressionLevel, C.uint(level)))); err != nil {
+		w.firstError = err
+		return err
+	}
+	w.CompressionLevel = level
+	return nil
+}
@@ -0,0 +1,165 @@
+package zstd1
+
+import (
+	"bytes"
+	"io/ioutil"
+	"testing"
+	"time"
+)
+
+// slowWriter simulates a link of the given bandwidth, or an infinitely fast
+// one if bytesPerSecond is 0
+type slowWriter struct {
+	bytes.Buffer
+	bytesPerSecond int
+}
+
+func (w *slowWriter) Write(p []byte) (int, error) {
+	if w.bytesPerSecond > 0 {
+		time.Sleep(time.Duration(len(p)) * time.Second / time.Duration(w.bytesPerSecond))
+	}
+	return w.Buffer.Write(p)
+}
+
+// testAdaptive compresses payload through an adaptive writer starting at level
+// 3, and returns the lowest level it used and the level it ended at
+func testAdaptive(t *testing.T, workers int, bytesPerSecond int, payload []byte) (int, int) {
+	out := &slowWriter{bytesPerSecond: bytesPerSecond}
+	w := NewWriterAdaptive(out, -5, 3, workers)
+	w.adapt.interval = 128 << 10
+	lowest := w.CompressionLevel
+	for i := 0; i < len(payload); i += 32 << 10 {
+		_, err := w.Write(payload[i : i+32<<10])
+		failOnError(t, "Failed writing to compress object", err)
+		if w.CompressionLevel < lowest {
+			lowest = w.CompressionLevel
+		}
+	}
+	level := w.CompressionLevel
+	failOnError(t, "Failed to close compress object", w.Close())
+
+	decompressed, err := ioutil.ReadAll(NewReader(bytes.NewReader(out.Bytes())))
+	failOnError(t, "Failed to decompress", err)
+	if !bytes.Equal(payload, decompressed) {
+		t.Fatalf("Payload did not match")
+	}
+	decompressed, err = Decompress(nil, out.Bytes())
+	failOnError(t, "Failed to decompress", err)
+	if !bytes.Equal(payload, decompressed) {
+		t.Fatalf("Payload did not match")
+	}
+	return lowest, level
+}
+
+func TestAdaptiveLevel(t *testing.T) {
+	for _, workers := range []int{0, 2} {
+		// Writes to memory are free, compression dominates
+		if lowest, _ := testAdaptive(t, workers, 0, makePayload(8<<20)); lowest >= 3 {
+			t.Fatalf("Level should go down when writing is free")
+		}
+		// On a slow link writes dominate, and negative levels are slower
+		// as they write more
+		if _, level := testAdaptive(t, workers, 1<<20, makePayload(2<<20)); level < 1 {
+			t.Fatalf("Level should stay up when writing is slow, got %v", level)
+		}
+	}
+}
+
+func TestAdaptiveNextLevel(t *testing.T) {
+	// Compressing gets slower and the output smaller as the level goes up;
+	// on a link taking 16ns per byte, the total is the lowest at level 6
+	simulate := func(a *adaptiveLevel, level int, linkNs time.Duration) {
+		a.consumed = 1000
+		a.compressTime = time.Duration(level+10) * 1000
+		a.written = 16 * 1000 / (level + 10)
+		a.writeTime = time.Duration(a.written) * linkNs
+	}
+	a := adaptiveLevel{minLevel: -3, maxLevel: 9, stats: make(map[int]levelStats)}
+	level, visits := 9, make(map[int]int)
+	for i := 0; i < 100; i++ {
+		simulate(&a, level, 16)
+		level = a.nextLevel(level)
+		if level < a.minLevel || level > a.maxLevel || level == 0 {
+			t.Fatalf("Invalid level %v", level)
+		}
+		visits[level]++
+	}
+	if visits[6] < 60 {
+		t.Fatalf("Level 6 should be used most of the time: %v", visits)
+	}
+
+	// Writing is free: straight down to the minimum, skipping level 0
+	a = adaptiveLevel{minLevel: -3, maxLevel: 9, stats: make(map[int]levelStats)}
+	level = 5
+	for i := 0; i < 10; i++ {
+		simulate(&a, level, 0)
+		level = a.nextLevel(level)
+	}
+	if level != -3 {
+		t.Fatalf("Level should end at the minimum, got %v", level)
+	}
+
+	// With workers the level follows the side the writer waits on
+	a = adaptiveLevel{minLevel: -2, maxLevel: 2, pipelined: true}
+	a.writeTime = time.Second
+	for level, next := range map[int]int{-2: -1, -1: 1, 1: 2, 2: 2} {
+		if got := a.nextLevel(level); got != next {
+			t.Fatalf("Level %v should go up to %v, got %v", level, next, got)
+		}
+	}
+	a.writeTime, a.compressTime = 0, time.Second
+	for level, next := range map[int]int{2: 1, 1: -1, -1: -2, -2: -2} {
+		if got := a.nextLevel(level); got != next {
+			t.Fatalf("Level %v should go down to %v, got %v", level, next, got)
+		}
+	}
+	a.writeTime, a.compressTime = time.Second, 3*time.Second/2
+	if got := a.nextLevel(1); got != 1 {
+		t.Fatalf("Level should not change, got %v", got)
+	}
+}
+
+// linkWriter simulates a network link of the given bandwidth
+type linkWriter struct {
+	bytesPerSecond int
+}
+
+func (w linkWriter) Write(p []byte) (int, error) {
+	time.Sleep(time.Duration(len(p)) * time.Second / time.Duration(w.bytesPerSecond))
+	return len(p), nil
+}
+
+// BenchmarkWriterAdaptive streams log lines to a simulated 20 MB/s link with
+// fixed levels and with an adaptive writer, reporting the end to end speed.
+// Low levels are limited by the link, high levels by compression.
+func BenchmarkWriterAdaptive(b *testing.B) {
+	payload := makePayload(16 << 20)
+	link := linkWriter{bytesPerSecond: 20 << 20}
+	for _, bench := range []struct {
+		name      string
+		newWriter func() *Writer
+	}{
+		{"Level-5", func() *Writer { return NewWriterLevel(link, -5) }},
+		{"Level1", func() *Writer { return NewWriterLevel(link, 1) }},
+		{"Level5", func() *Writer { return NewWriterLevel(link, 5) }},
+		{"Level15", func() *Writer { return NewWriterLevel(link, 15) }},
+		{"Adaptive", func() *Writer { return NewWriterAdaptive(link, -5, 19, 0) }},
+	} {
+		b.Run(bench.name, func(b *testing.B) {
+			b.SetBytes(int64(len(payload)))
+			for i := 0; i < b.N; i++ {
+				w := bench.newWriter()
+				if _, err := w.Write(payload); err != nil {
+					b.Fatalf("Failed writing to compress object: %s", err)
+				}
+				level := w.CompressionLevel
+				if err := w.Close(); err != nil {
+					b.Fatalf("Failed to close compress object: %s", err)
+				}
+				if i == 0 {
+					b.Logf("final level %d", level)
+				}
+			}
+		})
+	}
+}
@@ -0,0 +1,311 @@
+package zstd1
+
+/*
+#define ZSTD1_STATIC_LINKING_ONLY
+#include "zstd.h"
+#include "stdint.h"  // for uintptr_t
+
+// See zstd_ctx.go for why buffers are passed as uintptr_t.  The batch item
+// array itself is Go memory holding no Go pointers, only their addresses.
+
+typedef struct batch_item_s {
+	uintptr_t dst;
+	size_t dst_capacity;
+	uintptr_t src;
+	size_t src_size;
+	size_t result;
+} batch_item;
+
+// Items with an empty src are skipped, their result is left untouched.
+
+static void ZSTD1_compressBatch_wrapper(ZSTD1_CCtx* cctx, uintptr_t items, size_t nbItems, int compressionLevel, const ZSTD1_CDict* cdict, int attach) {
+	batch_item* item = (batch_item*)items;
+	batch_item* const end = item + nbItems;
+	if (cdict != NULL) ZSTD1_CCtx_setParameter(cctx, ZSTD1_p_forceAttachDict, attach);  // validated by SetAttach
+	for (; item < end; item++) {
+		if (item->src_size == 0) continue;
+		if (cdict != NULL) {
+			item->result = ZSTD1_compress_usingCDict(cctx, (void*)item->dst, item->dst_capacity, (const void*)item->src, item->src_size, cdict);
+		} else {
+			item->result = ZSTD1_compressCCtx(cctx, (void*)item->dst, item->dst_capacity, (const void*)item->src, item->src_size, compressionLevel);
+		}
+	}
+}
+
+// Stores the decompressed size of every frame in result
+static void ZSTD1_findDecompressedSizeBatch_wrapper(uintptr_t items, size_t nbItems) {
+	batch_item* item = (batch_item*)items;
+	batch_item* const end = item + nbItems;
+	for (; item < end; item++) {
+		if (item->src_size == 0) continue;
+		item->result = (size_t)ZSTD1_findDecompressedSize((const void*)item->src, item->src_size);
+	}
+}
+
+// Items with no dst, whose size is unknown, are skipped as well
+static void ZSTD1_decompressBatch_wrapper(ZSTD1_DCtx* dctx, uintptr_t items, size_t nbItems, const ZSTD1_DDict* ddict) {
+	batch_item* item = (batch_item*)items;
+	batch_item* const end = item + nbItems;
+	for (; item < end; item++) {
+		if (item->src_size == 0 || item->dst == 0) continue;
+		if (ddict != NULL) {
+			item->result = ZSTD1_decompress_usingDDict(dctx, (void*)item->dst, item->dst_capacity, (const void*)item->src, item->src_size, ddict);
+		} else {
+			item->result = ZSTD1_decompressDCtx(dctx, (void*)item->dst, item->dst_capacity, (const void*)item->src, item->src_size);
+		}
+	}
+}
+*/
+import "C"
+import (
+	"fmt"
+	"runtime"
+	"unsafe"
+)
+
+// BatchError is returned by the batch functions when some items failed.  It
+// holds the error of every item, indexed like the input, nil for items that
+// succeeded.
+type BatchError []error
+
+// Error reports how many items failed and the first failure
+func (e BatchError) Error() string {
+	failed, first := 0, -1
+	for i, err := range e {
+		if err != nil {
+			failed++
+			if first < 0 {
+				first = i
+			}
+		}
+	}
+	return fmt.Sprintf("%d of %d batch items failed, item %d: %s", failed, len(e), first, e[first])
+}
+
+// batchItems returns the C descriptors of srcs, with dst left empty
+func batchItems(srcs [][]byte) []C.batch_item {
+	items := make([]C.batch_item, len(srcs))
+	for i, src := range srcs {
+		if len(src) > 0 {
+			items[i].src = C.uintptr_t(uintptr(unsafe.Pointer(&src[0])))
+			items[i].src_size = C.size_t(len(src))
+		}
+	}
+	return items
+}
+
+// batchDsts returns the destination of every item, reusing dsts[i] when its
+// capacity is at least sizes[i] and carving the others out of a single
+// allocation.  Items with a negative size get no destination.
+func batchDsts(dsts [][]byte, sizes []int) [][]byte {
+	out := make([][]byte, len(sizes))
+	missing := 0
+	for i, size := range sizes {
+		if size < 0 {
+			continue
+		}
+		if i < len(dsts) && cap(dsts[i]) >= size {
+			out[i] = dsts[i][:size]
+		} else {
+			missing += size
+		}
+	}
+	if missing > 0 {
+		buf := make([]byte, missing)
+		for i, size := range sizes {
+			if size >= 0 && out[i] == nil {
+				out[i], buf = buf[:size:size], buf[size:]
+			}
+		}
+	}
+	return out
+}
+
+// CompressBatch compresses every slice of srcs independently, like calling
+// CompressLevel on each of them, but in a single call into C with a single
+// context.  This amortizes the cost of crossing into C and setting up the
+// context over the whole batch, which matters for many small messages.
+//
+// dsts is optional: dsts[i] is reused for srcs[i] when it has enough capacity,
+// and the other outputs share a single allocation.  The outputs are returned
+// in the same order as srcs.  If some items fail, the error is a BatchError
+// and the output of the failed items is nil.
+func CompressBatch(dsts, srcs [][]byte, level int) ([][]byte, error) {
+	return compressBatch(dsts, srcs, level, nil)
+}
+
+// CompressBatchDict is the same as CompressBatch but compresses every item
+// with a prepared dictionary, at the level it was created with.
+func CompressBatchDict(dsts, srcs [][]byte, dict *CompressionDict) ([][]byte, error) {
+	return compressBatch(dsts, srcs, dict.level, dict)
+}
+
+func compressBatch(dsts, srcs [][]byte, level int, dict *CompressionDict) ([][]byte, error) {
+	if len(srcs) == 0 {
+		return [][]byte{}, nil
+	}
+	if err := checkLevel(level); err != nil {
+		return nil, err
+	}
+	sizes := make([]int, len(srcs))
+	maxSize := 0
+	for i, src := range srcs {
+		sizes[i] = -1
+		if len(src) > 0 {
+			sizes[i] = CompressBound(len(src))
+		}
+		if len(src) > maxSize {
+			maxSize = len(src)
+		}
+	}
+	out := batchDsts(dsts, sizes)
+	items := batchItems(srcs)
+	for i, dst := range out {
+		if dst != nil {
+			items[i].dst = C.uintptr_t(uintptr(unsafe.Pointer(&dst[0])))
+			items[i].dst_capacity = C.size_t(len(dst))
+		}
+	}
+
+	var cdict *C.ZSTD1_CDict
+	var attach DictAttach
+	if dict != nil {
+		cdict, attach = dict.cdict, dict.attach
+	}
+	c, err := getCompressCtx(level, maxSize)
+	if err != nil {
+		return nil, err
+	}
+	C.ZSTD1_compressBatch_wrapper(
+		c.cctx,
+		C.uintptr_t(uintptr(unsafe.Pointer(&items[0]))),
+		C.size_t(len(items)),
+		C.int(level),
+		cdict,
+		C.int(attach))
+	runtime.KeepAlive(srcs)
+	runtime.KeepAlive(out)
+	runtime.KeepAlive(items)
+	runtime.KeepAlive(dict)
+	putCompressCtx(c)
+
+	return batchResults(out, srcs, items)
+}
+
+// DecompressBatch decompresses every slice of srcs independently, like
+// calling Decompress on each of them, in a single call into C with a single
+// context.  Buffer handling is the same as for CompressBatch.  Frames that do
+// not store their decompressed size are decompressed in streaming mode, one
+// by one.
+func DecompressBatch(dsts, srcs [][]byte) ([][]byte, error) {
+	return decompressBatch(dsts, srcs, nil)
+}
+
+// DecompressBatchDict is the same as DecompressBatch but decompresses every
+// item with a prepared dictionary.
+func DecompressBatchDict(dsts, srcs [][]byte, dict *DecompressionDict) ([][]byte, error) {
+	return decompressBatch(dsts, srcs, dict)
+}
+
+func decompressBatch(dsts, srcs [][]byte, dict *DecompressionDict) ([][]byte, error) {
+	if len(srcs) == 0 {
+		return [][]byte{}, nil
+	}
+	items := batchItems(srcs)
+	C.ZSTD1_findDecompressedSizeBatch_wrapper(
+		C.uintptr_t(uintptr(unsafe.Pointer(&items[0]))),
+		C.size_t(len(items)))
+	runtime.KeepAlive(srcs)
+
+	// Size the outputs like Decompress does, leaving out empty frames and
+	// frames of unknown size
+	sizes := make([]int, len(srcs))
+	for i := range items {
+		size := uint64(items[i].result)
+		sizes[i] = -1
+		if size != C.ZSTD1_CONTENTSIZE_UNKNOWN && size != C.ZSTD1_CONTENTSIZE_ERROR &&
+			size > 0 && size <= uint64(len(srcs[i]))*maxCompressionRatio {
+			sizes[i] = int(size)
+		}
+		items[i].result = 0
+	}
+	out := batchDsts(dsts, sizes)
+	for i, dst := range out {
+		if dst != nil {
+			items[i].dst = C.uintptr_t(uintptr(unsafe.Pointer(&dst[0])))
+			items[i].dst_capacity = C.size_t(len(dst))
+		}
+	}
+
+	var ddict *C.ZSTD1_DDict
+	if dict != nil {
+		ddict = dict.ddict
+	}
+	d, err := getDecompressCtx()
+	if err != nil {
+		return nil, err
+	}
+	defer putDecompressCtx(d)
+	C.ZSTD1_decompressBatch_wrapper(
+		d.dctx,
+		C.uintptr_t(uintptr(unsafe.Pointer(&items[0]))),
+		C.size_t(len(items)),
+		ddict)
+	runtime.KeepAlive(srcs)
+	runtime.KeepAlive(out)
+	runtime.KeepAlive(items)
+	runtime.KeepAlive(dict)
+
+	results, err := batchResults(out, srcs, items)
+
+	// Empty frames and frames of unknown size go through the regular path
+	for i, size := range sizes {
+		if size >= 0 || len(srcs[i]) == 0 {
+			continue
+		}
+		var dst []byte
+		if i < len(dsts) {
+			dst = dsts[i]
+		}
+		var itemErr error
+		if dict != nil {
+			results[i], itemErr = d.DecompressDict(dst, srcs[i], dict)
+		} else {
+			results[i], itemErr = d.Decompress(dst, srcs[i])
+		}
+		if itemErr != nil {
+			if err == nil {
+				err = make(BatchError, len(srcs))
+			}
+			err.(BatchError)[i] = itemErr
+		}
+	}
+	return results, err
+}
+
+// batchResults trims every output written by C to its size, and collects
+// the errors
+func batchResults(out, srcs [][]byte, items []C.batch_item) ([][]byte, error) {
+	var errs BatchError
+	for i := range items {
+		var err error
+		if len(srcs[i]) == 0 {
+			err = ErrEmptySlice
+		} else if items[i].dst != 0 {
+			written := int(items[i].result)
+			if err = getError(written); err == nil {
+				out[i] = out[i][:written]
+			}
+		}
+		if err != nil {
+			if errs == nil {
+				errs = make(BatchError, len(items))
+			}
+			out[i], errs[i] = nil, err
+		}
+	}
+	if errs != nil {
+		return out, errs
+	}
+	return out, nil
+}
@@ -0,0 +1,181 @@
+package zstd1
+
+import (
+	"bytes"
+	"fmt"
+	"testing"
+)
+
+func makeBatch(count, size int) [][]byte {
+	srcs := make([][]byte, count)
+	for i := range srcs {
+		srcs[i] = makePayload(size + i%50)
+	}
+	return srcs
+}
+
+func TestBatchCompressDecompress(t *testing.T) {
+	srcs := makeBatch(1000, 200)
+	compressed, err := CompressBatch(nil, srcs, DefaultCompression)
+	failOnError(t, "Failed to compress batch", err)
+	if len(compressed) != len(srcs) {
+		t.Fatalf("Got %v outputs for %v inputs", len(compressed), len(srcs))
+	}
+	for i := range srcs {
+		// Every item is a regular frame
+		decompressed, err := Decompress(nil, compressed[i])
+		failOnError(t, "Failed to decompress item", err)
+		if !bytes.Equal(srcs[i], decompressed) {
+			t.Fatalf("Item %v did not match", i)
+		}
+	}
+
+	decompressed, err := DecompressBatch(nil, compressed)
+	failOnError(t, "Failed to decompress batch", err)
+	for i := range srcs {
+		if !bytes.Equal(srcs[i], decompressed[i]) {
+			t.Fatalf("Item %v did not match", i)
+		}
+	}
+
+	// Large enough destinations are reused
+	dsts := make([][]byte, len(srcs))
+	for i := range dsts {
+		dsts[i] = make([]byte, 0, 1000)
+	}
+	decompressed, err = DecompressBatch(dsts, compressed)
+	failOnError(t, "Failed to decompress batch", err)
+	for i := range srcs {
+		if &decompressed[i][0] != &dsts[i][:1][0] {
+			t.Fatalf("dst of item %v was not reused", i)
+		}
+		if !bytes.Equal(srcs[i], decompressed[i]) {
+			t.Fatalf("Item %v did not match", i)
+		}
+	}
+}
+
+func TestBatchErrors(t *testing.T) {
+	srcs := makeBatch(10, 200)
+	srcs[3] = nil
+	compressed, err := CompressBatch(nil, srcs, DefaultCompression)
+	batchErr, ok := err.(BatchError)
+	if !ok || len(batchErr) != len(srcs) || batchErr[3] != ErrEmptySlice || compressed[3] != nil {
+		t.Fatalf("Did not get the correct error: %v", err)
+	}
+	for i, e := range batchErr {
+		if i != 3 && e != nil {
+			t.Fatalf("Item %v should not have failed: %s", i, e)
+		}
+	}
+
+	// Corrupt one frame, and make one of unknown size
+	compressed[3] = []byte("not a zstd frame")
+	var buf bytes.Buffer
+	w := NewWriter(&buf)
+	w.Write(srcs[5])
+	failOnError(t, "Failed to close compress object", w.Close())
+	compressed[5] = buf.Bytes()
+	decompressed, err := DecompressBatch(nil, compressed)
+	batchErr, ok = err.(BatchError)
+	if !ok || batchErr[3] == nil || decompressed[3] != nil {
+		t.Fatalf("Did not get the correct error: %v", err)
+	}
+	for i := range srcs {
+		if i != 3 && (batchErr[i] != nil || !bytes.Equal(srcs[i], decompressed[i])) {
+			t.Fatalf("Item %v did not match: %v", i, batchErr[i])
+		}
+	}
+
+	if out, err := CompressBatch(nil, nil, DefaultCompression); err != nil || len(out) != 0 {
+		t.Fatalf("Empty batch should succeed: %v", err)
+	}
+}
+
+func TestBatchDict(t *testing.T) {
+	cdict, ddict := newTestDicts(t, DefaultCompression)
+	defer cdict.Close()
+	defer ddict.Close()
+
+	srcs := makeBatch(100, 200)
+	compressed, err := CompressBatchDict(nil, srcs, cdict)
+	failOnError(t, "Failed to compress batch", err)
+	decompressed, err := DecompressBatchDict(nil, compressed, ddict)
+	failOnError(t, "Failed to decompress batch", err)
+	for i := range srcs {
+		if !bytes.Equal(srcs[i], decompressed[i]) {
+			t.Fatalf("Item %v did not match", i)
+		}
+		single, err := DecompressDict(nil, compressed[i], ddict)
+		failOnError(t, "Failed to decompress item", err)
+		if !bytes.Equal(srcs[i], single) {
+			t.Fatalf("Item %v did not match", i)
+		}
+	}
+}
+
+// The batch benchmarks process 10000 messages per op, the per message cost is
+// ns/op / 10000.
+func BenchmarkBatchCompression(b *testing.B) {
+	for _, size := range []int{64, 200, 1000} {
+		srcs := makeBatch(10000, size)
+		dsts := make([][]byte, len(srcs))
+		total := 0
+		for i := range srcs {
+			dsts[i] = make([]byte, CompressBound(len(srcs[i])))
+			total += len(srcs[i])
+		}
+		b.Run(fmt.Sprintf("Loop/%d", size), func(b *testing.B) {
+			b.SetBytes(int64(total))
+			for i := 0; i < b.N; i++ {
+				for j := range srcs {
+					if _, err := CompressLevel(dsts[j], srcs[j], DefaultCompression); err != nil {
+						b.Fatalf("Failed compressing: %s", err)
+					}
+				}
+			}
+		})
+		b.Run(fmt.Sprintf("Batch/%d", size), func(b *testing.B) {
+			b.SetBytes(int64(total))
+			for i := 0; i < b.N; i++ {
+				if _, err := CompressBatch(dsts, srcs, DefaultCompression); err != nil {
+					b.Fatalf("Failed compressing: %s", err)
+				}
+			}
+		})
+	}
+}
+
+func BenchmarkBatchDecompression(b *testing.B) {
+	for _, size := range []int{64, 200, 1000} {
+		srcs := makeBatch(10000, size)
+		compressed, err := CompressBatch(nil, srcs, DefaultCompression)
+		if err != nil {
+			b.Fatalf("Failed compressing: %s", err)
+		}
+		dsts := make([][]byte, len(srcs))
+		total := 0
+		for i := range srcs {
+			dsts[i] = make([]byte, len(srcs[i]))
+			total += len(srcs[i])
+		}
+		b.Run(fmt.Sprintf("Loop/%d", size), func(b *testing.B) {
+			b.SetBytes(int64(total))
+			for i := 0; i < b.N; i++ {
+				for j := range compressed {
+					if _, err := Decompress(dsts[j], compressed[j]); err != nil {
+						b.Fatalf("Failed decompressing: %s", err)
+					}
+				}
+			}
+		})
+		b.Run(fmt.Sprintf("Batch/%d", size), func(b *testing.B) {
+			b.SetBytes(int64(total))
+			for i := 0; i < b.N; i++ {
+				if _, err := DecompressBatch(dsts, compressed); err != nil {
+					b.Fatalf("Failed decompressing: %s", err)
+				}
+			}
+		})
+	}
+}
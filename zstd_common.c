@@ -16,7 +16,11 @@
 #include <stdlib.h>      /* malloc, calloc, free */
 #include <string.h>      /* memset */
 #include "error_private.h"
+#include "cpu.h"         /* ZSTD1_cpuid */
 #include "zstd_internal.h"
+#if DYNAMIC_AVX2
+#  include <immintrin.h>
+#endif
 
 
 /*-****************************************
@@ -46,6 +50,132 @@ ZSTD1_ErrorCode ZSTD1_getErrorCode(size_t code) { return ERR_getErrorCode(code);
  *  provides error code string from enum */
 const char* ZSTD1_getErrorString(ZSTD1_ErrorCode code) { return ERR_getErrorString(code); }
 
+/*-****************************************
+*  CPU dispatch
+******************************************/
+/* Read by the contexts of every thread, and changed by ZSTD1_forceCpuImpl()
+ * at any time : accessed atomically.  Relaxed ordering is enough, each value
+ * is valid on its own and guards no other data. */
+static int g_cpuImplDetected = -1;   /* ZSTD1_cpuImpl_e, once detected */
+static int g_cpuImplForced = ZSTD1_cpu_auto;
+ZSTD1_countWide_f ZSTD1_countWide = NULL;   /* kernel of the tier in use, see zstd_internal.h */
+
+#if DYNAMIC_AVX2
+/* bit n set if pIn[n] == pMatch[n] */
+static TARGET_ATTRIBUTE("avx2") U32 ZSTD1_equalBytes32(const BYTE* pIn, const BYTE* pMatch)
+{
+    __m256i const in = _mm256_loadu_si256((const __m256i*)pIn);
+    __m256i const match = _mm256_loadu_si256((const __m256i*)pMatch);
+    return (U32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(in, match));
+}
+
+static TARGET_ATTRIBUTE("avx2,bmi2") size_t
+ZSTD1_count_avx2(const BYTE* pIn, const BYTE* pMatch, const BYTE* const pInLimit)
+{
+    const BYTE* const pStart = pIn;
+    assert(pInLimit - pIn >= ZSTD1_COUNT_WIDE_MIN);
+    while (pInLimit - pIn >= 32) {
+        U32 const equal = ZSTD1_equalBytes32(pIn, pMatch);
+        if (equal != 0xFFFFFFFFU) return (size_t)(pIn - pStart) + __builtin_ctz(~equal);
+        pIn += 32; pMatch += 32;
+    }
+    /* the last 32 bytes overlap bytes already found equal */
+    {   size_t const back = 32 - (size_t)(pInLimit - pIn);
+        U32 const equal = ZSTD1_equalBytes32(pInLimit - 32, pMatch - back);
+        if (equal != 0xFFFFFFFFU) return (size_t)(pInLimit - 32 - pStart) + __builtin_ctz(~equal);
+        return (size_t)(pInLimit - pStart);
+    }
+}
+#endif
+
+#if DYNAMIC_AVX512
+static TARGET_ATTRIBUTE("avx512f,avx512bw,bmi2") size_t
+ZSTD1_count_avx512(const BYTE* pIn, const BYTE* pMatch, const BYTE* const pInLimit)
+{
+    const BYTE* const pStart = pIn;
+    assert(pInLimit - pIn >= ZSTD1_COUNT_WIDE_MIN);
+    while (pInLimit - pIn >= 64) {
+        U64 const diff = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(pIn), _mm512_loadu_si512(pMatch));
+        if (diff) return (size_t)(pIn - pStart) + __builtin_ctzll(diff);
+        pIn += 64; pMatch += 64;
+    }
+    /* masked loads do not touch the bytes past pInLimit */
+    {   __mmask64 const rest = ((U64)1 << (pInLimit - pIn)) - 1;
+        U64 const diff = _mm512_mask_cmpneq_epi8_mask(rest,
+                            _mm512_maskz_loadu_epi8(rest, pIn), _mm512_maskz_loadu_epi8(rest, pMatch));
+        if (diff) return (size_t)(pIn - pStart) + __builtin_ctzll(diff);
+        return (size_t)(pInLimit - pStart);
+    }
+}
+#endif
+
+static const ZSTD1_countWide_f ZSTD1_countWide_impl[ZSTD1_cpu_avx512+1] = {
+    NULL, NULL, NULL,   /* auto, generic, bmi2 : scalar loop */
+#if DYNAMIC_AVX2
+    ZSTD1_count_avx2,
+#else
+    NULL,
+#endif
+#if DYNAMIC_AVX512
+    ZSTD1_count_avx512
+#elif DYNAMIC_AVX2
+    ZSTD1_count_avx2
+#else
+    NULL
+#endif
+};
+
+/* ZSTD1_count() is inlined in every match finder, which have no context at
+ * hand : its kernel is published here, for the tier just detected or forced.
+ * Concurrent ZSTD1_forceCpuImpl() calls may leave the kernel of either tier,
+ * which are both supported. */
+static void ZSTD1_publishCpuImpl(ZSTD1_cpuImpl_e impl)
+{
+    __atomic_store_n(&ZSTD1_countWide, ZSTD1_countWide_impl[impl], __ATOMIC_RELAXED);
+}
+
+static ZSTD1_cpuImpl_e ZSTD1_detectCpuImpl(void)
+{
+    ZSTD1_cpuid_t const cpuid = ZSTD1_cpuid();
+    if (!ZSTD1_cpuid_bmi2(cpuid)) return ZSTD1_cpu_generic;
+    if (!ZSTD1_cpuid_avx2usable(cpuid)) return ZSTD1_cpu_bmi2;
+    if (!ZSTD1_cpuid_avx512usable(cpuid)) return ZSTD1_cpu_avx2;
+    return ZSTD1_cpu_avx512;
+}
+
+static ZSTD1_cpuImpl_e ZSTD1_bestCpuImpl(void)
+{
+    int detected = __atomic_load_n(&g_cpuImplDetected, __ATOMIC_RELAXED);
+    if (detected < 0) {   /* threads racing here all detect the same tier */
+        detected = ZSTD1_detectCpuImpl();
+        __atomic_store_n(&g_cpuImplDetected, detected, __ATOMIC_RELAXED);
+        if (__atomic_load_n(&g_cpuImplForced, __ATOMIC_RELAXED) == ZSTD1_cpu_auto)
+            ZSTD1_publishCpuImpl((ZSTD1_cpuImpl_e)detected);
+    }
+    return (ZSTD1_cpuImpl_e)detected;
+}
+
+ZSTD1_cpuImpl_e ZSTD1_getCpuImpl(void)
+{
+    int const forced = __atomic_load_n(&g_cpuImplForced, __ATOMIC_RELAXED);
+    if (forced != ZSTD1_cpu_auto) return (ZSTD1_cpuImpl_e)forced;
+    return ZSTD1_bestCpuImpl();
+}
+
+unsigned ZSTD1_isCpuImplSupported(ZSTD1_cpuImpl_e impl)
+{
+    return (unsigned)impl <= (unsigned)ZSTD1_bestCpuImpl();
+}
+
+size_t ZSTD1_forceCpuImpl(ZSTD1_cpuImpl_e impl)
+{
+    if (!ZSTD1_isCpuImplSupported(impl)) return ERROR(parameter_unsupported);
+    __atomic_store_n(&g_cpuImplForced, (int)impl, __ATOMIC_RELAXED);
+    ZSTD1_publishCpuImpl(ZSTD1_getCpuImpl());
+    return 0;
+}
+
+
 /*! g_debuglog_enable :
  *  turn on/off debug traces (global switch) */
 #if defined(ZSTD1_DEBUG) && (ZSTD1_DEBUG >= 2)
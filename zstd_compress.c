@@ -21,7 +21,6 @@
 *  Dependencies
 ***************************************/
 #include <string.h>         /* memset */
-#include "cpu.h"
 #include "mem.h"
 #define FSE1_STATIC_LINKING_ONLY   /* FSE1_encodeSymbol */
 #include "fse.h"
@@ -74,7 +73,7 @@ ZSTD1_CCtx* ZSTD1_createCCtx_advanced(ZSTD1_customMem customMem)
         cctx->customMem = customMem;
         cctx->requestedParams.compressionLevel = ZSTD1_CLEVEL_DEFAULT;
         cctx->requestedParams.fParams.contentSizeFlag = 1;
-        cctx->bmi2 = ZSTD1_cpuid_bmi2(ZSTD1_cpuid());
+        cctx->bmi2 = ZSTD1_getCpuImpl() >= ZSTD1_cpu_bmi2;
         return cctx;
     }
 }
@@ -98,7 +97,7 @@ ZSTD1_CCtx* ZSTD1_initStaticCCtx(void *workspace, size_t workspaceSize)
         void* const ptr = cctx->blockState.nextCBlock + 1;
         cctx->entropyWorkspace = (U32*)ptr;
     }
-    cctx->bmi2 = ZSTD1_cpuid_bmi2(ZSTD1_cpuid());
+    cctx->bmi2 = ZSTD1_getCpuImpl() >= ZSTD1_cpu_bmi2;
     return cctx;
 }
 
@@ -260,6 +259,7 @@ static int ZSTD1_isUpdateAuthorized(ZSTD1_cParameter param)
     case ZSTD1_p_checksumFlag:
     case ZSTD1_p_dictIDFlag:
     case ZSTD1_p_forceMaxWindow :
+    case ZSTD1_p_forceAttachDict :
     case ZSTD1_p_nbWorkers:
     case ZSTD1_p_jobSize:
     case ZSTD1_p_overlapSizeLog:
@@ -311,6 +311,7 @@ size_t ZSTD1_CCtx_setParameter(ZSTD1_CCtx* cctx, ZSTD1_cParameter param, unsigne
     case ZSTD1_p_forceMaxWindow :  /* Force back-references to remain < windowSize,
                                    * even when referencing into Dictionary content.
                                    * default : 0 when using a CDict, 1 when using a Prefix */
+    case ZSTD1_p_forceAttachDict :
         return ZSTD1_CCtxParam_setParameter(&cctx->requestedParams, param, value);
 
     case ZSTD1_p_nbWorkers:
@@ -423,6 +424,11 @@ size_t ZSTD1_CCtxParam_setParameter(
         CCtxParams->forceWindow = (value > 0);
         return CCtxParams->forceWindow;
 
+    case ZSTD1_p_forceAttachDict :
+        if (value > (unsigned)ZSTD1_dictForceCopy) return ERROR(parameter_outOfBound);
+        CCtxParams->attachDictPref = (ZSTD1_dictAttachPref_e)value;
+        return CCtxParams->attachDictPref;
+
     case ZSTD1_p_nbWorkers :
 #ifndef ZSTD1_MULTITHREAD
         if (value>0) return ERROR(parameter_unsupported);
@@ -868,6 +874,7 @@ static void ZSTD1_invalidateMatchState(ZSTD1_matchState_t* ms)
     ms->nextToUpdate = ms->window.dictLimit + 1;
     ms->loadedDictEnd = 0;
     ms->opt.litLengthSum = 0;  /* force reset of btopt stats */
+    ms->dictMatchState = NULL;
 }
 
 /*! ZSTD1_continueCCtx() :
@@ -951,6 +958,9 @@ static size_t ZSTD1_resetCCtx_internal(ZSTD1_CCtx* zc,
     DEBUGLOG(4, "ZSTD1_resetCCtx_internal: pledgedSrcSize=%u, wlog=%u",
                 (U32)pledgedSrcSize, params.cParams.windowLog);
     assert(!ZSTD1_isError(ZSTD1_checkCParams(params.cParams)));
+    {   ZSTD1_cpuImpl_e const cpuImpl = ZSTD1_getCpuImpl();   /* follows ZSTD1_forceCpuImpl() between frames */
+        zc->bmi2 = cpuImpl >= ZSTD1_cpu_bmi2;
+    }
 
     if (crp == ZSTDcrp_continue) {
         if (ZSTD1_equivalentParams(zc->appliedParams, params,
@@ -1098,6 +1108,75 @@ void ZSTD1_invalidateRepCodes(ZSTD1_CCtx* cctx) {
     assert(!ZSTD1_window_hasExtDict(cctx->blockState.matchState.window));
 }
 
+/* Up to these input sizes, the default policy searches the CDict's tables in
+ * place rather than copying them : copying costs as much as compressing tens
+ * of KB, while the in-place search adds a second lookup per position.
+ * Strategies above ZSTD1_lazy2 have no dictMatchState variant and always copy. */
+static const size_t attachDictSizeCutoffs[(unsigned)ZSTD1_btultra+1] = {
+    8 KB,  /* unused */
+    8 KB,  /* ZSTD1_fast */
+    16 KB, /* ZSTD1_dfast */
+    32 KB, /* ZSTD1_greedy */
+    32 KB, /* ZSTD1_lazy */
+    32 KB, /* ZSTD1_lazy2 */
+    0,     /* ZSTD1_btlazy2 */
+    0,     /* ZSTD1_btopt */
+    0      /* ZSTD1_btultra */
+};
+
+static int ZSTD1_shouldAttachDict(const ZSTD1_CDict* cdict,
+                                 ZSTD1_CCtx_params const* params,
+                                 U64 pledgedSrcSize)
+{
+    size_t const cutoff = attachDictSizeCutoffs[cdict->cParams.strategy];
+    if (cutoff == 0) return 0;   /* no dictMatchState block compressor */
+    if (params->forceWindow || params->ldmParams.enableLdm) return 0;
+    switch (params->attachDictPref) {
+    case ZSTD1_dictForceAttach: return 1;
+    case ZSTD1_dictForceCopy: return 0;
+    default:
+        return pledgedSrcSize <= cutoff
+            || pledgedSrcSize == ZSTD1_CONTENTSIZE_UNKNOWN;
+    }
+}
+
+/*! ZSTD1_resetCCtx_attachDict() :
+ *  References the match state of `cdict` from the context instead of copying
+ *  its tables : the block compressors search it in place, while the context's
+ *  own tables only index the new input.  Indexes of the prefix are moved past
+ *  the end of the dictionary, so that a dictionary index translates to the
+ *  context's index space by adding (prefixStart - dictEnd). */
+static size_t ZSTD1_resetCCtx_attachDict(ZSTD1_CCtx* cctx,
+                            const ZSTD1_CDict* cdict,
+                            ZSTD1_CCtx_params params,
+                            U64 pledgedSrcSize,
+                            ZSTD1_buffered_policy_e zbuff)
+{
+    ZSTD1_matchState_t* const ms = &cctx->blockState.matchState;
+    U32 const cdictEnd = (U32)(cdict->matchState.window.nextSrc - cdict->matchState.window.base);
+
+    /* continue mode keeps the context's tables : their stale entries are all
+     * below the prefix, hence never matched */
+    CHECK_F( ZSTD1_resetCCtx_internal(cctx, params, pledgedSrcSize,
+                                     ZSTDcrp_continue, zbuff) );
+    assert(cctx->appliedParams.cParams.hashLog == cdict->cParams.hashLog);
+    assert(cctx->appliedParams.cParams.chainLog == cdict->cParams.chainLog);
+
+    if (ms->window.dictLimit < cdictEnd) {
+        ms->window.nextSrc = ms->window.base + cdictEnd;
+        ZSTD1_window_clear(&ms->window);
+        ms->nextToUpdate = ms->window.dictLimit + 1;
+    }
+    ms->loadedDictEnd = ms->window.dictLimit;
+    ms->dictMatchState = &cdict->matchState;
+    cctx->dictID = cdict->dictID;
+
+    /* copy block state */
+    memcpy(cctx->blockState.prevCBlock, &cdict->cBlockState, sizeof(cdict->cBlockState));
+
+    return 0;
+}
+
 static size_t ZSTD1_resetCCtx_usingCDict(ZSTD1_CCtx* cctx,
                             const ZSTD1_CDict* cdict,
                             unsigned windowLog,
@@ -1105,6 +1184,14 @@ static size_t ZSTD1_resetCCtx_usingCDict(ZSTD1_CCtx* cctx,
                             U64 pledgedSrcSize,
                             ZSTD1_buffered_policy_e zbuff)
 {
+    if (ZSTD1_shouldAttachDict(cdict, &cctx->requestedParams, pledgedSrcSize)) {
+        ZSTD1_CCtx_params params = cctx->requestedParams;
+        params.cParams = cdict->cParams;
+        if (windowLog) params.cParams.windowLog = windowLog;
+        params.fParams = fParams;
+        return ZSTD1_resetCCtx_attachDict(cctx, cdict, params, pledgedSrcSize, zbuff);
+    }
+
     {   ZSTD1_CCtx_params params = cctx->requestedParams;
         /* Copy only compression parameters related to tables. */
         params.cParams = cdict->cParams;
@@ -1198,6 +1285,7 @@ static size_t ZSTD1_copyCCtx_internal(ZSTD1_CCtx* dstCCtx,
         dstMatchState->nextToUpdate = srcMatchState->nextToUpdate;
         dstMatchState->nextToUpdate3= srcMatchState->nextToUpdate3;
         dstMatchState->loadedDictEnd= srcMatchState->loadedDictEnd;
+        dstMatchState->dictMatchState = srcMatchState->dictMatchState;
     }
     dstCCtx->dictID = srcCCtx->dictID;
 
@@ -1854,9 +1942,9 @@ MEM_STATIC size_t ZSTD1_compressSequences(seqStore_t* seqStorePtr,
 /* ZSTD1_selectBlockCompressor() :
  * Not static, but internal use only (used by long distance matcher)
  * assumption : strat is a valid strategy */
-ZSTD1_blockCompressor ZSTD1_selectBlockCompressor(ZSTD1_strategy strat, int extDict)
+ZSTD1_blockCompressor ZSTD1_selectBlockCompressor(ZSTD1_strategy strat, ZSTD1_dictMode_e dictMode)
 {
-    static const ZSTD1_blockCompressor blockCompressor[2][(unsigned)ZSTD1_btultra+1] = {
+    static const ZSTD1_blockCompressor blockCompressor[3][(unsigned)ZSTD1_btultra+1] = {
         { ZSTD1_compressBlock_fast  /* default for 0 */,
           ZSTD1_compressBlock_fast, ZSTD1_compressBlock_doubleFast, ZSTD1_compressBlock_greedy,
           ZSTD1_compressBlock_lazy, ZSTD1_compressBlock_lazy2, ZSTD1_compressBlock_btlazy2,
@@ -1864,13 +1952,18 @@ ZSTD1_blockCompressor ZSTD1_selectBlockCompressor(ZSTD1_strategy strat, int extD
         { ZSTD1_compressBlock_fast_extDict  /* default for 0 */,
           ZSTD1_compressBlock_fast_extDict, ZSTD1_compressBlock_doubleFast_extDict, ZSTD1_compressBlock_greedy_extDict,
           ZSTD1_compressBlock_lazy_extDict,ZSTD1_compressBlock_lazy2_extDict, ZSTD1_compressBlock_btlazy2_extDict,
-          ZSTD1_compressBlock_btopt_extDict, ZSTD1_compressBlock_btultra_extDict }
+          ZSTD1_compressBlock_btopt_extDict, ZSTD1_compressBlock_btultra_extDict },
+        { ZSTD1_compressBlock_fast_dictMatchState  /* default for 0 */,
+          ZSTD1_compressBlock_fast_dictMatchState, ZSTD1_compressBlock_doubleFast_dictMatchState, ZSTD1_compressBlock_greedy_dictMatchState,
+          ZSTD1_compressBlock_lazy_dictMatchState, ZSTD1_compressBlock_lazy2_dictMatchState, NULL,
+          NULL, NULL }   /* see ZSTD1_shouldAttachDict() */
     };
     ZSTD1_STATIC_ASSERT((unsigned)ZSTD1_fast == 1);
 
     assert((U32)strat >= (U32)ZSTD1_fast);
     assert((U32)strat <= (U32)ZSTD1_btultra);
-    return blockCompressor[extDict!=0][(U32)strat];
+    assert(blockCompressor[(int)dictMode][(U32)strat] != NULL);
+    return blockCompressor[(int)dictMode][(U32)strat];
 }
 
 static void ZSTD1_storeLastLiterals(seqStore_t* seqStorePtr,
@@ -1909,7 +2002,7 @@ static size_t ZSTD1_compressBlock_internal(ZSTD1_CCtx* zc,
     }
 
     /* select and store sequences */
-    {   U32 const extDict = ZSTD1_window_hasExtDict(ms->window);
+    {   ZSTD1_dictMode_e const dictMode = ZSTD1_matchState_dictMode(ms);
         size_t lastLLSize;
         {   int i;
             for (i = 0; i < ZSTD1_REP_NUM; ++i)
@@ -1923,7 +2016,7 @@ static size_t ZSTD1_compressBlock_internal(ZSTD1_CCtx* zc,
                                        ms, &zc->seqStore,
                                        zc->blockState.nextCBlock->rep,
                                        &zc->appliedParams.cParams,
-                                       src, srcSize, extDict);
+                                       src, srcSize, dictMode);
             assert(zc->externSeqStore.pos <= zc->externSeqStore.size);
         } else if (zc->appliedParams.ldmParams.enableLdm) {
             rawSeqStore_t ldmSeqStore = {NULL, 0, 0, 0};
@@ -1940,12 +2033,19 @@ static size_t ZSTD1_compressBlock_internal(ZSTD1_CCtx* zc,
                                        ms, &zc->seqStore,
                                        zc->blockState.nextCBlock->rep,
                                        &zc->appliedParams.cParams,
-                                       src, srcSize, extDict);
+                                       src, srcSize, dictMode);
             assert(ldmSeqStore.pos == ldmSeqStore.size);
         } else {   /* not long range mode */
-            ZSTD1_blockCompressor const blockCompressor = ZSTD1_selectBlockCompressor(zc->appliedParams.cParams.strategy, extDict);
+            ZSTD1_blockCompressor const blockCompressor = ZSTD1_selectBlockCompressor(zc->appliedParams.cParams.strategy, dictMode);
             lastLLSize = blockCompressor(ms, &zc->seqStore, zc->blockState.nextCBlock->rep, &zc->appliedParams.cParams, src, srcSize);
         }
+        /* Without literal compression (negative levels), a block whose
+         * matches save less than ZSTD1_minGain() can only be stored raw :
+         * skip copying its last literals and encoding its sequences */
+        if (zc->appliedParams.disableLiteralCompression) {
+            size_t const litSize = (size_t)(zc->seqStore.lit - zc->seqStore.litStart) + lastLLSize;
+            if (litSize + ZSTD1_minGain(srcSize) >= srcSize) return 0;   /* block not compressed */
+        }
         {   const BYTE* const lastLiterals = (const BYTE*)src + srcSize - lastLLSize;
             ZSTD1_storeLastLiterals(&zc->seqStore, lastLiterals, lastLLSize);
     }   }
@@ -2010,8 +2110,10 @@ static size_t ZSTD1_compress_frameChunk (ZSTD1_CCtx* cctx,
             if (ms->nextToUpdate < correction) ms->nextToUpdate = 0;
             else ms->nextToUpdate -= correction;
             ms->loadedDictEnd = 0;
+            ms->dictMatchState = NULL;
         }
         ZSTD1_window_enforceMaxDist(&ms->window, ip + blockSize, maxDist, &ms->loadedDictEnd);
+        if (ms->loadedDictEnd == 0) ms->dictMatchState = NULL;   /* attached dictionary out of reach */
         if (ms->nextToUpdate < ms->window.lowLimit) ms->nextToUpdate = ms->window.lowLimit;
 
         {   size_t cSize = ZSTD1_compressBlock_internal(cctx,
@@ -111,7 +111,10 @@ typedef struct {
     U32 lowLimit;           /* below that point, no more data */
 } ZSTD1_window_t;
 
-typedef struct {
+typedef enum { ZSTD1_noDict = 0, ZSTD1_extDict = 1, ZSTD1_dictMatchState = 2 } ZSTD1_dictMode_e;
+
+typedef struct ZSTD1_matchState_t ZSTD1_matchState_t;
+struct ZSTD1_matchState_t {
     ZSTD1_window_t window;      /* State for window round buffer management */
     U32 loadedDictEnd;         /* index of end of dictionary */
     U32 nextToUpdate;          /* index from which to continue table update */
@@ -121,7 +124,8 @@ typedef struct {
     U32* hashTable3;
     U32* chainTable;
     optState_t opt;         /* optimal parser state */
-} ZSTD1_matchState_t;
+    const ZSTD1_matchState_t* dictMatchState;  /* attached CDict tables, searched in place (see ZSTD1_resetCCtx_usingCDict) */
+};
 
 typedef struct {
     ZSTD1_compressedBlockState_t* prevCBlock;
@@ -173,6 +177,7 @@ struct ZSTD1_CCtx_params_s {
     int disableLiteralCompression;
     int forceWindow;           /* force back-references to respect limit of
                                 * 1<<wLog, even for dictionary */
+    ZSTD1_dictAttachPref_e attachDictPref;
 
     /* Multithreading: used to pass parameters to mtctx */
     unsigned nbWorkers;
@@ -189,7 +194,7 @@ struct ZSTD1_CCtx_params_s {
 struct ZSTD1_CCtx_s {
     ZSTD1_compressionStage_e stage;
     int cParamsChanged;                  /* == 1 if cParams(except wlog) or compression level are changed in requestedParams. Triggers transmission of new params to ZSTDMT (if available) then reset to 0. */
-    int bmi2;                            /* == 1 if the CPU supports BMI2 and 0 otherwise. CPU support is determined dynamically once per context lifetime. */
+    int bmi2;                            /* == 1 if the BMI2 variants of the entropy coders are used, see ZSTD1_getCpuImpl() */
     ZSTD1_CCtx_params requestedParams;
     ZSTD1_CCtx_params appliedParams;
     U32   dictID;
@@ -239,7 +244,7 @@ struct ZSTD1_CCtx_s {
 typedef size_t (*ZSTD1_blockCompressor) (
         ZSTD1_matchState_t* bs, seqStore_t* seqStore, U32 rep[ZSTD1_REP_NUM],
         ZSTD1_compressionParameters const* cParams, void const* src, size_t srcSize);
-ZSTD1_blockCompressor ZSTD1_selectBlockCompressor(ZSTD1_strategy strat, int extDict);
+ZSTD1_blockCompressor ZSTD1_selectBlockCompressor(ZSTD1_strategy strat, ZSTD1_dictMode_e dictMode);
 
 
 MEM_STATIC U32 ZSTD1_LLcode(U32 litLength)
@@ -397,6 +402,11 @@ MEM_STATIC size_t ZSTD1_count(const BYTE* pIn, const BYTE* pMatch, const BYTE* c
         { size_t const diff = MEM_readST(pMatch) ^ MEM_readST(pIn);
           if (diff) return ZSTD1_NbCommonBytes(diff); }
         pIn+=sizeof(size_t); pMatch+=sizeof(size_t);
+        /* short matches end above, without the cost of a call */
+        {   ZSTD1_countWide_f const countWide = ZSTD1_getCountWide();
+            if (countWide != NULL && pInLimit - pIn >= ZSTD1_COUNT_WIDE_MIN)
+                return sizeof(size_t) + countWide(pIn, pMatch, pInLimit);
+        }
         while (pIn < pInLoopLimit) {
             size_t const diff = MEM_readST(pMatch) ^ MEM_readST(pIn);
             if (!diff) { pIn+=sizeof(size_t); pMatch+=sizeof(size_t); continue; }
@@ -496,6 +506,20 @@ MEM_STATIC U32 ZSTD1_window_hasExtDict(ZSTD1_window_t const window)
     return window.lowLimit < window.dictLimit;
 }
 
+/**
+ * ZSTD1_matchState_dictMode():
+ * Returns which segments the block compressors search besides the prefix :
+ * the extDict of the window, the tables of an attached CDict, or none.
+ */
+MEM_STATIC ZSTD1_dictMode_e ZSTD1_matchState_dictMode(const ZSTD1_matchState_t* ms)
+{
+    return ZSTD1_window_hasExtDict(ms->window) ?
+        ZSTD1_extDict :
+        ms->dictMatchState != NULL ?
+            ZSTD1_dictMatchState :
+            ZSTD1_noDict;
+}
+
 /**
  * ZSTD1_window_needOverflowCorrection():
  * Returns non-zero if the indices are getting too large and need overflow
@@ -0,0 +1,65 @@
+package zstd1
+
+/*
+#define ZSTD1_STATIC_LINKING_ONLY
+#include "zstd.h"
+*/
+import "C"
+
+// CPUImpl identifies a tier of implementations of the hot kernels of zstd:
+// Huffman and sequence coding, match copying and counting.  Each tier uses the
+// instructions of an x86-64 generation, and falls back on the tier below for
+// kernels without a variant of its own.
+type CPUImpl int
+
+const (
+	// CPUAuto selects the best tier the CPU and OS support, the default
+	CPUAuto CPUImpl = C.ZSTD1_cpu_auto
+	// CPUGeneric uses portable code only
+	CPUGeneric CPUImpl = C.ZSTD1_cpu_generic
+	// CPUBMI2 uses BMI2 bit manipulation in the entropy coders
+	CPUBMI2 CPUImpl = C.ZSTD1_cpu_bmi2
+	// CPUAVX2 adds AVX2 32-byte copies and compares
+	CPUAVX2 CPUImpl = C.ZSTD1_cpu_avx2
+	// CPUAVX512 adds AVX-512BW
+	CPUAVX512 CPUImpl = C.ZSTD1_cpu_avx512
+)
+
+var cpuImplNames = []string{"auto", "generic", "bmi2", "avx2", "avx512"}
+
+func (i CPUImpl) String() string {
+	if i < CPUAuto || int(i) >= len(cpuImplNames) {
+		return "unknown"
+	}
+	return cpuImplNames[i]
+}
+
+// CPUImplementation returns the tier in use, never CPUAuto.  It is detected
+// once, on first use.
+func CPUImplementation() CPUImpl {
+	return CPUImpl(C.ZSTD1_getCpuImpl())
+}
+
+// CPUImplementations returns the tiers the CPU and OS support, from
+// CPUGeneric up.
+func CPUImplementations() []CPUImpl {
+	var impls []CPUImpl
+	for i := CPUGeneric; i <= CPUAVX512; i++ {
+		if C.ZSTD1_isCpuImplSupported(C.ZSTD1_cpuImpl_e(i)) != 0 {
+			impls = append(impls, i)
+		}
+	}
+	return impls
+}
+
+// ForceCPUImplementation makes every compression and decompression use the
+// given tier, for testing and benchmarking, or restores automatic selection
+// with CPUAuto.  It returns an error if the CPU does not support impl.  Running
+// compressions and streams switch at their next frame, except for match
+// counting which switches at once.
+func ForceCPUImplementation(impl CPUImpl) error {
+	if impl < CPUAuto || impl > CPUAVX512 {
+		return errParamOutOfBound
+	}
+	return getError(int(C.ZSTD1_forceCpuImpl(C.ZSTD1_cpuImpl_e(impl))))
+}
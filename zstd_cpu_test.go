@@ -0,0 +1,209 @@
+package zstd1
+
+import (
+	"bytes"
+	"fmt"
+	"math/rand"
+	"testing"
+)
+
+func TestCPUImplementations(t *testing.T) {
+	defer ForceCPUImplementation(CPUAuto)
+	impls := CPUImplementations()
+	if len(impls) == 0 || impls[0] != CPUGeneric {
+		t.Fatalf("Supported implementations %v do not start with generic", impls)
+	}
+	if best := impls[len(impls)-1]; CPUImplementation() != best {
+		t.Fatalf("Selected %v instead of the best supported %v", CPUImplementation(), best)
+	}
+	payloads := [][]byte{makePayload(300 << 10), makeLiterals(200<<10, 2), makeRepeats(200<<10, 40)}
+	for _, impl := range impls {
+		failOnError(t, "Failed to force "+impl.String(), ForceCPUImplementation(impl))
+		if CPUImplementation() != impl {
+			t.Fatalf("Forced %v but %v is in use", impl, CPUImplementation())
+		}
+		for _, payload := range payloads {
+			for _, level := range []int{1, 5, 19} {
+				compressed, err := CompressLevel(nil, payload, level)
+				failOnError(t, "Failed to compress", err)
+				decompressed, err := Decompress(nil, compressed)
+				failOnError(t, "Failed to decompress", err)
+				if !bytes.Equal(payload, decompressed) {
+					t.Fatalf("Payload did not match with %v at level %v", impl, level)
+				}
+			}
+		}
+	}
+}
+
+func TestForceCPUImplementationErrors(t *testing.T) {
+	defer ForceCPUImplementation(CPUAuto)
+	if err := ForceCPUImplementation(CPUImpl(42)); err == nil {
+		t.Fatal("Forcing an unknown implementation did not fail")
+	}
+	if impls := CPUImplementations(); impls[len(impls)-1] != CPUAVX512 {
+		if err := ForceCPUImplementation(CPUAVX512); err == nil {
+			t.Fatal("Forcing an unsupported implementation did not fail")
+		}
+	}
+	failOnError(t, "Failed to restore automatic selection", ForceCPUImplementation(CPUAuto))
+}
+
+// Compressions and decompressions running while the tier changes must keep
+// round tripping
+func TestForceCPUImplementationConcurrent(t *testing.T) {
+	defer ForceCPUImplementation(CPUAuto)
+	impls := CPUImplementations()
+	payload := makePayload(100 << 10)
+	errs := make(chan error, 4)
+	for g := 0; g < cap(errs); g++ {
+		go func() {
+			for i := 0; i < 20; i++ {
+				compressed, err := CompressLevel(nil, payload, 3)
+				if err != nil {
+					errs <- err
+					return
+				}
+				decompressed, err := Decompress(nil, compressed)
+				if err != nil {
+					errs <- err
+					return
+				}
+				if !bytes.Equal(payload, decompressed) {
+					errs <- fmt.Errorf("payload did not match")
+					return
+				}
+			}
+			errs <- nil
+		}()
+	}
+	for i, finished := 0, 0; finished < cap(errs); i++ {
+		select {
+		case err := <-errs:
+			failOnError(t, "Failed to round trip while switching implementations", err)
+			finished++
+		default:
+			failOnError(t, "Failed to force an implementation", ForceCPUImplementation(impls[i%len(impls)]))
+		}
+	}
+}
+
+func BenchmarkCPUImplementations(b *testing.B) {
+	defer ForceCPUImplementation(CPUAuto)
+	payload := makePayload(1 << 20)
+	for _, level := range []int{1, 19} {
+		compressed, err := CompressLevel(nil, payload, level)
+		if err != nil {
+			b.Fatalf("Failed compressing: %s", err)
+		}
+		dst := make([]byte, CompressBound(len(payload)))
+		for _, impl := range CPUImplementations() {
+			b.Run(fmt.Sprintf("Compress/Level%d/%v", level, impl), func(b *testing.B) {
+				ForceCPUImplementation(impl)
+				b.SetBytes(int64(len(payload)))
+				for i := 0; i < b.N; i++ {
+					if _, err := CompressLevel(dst, payload, level); err != nil {
+						b.Fatalf("Failed compressing: %s", err)
+					}
+				}
+			})
+			b.Run(fmt.Sprintf("Decompress/Level%d/%v", level, impl), func(b *testing.B) {
+				ForceCPUImplementation(impl)
+				b.SetBytes(int64(len(payload)))
+				for i := 0; i < b.N; i++ {
+					if _, err := Decompress(dst, compressed); err != nil {
+						b.Fatalf("Failed decompressing: %s", err)
+					}
+				}
+			})
+		}
+	}
+}
+
+// makeMutations returns size bytes of a random 64KB block repeated with a byte
+// flipped every few KB, for matches long enough that counting dominates
+func makeMutations(size int) []byte {
+	rng := rand.New(rand.NewSource(int64(size)))
+	block := make([]byte, 64<<10)
+	rng.Read(block)
+	b := make([]byte, 0, size+len(block))
+	for len(b) < size {
+		start := len(b)
+		b = append(b, block...)
+		for i := start; i < len(b); i += 1000 + rng.Intn(3000) {
+			b[i] ^= 1
+		}
+	}
+	return b[:size]
+}
+
+// strategyLevels gives each strategy a level with fitting defaults
+var strategyLevels = []struct {
+	name     string
+	strategy Strategy
+	level    int
+}{
+	{"Fast", StrategyFast, 1},
+	{"Dfast", StrategyDfast, 3},
+	{"Greedy", StrategyGreedy, 5},
+	{"Lazy", StrategyLazy, 6},
+	{"Lazy2", StrategyLazy2, 8},
+	{"Btlazy2", StrategyBtlazy2, 13},
+	{"Btopt", StrategyBtopt, 16},
+	{"Btultra", StrategyBtultra, 19},
+}
+
+// Match counting variants must find the same matches, to the byte
+func TestCPUImplementationsSameOutput(t *testing.T) {
+	defer ForceCPUImplementation(CPUAuto)
+	payloads := [][]byte{makePayloadFields(100<<10, 12), makeMutations(200 << 10), makeRepeats(100<<10, 40), makePayload(100<<10 + 31)}
+	for _, s := range strategyLevels {
+		p := Params{Level: s.level, Strategy: s.strategy}
+		for _, payload := range payloads {
+			var reference []byte
+			for _, impl := range CPUImplementations() {
+				failOnError(t, "Failed to force "+impl.String(), ForceCPUImplementation(impl))
+				compressed, err := CompressParams(nil, payload, p)
+				failOnError(t, "Failed to compress", err)
+				if reference == nil {
+					reference = compressed
+				} else if !bytes.Equal(reference, compressed) {
+					t.Fatalf("Strategy %v compressed differently with %v", s.name, impl)
+				}
+			}
+			decompressed, err := Decompress(nil, reference)
+			failOnError(t, "Failed to decompress", err)
+			if !bytes.Equal(payload, decompressed) {
+				t.Fatalf("Payload did not match with strategy %v", s.name)
+			}
+		}
+	}
+}
+
+func BenchmarkCompressStrategies(b *testing.B) {
+	defer ForceCPUImplementation(CPUAuto)
+	payloads := []struct {
+		name string
+		data []byte
+	}{
+		{"Logs", makePayloadFields(1<<20, 12)},
+		{"Mutations", makeMutations(4 << 20)},
+	}
+	for _, payload := range payloads {
+		dst := make([]byte, CompressBound(len(payload.data)))
+		for _, s := range strategyLevels {
+			p := Params{Level: s.level, Strategy: s.strategy}
+			for _, impl := range CPUImplementations() {
+				b.Run(fmt.Sprintf("%s/%s/%v", payload.name, s.name, impl), func(b *testing.B) {
+					ForceCPUImplementation(impl)
+					b.SetBytes(int64(len(payload.data)))
+					for i := 0; i < b.N; i++ {
+						if _, err := CompressParams(dst, payload.data, p); err != nil {
+							b.Fatalf("Failed compressing: %s", err)
+						}
+					}
+				})
+			}
+		}
+	}
+}
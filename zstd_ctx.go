@@ -0,0 +1,152 @@
+package zstd1
+
+/*
+#define ZSTD1_STATIC_LINKING_ONLY
+#include "zstd.h"
+#include "stdint.h"  // for uintptr_t
+
+// The following *_wrapper function are used for removing superflouos
+// memory allocations when calling the wrapped functions from Go code.
+// See https://github.com/golang/go/issues/24450 for details.
+// As the buffers are then only referenced by an integer, callers must keep
+// them alive with runtime.KeepAlive until the call returns, otherwise the GC
+// may free and reuse them while C is still accessing them.
+
+static size_t ZSTD1_compressCCtx_wrapper(ZSTD1_CCtx* cctx, uintptr_t dst, size_t maxDstSize, const uintptr_t src, size_t srcSize, int compressionLevel) {
+	return ZSTD1_compressCCtx(cctx, (void*)dst, maxDstSize, (const void*)src, srcSize, compressionLevel);
+}
+
+static size_t ZSTD1_decompressDCtx_wrapper(ZSTD1_DCtx* dctx, uintptr_t dst, size_t maxDstSize, uintptr_t src, size_t srcSize) {
+	return ZSTD1_decompressDCtx(dctx, (void*)dst, maxDstSize, (const void *)src, srcSize);
+}
+*/
+import "C"
+import (
+	"runtime"
+	"unsafe"
+)
+
+// CompressCtx is a reusable compression context.  Compressing many payloads
+// with a single CompressCtx avoids allocating and initializing the zstd
+// match-finder tables on every call, which dominates the cost of compressing
+// small payloads with CompressLevel.
+//
+// A CompressCtx is not safe for concurrent use; use one per goroutine.  Call
+// Close to free the C context as soon as it is no longer needed; a context
+// that is never closed is freed when it is garbage collected.
+type CompressCtx struct {
+	cctx *C.ZSTD1_CCtx
+	key  ctxPoolKey // pool the context returns to, see zstd_pool.go
+}
+
+// NewCompressCtx allocates a new compression context.  It returns
+// ErrContextAllocation if zstd fails to allocate it.
+func NewCompressCtx() (*CompressCtx, error) {
+	cctx := C.ZSTD1_createCCtx()
+	if cctx == nil {
+		return nil, ErrContextAllocation
+	}
+	c := &CompressCtx{cctx: cctx}
+	runtime.SetFinalizer(c, (*CompressCtx).Close)
+	return c, nil
+}
+
+// Compress src into dst with the default compression level.  It behaves like
+// the package-level Compress.
+func (c *CompressCtx) Compress(dst, src []byte) ([]byte, error) {
+	return c.CompressLevel(dst, src, DefaultCompression)
+}
+
+// CompressLevel is the same as Compress but you can pass a compression level
+func (c *CompressCtx) CompressLevel(dst, src []byte, level int) ([]byte, error) {
+	if len(src) == 0 {
+		return []byte{}, ErrEmptySlice
+	}
+	if err := checkLevel(level); err != nil {
+		return nil, err
+	}
+	bound := CompressBound(len(src))
+	if cap(dst) >= bound {
+		dst = dst[0:bound] // Reuse dst buffer
+	} else {
+		dst = make([]byte, bound)
+	}
+
+	cWritten := C.ZSTD1_compressCCtx_wrapper(
+		c.cctx,
+		C.uintptr_t(uintptr(unsafe.Pointer(&dst[0]))),
+		C.size_t(len(dst)),
+		C.uintptr_t(uintptr(unsafe.Pointer(&src[0]))),
+		C.size_t(len(src)),
+		C.int(level))
+	runtime.KeepAlive(c)
+	runtime.KeepAlive(src)
+
+	written := int(cWritten)
+	// Check if the return is an Error code
+	if err := getError(written); err != nil {
+		return nil, err
+	}
+	return dst[:written], nil
+}
+
+// Close frees the allocated C objects.  The context must not be used after
+// Close has been called.
+func (c *CompressCtx) Close() error {
+	if c.cctx == nil {
+		return nil
+	}
+	err := getError(int(C.ZSTD1_freeCCtx(c.cctx)))
+	c.cctx = nil
+	runtime.SetFinalizer(c, nil)
+	return err
+}
+
+// DecompressCtx is a reusable decompression context, the counterpart of
+// CompressCtx.
+//
+// A DecompressCtx is not safe for concurrent use; use one per goroutine.  Call
+// Close to free the C context as soon as it is no longer needed; a context
+// that is never closed is freed when it is garbage collected.
+type DecompressCtx struct {
+	dctx *C.ZSTD1_DCtx
+}
+
+// NewDecompressCtx allocates a new decompression context.  It returns
+// ErrContextAllocation if zstd fails to allocate it.
+func NewDecompressCtx() (*DecompressCtx, error) {
+	dctx := C.ZSTD1_createDCtx()
+	if dctx == nil {
+		return nil, ErrContextAllocation
+	}
+	d := &DecompressCtx{dctx: dctx}
+	runtime.SetFinalizer(d, (*DecompressCtx).Close)
+	return d, nil
+}
+
+// Decompress src into dst.  It behaves like the package-level Decompress.
+func (d *DecompressCtx) Decompress(dst, src []byte) ([]byte, error) {
+	defer runtime.KeepAlive(d)
+	return decompressSized(dst, src, func(dst, src []byte) int {
+		written := int(C.ZSTD1_decompressDCtx_wrapper(
+			d.dctx,
+			C.uintptr_t(uintptr(unsafe.Pointer(&dst[0]))),
+			C.size_t(len(dst)),
+			C.uintptr_t(uintptr(unsafe.Pointer(&src[0]))),
+			C.size_t(len(src))))
+		runtime.KeepAlive(src)
+		return written
+	}, NewReader)
+}
+
+// Close frees the allocated C objects.  The context must not be used after
+// Close has been called.
+func (d *DecompressCtx) Close() error {
+	if d.dctx == nil {
+		return nil
+	}
+	err := getError(int(C.ZSTD1_freeDCtx(d.dctx)))
+	d.dctx = nil
+	runtime.SetFinalizer(d, nil)
+	return err
+}
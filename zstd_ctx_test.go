@@ -0,0 +1,156 @@
+package zstd1
+
+import (
+	"bytes"
+	"fmt"
+	"math/rand"
+	"testing"
+)
+
+var benchSizes = []int{64, 512, 4 << 10, 32 << 10, 256 << 10}
+
+// makePayload returns size bytes of deterministic, moderately compressible
+// text resembling the small structured messages zstd is often used for.
+func makePayload(size int) []byte {
+	return makePayloadFields(size, 2)
+}
+
+// makePayloadFields is makePayload with messages of the given number of
+// fields; more fields make longer lines, such as logs.
+func makePayloadFields(size, fields int) []byte {
+	words := []string{"id", "user", "timestamp", "status", "ok", "error",
+		"request", "latency_ms", "region", "us-east-1", "eu-west-1", "true"}
+	rng := rand.New(rand.NewSource(int64(size)))
+	var b bytes.Buffer
+	for b.Len() < size {
+		b.WriteByte('{')
+		for f := 1; f < fields; f++ {
+			fmt.Fprintf(&b, "\"%s\":\"%s\",", words[rng.Intn(len(words))], words[rng.Intn(len(words))])
+		}
+		fmt.Fprintf(&b, "\"%s\":%d}\n", words[rng.Intn(len(words))], rng.Intn(100000))
+	}
+	return b.Bytes()[:size]
+}
+
+func mustCompressCtx(tb testing.TB) *CompressCtx {
+	c, err := NewCompressCtx()
+	if err != nil {
+		tb.Fatalf("Failed to create compression context: %s", err)
+	}
+	return c
+}
+
+func mustDecompressCtx(tb testing.TB) *DecompressCtx {
+	d, err := NewDecompressCtx()
+	if err != nil {
+		tb.Fatalf("Failed to create decompression context: %s", err)
+	}
+	return d
+}
+
+func TestCtxCompressDecompress(t *testing.T) {
+	cctx := mustCompressCtx(t)
+	defer cctx.Close()
+	dctx := mustDecompressCtx(t)
+	defer dctx.Close()
+
+	// Reuse the same contexts across payload sizes and levels
+	for _, size := range benchSizes {
+		for _, level := range []int{BestSpeed, DefaultCompression, 12} {
+			payload := makePayload(size)
+			compressed, err := cctx.CompressLevel(nil, payload, level)
+			failOnError(t, "Failed to compress", err)
+			// Must be readable by the non-context API
+			plain, err := Decompress(nil, compressed)
+			failOnError(t, "Failed to decompress with Decompress()", err)
+			if !bytes.Equal(plain, payload) {
+				t.Fatalf("Payload did not match for size %v, level %v", size, level)
+			}
+			decompressed, err := dctx.Decompress(nil, compressed)
+			failOnError(t, "Failed to decompress with DecompressCtx", err)
+			if !bytes.Equal(decompressed, payload) {
+				t.Fatalf("Payload did not match for size %v, level %v", size, level)
+			}
+		}
+	}
+}
+
+func TestCtxEmptySlice(t *testing.T) {
+	cctx := mustCompressCtx(t)
+	defer cctx.Close()
+	dctx := mustDecompressCtx(t)
+	defer dctx.Close()
+	if _, err := cctx.Compress(nil, []byte{}); err != ErrEmptySlice {
+		t.Fatalf("Did not get the correct error: %s", err)
+	}
+	if _, err := dctx.Decompress(nil, []byte{}); err != ErrEmptySlice {
+		t.Fatalf("Did not get the correct error: %s", err)
+	}
+}
+
+func TestCtxCloseTwice(t *testing.T) {
+	cctx := mustCompressCtx(t)
+	failOnError(t, "Failed to close", cctx.Close())
+	failOnError(t, "Failed to close twice", cctx.Close())
+	dctx := mustDecompressCtx(t)
+	failOnError(t, "Failed to close", dctx.Close())
+	failOnError(t, "Failed to close twice", dctx.Close())
+}
+
+func BenchmarkCtxCompression(b *testing.B) {
+	for _, size := range benchSizes {
+		payload := makePayload(size)
+		dst := make([]byte, CompressBound(size))
+		b.Run(fmt.Sprintf("PerCall/%d", size), func(b *testing.B) {
+			b.SetBytes(int64(size))
+			for i := 0; i < b.N; i++ {
+				cctx := mustCompressCtx(b)
+				if _, err := cctx.CompressLevel(dst, payload, DefaultCompression); err != nil {
+					b.Fatalf("Failed compressing: %s", err)
+				}
+				cctx.Close()
+			}
+		})
+		b.Run(fmt.Sprintf("Reused/%d", size), func(b *testing.B) {
+			cctx := mustCompressCtx(b)
+			defer cctx.Close()
+			b.SetBytes(int64(size))
+			for i := 0; i < b.N; i++ {
+				if _, err := cctx.CompressLevel(dst, payload, DefaultCompression); err != nil {
+					b.Fatalf("Failed compressing: %s", err)
+				}
+			}
+		})
+	}
+}
+
+func BenchmarkCtxDecompression(b *testing.B) {
+	for _, size := range benchSizes {
+		payload := makePayload(size)
+		compressed, err := Compress(nil, payload)
+		if err != nil {
+			b.Fatalf("Failed compressing: %s", err)
+		}
+		dst := make([]byte, size)
+		b.Run(fmt.Sprintf("PerCall/%d", size), func(b *testing.B) {
+			b.SetBytes(int64(size))
+			for i := 0; i < b.N; i++ {
+				dctx := mustDecompressCtx(b)
+				if _, err := dctx.Decompress(dst, compressed); err != nil {
+					b.Fatalf("Failed decompressing: %s", err)
+				}
+				dctx.Close()
+			}
+		})
+		b.Run(fmt.Sprintf("Reused/%d", size), func(b *testing.B) {
+			dctx := mustDecompressCtx(b)
+			defer dctx.Close()
+			b.SetBytes(int64(size))
+			for i := 0; i < b.N; i++ {
+				if _, err := dctx.Decompress(dst, compressed); err != nil {
+					b.Fatalf("Failed decompressing: %s", err)
+				}
+			}
+		})
+	}
+}
@@ -45,7 +45,6 @@
 *  Dependencies
 *********************************************************/
 #include <string.h>      /* memcpy, memmove, memset */
-#include "cpu.h"
 #include "mem.h"         /* low level memory routines */
 #define FSE1_STATIC_LINKING_ONLY
 #include "fse.h"
@@ -70,6 +69,18 @@
 *  Memory operations
 **********************************************************/
 static void ZSTD1_copy4(void* dst, const void* src) { memcpy(dst, src, 4); }
+static void ZSTD1_copy16(void* dst, const void* src) { memcpy(dst, src, 16); }
+#if DYNAMIC_AVX2 || defined(__AVX2__)
+#  include <immintrin.h>
+/* Not forced inline : only gets inlined into the AVX2 variants of callers.
+ * memcpy() would be split into two 16-byte moves by generic tuning. */
+static TARGET_ATTRIBUTE("avx2") void ZSTD1_copy32(void* dst, const void* src)
+{
+    _mm256_storeu_si256((__m256i*)dst, _mm256_loadu_si256((const __m256i*)src));
+}
+#else
+static void ZSTD1_copy32(void* dst, const void* src) { memcpy(dst, src, 32); }
+#endif
 
 
 /*-*************************************************************
@@ -134,7 +145,8 @@ struct ZSTD1_DCtx_s
     size_t litSize;
     size_t rleSize;
     size_t staticSize;
-    int bmi2;                     /* == 1 if the CPU supports BMI2 and 0 otherwise. CPU support is determined dynamically once per context lifetime. */
+    ZSTD1_cpuImpl_e cpuImpl;      /* variants of the decoders in use, from ZSTD1_getCpuImpl() at the start of each frame */
+    int bmi2;                     /* == 1 if cpuImpl includes BMI2 */
 
     /* streaming */
     ZSTD1_DDict* ddictLocal;
@@ -181,6 +193,12 @@ static size_t ZSTD1_startingInputLength(ZSTD1_format_e format)
     return startingInputLength;
 }
 
+static void ZSTD1_DCtx_selectCpuImpl(ZSTD1_DCtx* dctx)
+{
+    dctx->cpuImpl = ZSTD1_getCpuImpl();
+    dctx->bmi2 = dctx->cpuImpl >= ZSTD1_cpu_bmi2;
+}
+
 static void ZSTD1_initDCtx_internal(ZSTD1_DCtx* dctx)
 {
     dctx->format = ZSTD1_f_zstd1;  /* ZSTD1_decompressBegin() invokes ZSTD1_startingInputLength() with argument dctx->format */
@@ -192,7 +210,7 @@ static void ZSTD1_initDCtx_internal(ZSTD1_DCtx* dctx)
     dctx->inBuffSize  = 0;
     dctx->outBuffSize = 0;
     dctx->streamStage = zdss_init;
-    dctx->bmi2 = ZSTD1_cpuid_bmi2(ZSTD1_cpuid());
+    ZSTD1_DCtx_selectCpuImpl(dctx);
 }
 
 ZSTD1_DCtx* ZSTD1_initStaticDCtx(void *workspace, size_t workspaceSize)
@@ -1024,11 +1042,103 @@ typedef struct {
 } seqState_t;
 
 
+typedef enum { ZSTD1_no_overlap, ZSTD1_overlap_src_before_dst } ZSTD1_overlap_e;
+
+/*! ZSTD1_overlapCopy8() :
+ *  Copies 8 bytes from *ip to *op and advances both by 8, spreading a distance
+ *  (*op - *ip == offset) below 8 to a multiple of it between 8 and 14, so that
+ *  the following copies can move 8 bytes or more at a time. */
+HINT_INLINE void ZSTD1_overlapCopy8(BYTE** op, const BYTE** ip, size_t offset)
+{
+    assert(*ip <= *op);
+    if (offset < 8) {
+        /* close range match, overlap */
+        static const U32 dec32table[] = { 0, 1, 2, 1, 4, 4, 4, 4 };   /* added */
+        static const int dec64table[] = { 8, 8, 8, 7, 8, 9,10,11 };   /* subtracted */
+        int const sub2 = dec64table[offset];
+        (*op)[0] = (*ip)[0];
+        (*op)[1] = (*ip)[1];
+        (*op)[2] = (*ip)[2];
+        (*op)[3] = (*ip)[3];
+        *ip += dec32table[offset];
+        ZSTD1_copy4(*op+4, *ip);
+        *ip -= sub2;
+    } else {
+        ZSTD1_copy8(*op, *ip);
+    }
+    *ip += 8;
+    *op += 8;
+    assert(*op - *ip >= 8);
+}
+
+/*! ZSTD1_wildcopyDec() :
+ *  Copies length bytes from src to dst, 16 bytes at a time, or 32 when wide
+ *  and the copy allows it.  Can write up to WILDCOPY_OVERLENGTH-1 bytes past
+ *  dst+length and read as far past src+length.
+ *  With ZSTD1_overlap_src_before_dst, src may be as close as 8 bytes before dst:
+ *  under 16, the first pass copies 16 bytes but only moves dst by the distance,
+ *  which doubles it while keeping it a multiple of the repeated pattern. */
+FORCE_INLINE_TEMPLATE void
+ZSTD1_wildcopyDec(void* dst, const void* src, ptrdiff_t length,
+                  ZSTD1_overlap_e const ovtype, int const wide)
+{
+    const BYTE* ip = (const BYTE*)src;
+    BYTE* op = (BYTE*)dst;
+    BYTE* const oend = op + length;
+    ptrdiff_t diff = op - ip;
+    assert(ovtype == ZSTD1_no_overlap || diff >= 8);
+
+    if (ovtype == ZSTD1_overlap_src_before_dst && diff < 16) {
+        ZSTD1_copy8(op, ip);
+        ZSTD1_copy8(op+8, ip+8);   /* reads the bytes just written */
+        op += diff;
+        diff *= 2;
+        if (op >= oend) return;
+    }
+    if (wide && (ovtype == ZSTD1_no_overlap || diff >= 32)) {
+        do {
+            ZSTD1_copy32(op, ip);
+            op += 32; ip += 32;
+        } while (op < oend);
+    } else {
+        do {
+            ZSTD1_copy16(op, ip);
+            op += 16; ip += 16;
+        } while (op < oend);
+    }
+}
+
+/*! ZSTD1_safecopy() :
+ *  Copies length bytes from ip to op without writing beyond oend_w+WILDCOPY_OVERLENGTH:
+ *  wide copies up to oend_w, then byte by byte. */
+static void
+ZSTD1_safecopy(BYTE* op, BYTE* const oend_w, const BYTE* ip, ptrdiff_t length, ZSTD1_overlap_e ovtype)
+{
+    BYTE* const oend = op + length;
+    if (length < 8) {
+        while (op < oend) *op++ = *ip++;
+        return;
+    }
+    if (ovtype == ZSTD1_overlap_src_before_dst) {
+        ZSTD1_overlapCopy8(&op, &ip, (size_t)(op - ip));
+    }
+    if (op < oend_w) {
+        ptrdiff_t const wildLength = MIN(oend, oend_w) - op;
+        ZSTD1_wildcopyDec(op, ip, wildLength, ovtype, 0);
+        op += wildLength;
+        ip += wildLength;
+    }
+    while (op < oend) *op++ = *ip++;
+}
+
+/*! ZSTD1_execSequenceEnd() :
+ *  Executes a sequence ending within WILDCOPY_OVERLENGTH bytes of oend, or
+ *  an invalid one, without the wide copies' overwrite */
 FORCE_NOINLINE
-size_t ZSTD1_execSequenceLast7(BYTE* op,
-                              BYTE* const oend, seq_t sequence,
-                              const BYTE** litPtr, const BYTE* const litLimit,
-                              const BYTE* const base, const BYTE* const vBase, const BYTE* const dictEnd)
+size_t ZSTD1_execSequenceEnd(BYTE* op,
+                             BYTE* const oend, seq_t sequence,
+                             const BYTE** litPtr, const BYTE* const litLimit,
+                             const BYTE* const base, const BYTE* const vBase, const BYTE* const dictEnd)
 {
     BYTE* const oLitEnd = op + sequence.litLength;
     size_t const sequenceLength = sequence.litLength + sequence.matchLength;
@@ -1038,17 +1148,13 @@ size_t ZSTD1_execSequenceLast7(BYTE* op,
     const BYTE* match = oLitEnd - sequence.offset;
 
     /* check */
-    if (oMatchEnd>oend) return ERROR(dstSize_tooSmall); /* last match must start at a minimum distance of WILDCOPY_OVERLENGTH from oend */
+    if (oMatchEnd>oend) return ERROR(dstSize_tooSmall);
     if (iLitEnd > litLimit) return ERROR(corruption_detected);   /* over-read beyond lit buffer */
-    if (oLitEnd <= oend_w) return ERROR(GENERIC);   /* Precondition */
 
     /* copy literals */
-    if (op < oend_w) {
-        ZSTD1_wildcopy(op, *litPtr, oend_w - op);
-        *litPtr += oend_w - op;
-        op = oend_w;
-    }
-    while (op < oLitEnd) *op++ = *(*litPtr)++;
+    ZSTD1_safecopy(op, oend_w, *litPtr, sequence.litLength, ZSTD1_no_overlap);
+    op = oLitEnd;
+    *litPtr = iLitEnd;
 
     /* copy Match */
     if (sequence.offset > (size_t)(oLitEnd - base)) {
@@ -1066,7 +1172,7 @@ size_t ZSTD1_execSequenceLast7(BYTE* op,
             sequence.matchLength -= length1;
             match = base;
     }   }
-    while (op < oMatchEnd) *op++ = *match++;
+    ZSTD1_safecopy(op, oend_w, match, oMatchEnd - op, ZSTD1_overlap_src_before_dst);
     return sequenceLength;
 }
 
@@ -1075,7 +1181,8 @@ HINT_INLINE
 size_t ZSTD1_execSequence(BYTE* op,
                          BYTE* const oend, seq_t sequence,
                          const BYTE** litPtr, const BYTE* const litLimit,
-                         const BYTE* const base, const BYTE* const vBase, const BYTE* const dictEnd)
+                         const BYTE* const base, const BYTE* const vBase, const BYTE* const dictEnd,
+                         int const wideCopy)
 {
     BYTE* const oLitEnd = op + sequence.litLength;
     size_t const sequenceLength = sequence.litLength + sequence.matchLength;
@@ -1084,15 +1191,14 @@ size_t ZSTD1_execSequence(BYTE* op,
     const BYTE* const iLitEnd = *litPtr + sequence.litLength;
     const BYTE* match = oLitEnd - sequence.offset;
 
-    /* check */
-    if (oMatchEnd>oend) return ERROR(dstSize_tooSmall); /* last match must start at a minimum distance of WILDCOPY_OVERLENGTH from oend */
-    if (iLitEnd > litLimit) return ERROR(corruption_detected);   /* over-read beyond lit buffer */
-    if (oLitEnd>oend_w) return ZSTD1_execSequenceLast7(op, oend, sequence, litPtr, litLimit, base, vBase, dictEnd);
+    /* check : the wide copies below need WILDCOPY_OVERLENGTH bytes of room after the sequence */
+    if ((oMatchEnd > oend_w) | (iLitEnd > litLimit))
+        return ZSTD1_execSequenceEnd(op, oend, sequence, litPtr, litLimit, base, vBase, dictEnd);
 
     /* copy Literals */
-    ZSTD1_copy8(op, *litPtr);
-    if (sequence.litLength > 8)
-        ZSTD1_wildcopy(op+8, (*litPtr)+8, sequence.litLength - 8);   /* note : since oLitEnd <= oend-WILDCOPY_OVERLENGTH, no risk of overwrite beyond oend */
+    ZSTD1_copy16(op, *litPtr);
+    if (sequence.litLength > 16)
+        ZSTD1_wildcopyDec(op+16, (*litPtr)+16, sequence.litLength-16, ZSTD1_no_overlap, wideCopy);
     op = oLitEnd;
     *litPtr = iLitEnd;   /* update for next sequence */
 
@@ -1112,42 +1218,14 @@ size_t ZSTD1_execSequence(BYTE* op,
             op = oLitEnd + length1;
             sequence.matchLength -= length1;
             match = base;
-            if (op > oend_w || sequence.matchLength < MINMATCH) {
-              U32 i;
-              for (i = 0; i < sequence.matchLength; ++i) op[i] = match[i];
-              return sequenceLength;
-            }
     }   }
-    /* Requirement: op <= oend_w && sequence.matchLength >= MINMATCH */
-
-    /* match within prefix */
-    if (sequence.offset < 8) {
-        /* close range match, overlap */
-        static const U32 dec32table[] = { 0, 1, 2, 1, 4, 4, 4, 4 };   /* added */
-        static const int dec64table[] = { 8, 8, 8, 7, 8, 9,10,11 };   /* subtracted */
-        int const sub2 = dec64table[sequence.offset];
-        op[0] = match[0];
-        op[1] = match[1];
-        op[2] = match[2];
-        op[3] = match[3];
-        match += dec32table[sequence.offset];
-        ZSTD1_copy4(op+4, match);
-        match -= sub2;
-    } else {
-        ZSTD1_copy8(op, match);
-    }
-    op += 8; match += 8;
+    /* match within prefix, op - match == sequence.offset */
 
-    if (oMatchEnd > oend-(16-MINMATCH)) {
-        if (op < oend_w) {
-            ZSTD1_wildcopy(op, match, oend_w - op);
-            match += oend_w - op;
-            op = oend_w;
-        }
-        while (op < oMatchEnd) *op++ = *match++;
-    } else {
-        ZSTD1_wildcopy(op, match, (ptrdiff_t)sequence.matchLength-8);   /* works even if matchLength < 8 */
+    if (sequence.offset < 16) {
+        ZSTD1_overlapCopy8(&op, &match, sequence.offset);
+        if (op >= oMatchEnd) return sequenceLength;
     }
+    ZSTD1_wildcopyDec(op, match, oMatchEnd - op, ZSTD1_overlap_src_before_dst, wideCopy);
     return sequenceLength;
 }
 
@@ -1156,7 +1234,8 @@ HINT_INLINE
 size_t ZSTD1_execSequenceLong(BYTE* op,
                              BYTE* const oend, seq_t sequence,
                              const BYTE** litPtr, const BYTE* const litLimit,
-                             const BYTE* const prefixStart, const BYTE* const dictStart, const BYTE* const dictEnd)
+                             const BYTE* const prefixStart, const BYTE* const dictStart, const BYTE* const dictEnd,
+                             int const wideCopy)
 {
     BYTE* const oLitEnd = op + sequence.litLength;
     size_t const sequenceLength = sequence.litLength + sequence.matchLength;
@@ -1165,15 +1244,14 @@ size_t ZSTD1_execSequenceLong(BYTE* op,
     const BYTE* const iLitEnd = *litPtr + sequence.litLength;
     const BYTE* match = sequence.match;
 
-    /* check */
-    if (oMatchEnd > oend) return ERROR(dstSize_tooSmall); /* last match must start at a minimum distance of WILDCOPY_OVERLENGTH from oend */
-    if (iLitEnd > litLimit) return ERROR(corruption_detected);   /* over-read beyond lit buffer */
-    if (oLitEnd > oend_w) return ZSTD1_execSequenceLast7(op, oend, sequence, litPtr, litLimit, prefixStart, dictStart, dictEnd);
+    /* check : the wide copies below need WILDCOPY_OVERLENGTH bytes of room after the sequence */
+    if ((oMatchEnd > oend_w) | (iLitEnd > litLimit))
+        return ZSTD1_execSequenceEnd(op, oend, sequence, litPtr, litLimit, prefixStart, dictStart, dictEnd);
 
     /* copy Literals */
-    ZSTD1_copy8(op, *litPtr);  /* note : op <= oLitEnd <= oend_w == oend - 8 */
-    if (sequence.litLength > 8)
-        ZSTD1_wildcopy(op+8, (*litPtr)+8, sequence.litLength - 8);   /* note : since oLitEnd <= oend-WILDCOPY_OVERLENGTH, no risk of overwrite beyond oend */
+    ZSTD1_copy16(op, *litPtr);
+    if (sequence.litLength > 16)
+        ZSTD1_wildcopyDec(op+16, (*litPtr)+16, sequence.litLength-16, ZSTD1_no_overlap, wideCopy);
     op = oLitEnd;
     *litPtr = iLitEnd;   /* update for next sequence */
 
@@ -1191,43 +1269,14 @@ size_t ZSTD1_execSequenceLong(BYTE* op,
             op = oLitEnd + length1;
             sequence.matchLength -= length1;
             match = prefixStart;
-            if (op > oend_w || sequence.matchLength < MINMATCH) {
-              U32 i;
-              for (i = 0; i < sequence.matchLength; ++i) op[i] = match[i];
-              return sequenceLength;
-            }
     }   }
-    assert(op <= oend_w);
-    assert(sequence.matchLength >= MINMATCH);
-
-    /* match within prefix */
-    if (sequence.offset < 8) {
-        /* close range match, overlap */
-        static const U32 dec32table[] = { 0, 1, 2, 1, 4, 4, 4, 4 };   /* added */
-        static const int dec64table[] = { 8, 8, 8, 7, 8, 9,10,11 };   /* subtracted */
-        int const sub2 = dec64table[sequence.offset];
-        op[0] = match[0];
-        op[1] = match[1];
-        op[2] = match[2];
-        op[3] = match[3];
-        match += dec32table[sequence.offset];
-        ZSTD1_copy4(op+4, match);
-        match -= sub2;
-    } else {
-        ZSTD1_copy8(op, match);
-    }
-    op += 8; match += 8;
+    /* match within prefix, op - match == sequence.offset */
 
-    if (oMatchEnd > oend-(16-MINMATCH)) {
-        if (op < oend_w) {
-            ZSTD1_wildcopy(op, match, oend_w - op);
-            match += oend_w - op;
-            op = oend_w;
-        }
-        while (op < oMatchEnd) *op++ = *match++;
-    } else {
-        ZSTD1_wildcopy(op, match, (ptrdiff_t)sequence.matchLength-8);   /* works even if matchLength < 8 */
+    if (sequence.offset < 16) {
+        ZSTD1_overlapCopy8(&op, &match, sequence.offset);
+        if (op >= oMatchEnd) return sequenceLength;
     }
+    ZSTD1_wildcopyDec(op, match, oMatchEnd - op, ZSTD1_overlap_src_before_dst, wideCopy);
     return sequenceLength;
 }
 
@@ -1345,7 +1394,7 @@ FORCE_INLINE_TEMPLATE size_t
 ZSTD1_decompressSequences_body( ZSTD1_DCtx* dctx,
                                void* dst, size_t maxDstSize,
                          const void* seqStart, size_t seqSize, int nbSeq,
-                         const ZSTD1_longOffset_e isLongOffset)
+                         const ZSTD1_longOffset_e isLongOffset, int const wideCopy)
 {
     const BYTE* ip = (const BYTE*)seqStart;
     const BYTE* const iend = ip + seqSize;
@@ -1372,7 +1421,7 @@ ZSTD1_decompressSequences_body( ZSTD1_DCtx* dctx,
         for ( ; (BIT_reloadDStream(&(seqState.DStream)) <= BIT_DStream_completed) && nbSeq ; ) {
             nbSeq--;
             {   seq_t const sequence = ZSTD1_decodeSequence(&seqState, isLongOffset);
-                size_t const oneSeqSize = ZSTD1_execSequence(op, oend, sequence, &litPtr, litEnd, base, vBase, dictEnd);
+                size_t const oneSeqSize = ZSTD1_execSequence(op, oend, sequence, &litPtr, litEnd, base, vBase, dictEnd, wideCopy);
                 DEBUGLOG(6, "regenerated sequence size : %u", (U32)oneSeqSize);
                 if (ZSTD1_isError(oneSeqSize)) return oneSeqSize;
                 op += oneSeqSize;
@@ -1395,13 +1444,20 @@ ZSTD1_decompressSequences_body( ZSTD1_DCtx* dctx,
     return op-ostart;
 }
 
+/* 32-byte copies are single moves only with AVX2 */
+#ifdef __AVX2__
+#  define ZSTD1_WIDECOPY 1
+#else
+#  define ZSTD1_WIDECOPY 0
+#endif
+
 static size_t
 ZSTD1_decompressSequences_default(ZSTD1_DCtx* dctx,
                                  void* dst, size_t maxDstSize,
                            const void* seqStart, size_t seqSize, int nbSeq,
                            const ZSTD1_longOffset_e isLongOffset)
 {
-    return ZSTD1_decompressSequences_body(dctx, dst, maxDstSize, seqStart, seqSize, nbSeq, isLongOffset);
+    return ZSTD1_decompressSequences_body(dctx, dst, maxDstSize, seqStart, seqSize, nbSeq, isLongOffset, ZSTD1_WIDECOPY);
 }
 
 
@@ -1489,7 +1545,7 @@ ZSTD1_decompressSequencesLong_body(
                                ZSTD1_DCtx* dctx,
                                void* dst, size_t maxDstSize,
                          const void* seqStart, size_t seqSize, int nbSeq,
-                         const ZSTD1_longOffset_e isLongOffset)
+                         const ZSTD1_longOffset_e isLongOffset, int const wideCopy)
 {
     const BYTE* ip = (const BYTE*)seqStart;
     const BYTE* const iend = ip + seqSize;
@@ -1530,7 +1586,7 @@ ZSTD1_decompressSequencesLong_body(
         /* decode and decompress */
         for ( ; (BIT_reloadDStream(&(seqState.DStream)) <= BIT_DStream_completed) && (seqNb<nbSeq) ; seqNb++) {
             seq_t const sequence = ZSTD1_decodeSequenceLong(&seqState, isLongOffset);
-            size_t const oneSeqSize = ZSTD1_execSequenceLong(op, oend, sequences[(seqNb-ADVANCED_SEQS) & STOSEQ_MASK], &litPtr, litEnd, prefixStart, dictStart, dictEnd);
+            size_t const oneSeqSize = ZSTD1_execSequenceLong(op, oend, sequences[(seqNb-ADVANCED_SEQS) & STOSEQ_MASK], &litPtr, litEnd, prefixStart, dictStart, dictEnd, wideCopy);
             if (ZSTD1_isError(oneSeqSize)) return oneSeqSize;
             PREFETCH(sequence.match);  /* note : it's safe to invoke PREFETCH() on any memory address, including invalid ones */
             sequences[seqNb&STOSEQ_MASK] = sequence;
@@ -1541,7 +1597,7 @@ ZSTD1_decompressSequencesLong_body(
         /* finish queue */
         seqNb -= seqAdvance;
         for ( ; seqNb<nbSeq ; seqNb++) {
-            size_t const oneSeqSize = ZSTD1_execSequenceLong(op, oend, sequences[seqNb&STOSEQ_MASK], &litPtr, litEnd, prefixStart, dictStart, dictEnd);
+            size_t const oneSeqSize = ZSTD1_execSequenceLong(op, oend, sequences[seqNb&STOSEQ_MASK], &litPtr, litEnd, prefixStart, dictStart, dictEnd, wideCopy);
             if (ZSTD1_isError(oneSeqSize)) return oneSeqSize;
             op += oneSeqSize;
         }
@@ -1569,7 +1625,7 @@ ZSTD1_decompressSequencesLong_default(ZSTD1_DCtx* dctx,
                            const void* seqStart, size_t seqSize, int nbSeq,
                            const ZSTD1_longOffset_e isLongOffset)
 {
-    return ZSTD1_decompressSequencesLong_body(dctx, dst, maxDstSize, seqStart, seqSize, nbSeq, isLongOffset);
+    return ZSTD1_decompressSequencesLong_body(dctx, dst, maxDstSize, seqStart, seqSize, nbSeq, isLongOffset, ZSTD1_WIDECOPY);
 }
 
 
@@ -1582,7 +1638,7 @@ ZSTD1_decompressSequences_bmi2(ZSTD1_DCtx* dctx,
                            const void* seqStart, size_t seqSize, int nbSeq,
                            const ZSTD1_longOffset_e isLongOffset)
 {
-    return ZSTD1_decompressSequences_body(dctx, dst, maxDstSize, seqStart, seqSize, nbSeq, isLongOffset);
+    return ZSTD1_decompressSequences_body(dctx, dst, maxDstSize, seqStart, seqSize, nbSeq, isLongOffset, ZSTD1_WIDECOPY);
 }
 
 static TARGET_ATTRIBUTE("bmi2") size_t
@@ -1591,7 +1647,29 @@ ZSTD1_decompressSequencesLong_bmi2(ZSTD1_DCtx* dctx,
                            const void* seqStart, size_t seqSize, int nbSeq,
                            const ZSTD1_longOffset_e isLongOffset)
 {
-    return ZSTD1_decompressSequencesLong_body(dctx, dst, maxDstSize, seqStart, seqSize, nbSeq, isLongOffset);
+    return ZSTD1_decompressSequencesLong_body(dctx, dst, maxDstSize, seqStart, seqSize, nbSeq, isLongOffset, ZSTD1_WIDECOPY);
+}
+
+#endif
+
+#if DYNAMIC_AVX2
+
+static TARGET_ATTRIBUTE("avx2,bmi2") size_t
+ZSTD1_decompressSequences_avx2(ZSTD1_DCtx* dctx,
+                                 void* dst, size_t maxDstSize,
+                           const void* seqStart, size_t seqSize, int nbSeq,
+                           const ZSTD1_longOffset_e isLongOffset)
+{
+    return ZSTD1_decompressSequences_body(dctx, dst, maxDstSize, seqStart, seqSize, nbSeq, isLongOffset, 1);
+}
+
+static TARGET_ATTRIBUTE("avx2,bmi2") size_t
+ZSTD1_decompressSequencesLong_avx2(ZSTD1_DCtx* dctx,
+                                 void* dst, size_t maxDstSize,
+                           const void* seqStart, size_t seqSize, int nbSeq,
+                           const ZSTD1_longOffset_e isLongOffset)
+{
+    return ZSTD1_decompressSequencesLong_body(dctx, dst, maxDstSize, seqStart, seqSize, nbSeq, isLongOffset, 1);
 }
 
 #endif
@@ -1601,17 +1679,17 @@ typedef size_t (*ZSTD1_decompressSequences_t)(
     const void *seqStart, size_t seqSize, int nbSeq,
     const ZSTD1_longOffset_e isLongOffset);
 
+static const ZSTD1_decompressSequences_t
+ZSTD1_decompressSequences_impl[ZSTD1_cpu_avx512+1] = CPU_IMPL_TABLE(ZSTD1_decompressSequences);
+static const ZSTD1_decompressSequences_t
+ZSTD1_decompressSequencesLong_impl[ZSTD1_cpu_avx512+1] = CPU_IMPL_TABLE(ZSTD1_decompressSequencesLong);
+
 static size_t ZSTD1_decompressSequences(ZSTD1_DCtx* dctx, void* dst, size_t maxDstSize,
                                 const void* seqStart, size_t seqSize, int nbSeq,
                                 const ZSTD1_longOffset_e isLongOffset)
 {
     DEBUGLOG(5, "ZSTD1_decompressSequences");
-#if DYNAMIC_BMI2
-    if (dctx->bmi2) {
-        return ZSTD1_decompressSequences_bmi2(dctx, dst, maxDstSize, seqStart, seqSize, nbSeq, isLongOffset);
-    }
-#endif
-  return ZSTD1_decompressSequences_default(dctx, dst, maxDstSize, seqStart, seqSize, nbSeq, isLongOffset);
+    return ZSTD1_decompressSequences_impl[dctx->cpuImpl](dctx, dst, maxDstSize, seqStart, seqSize, nbSeq, isLongOffset);
 }
 
 static size_t ZSTD1_decompressSequencesLong(ZSTD1_DCtx* dctx,
@@ -1620,12 +1698,7 @@ static size_t ZSTD1_decompressSequencesLong(ZSTD1_DCtx* dctx,
                                 const ZSTD1_longOffset_e isLongOffset)
 {
     DEBUGLOG(5, "ZSTD1_decompressSequencesLong");
-#if DYNAMIC_BMI2
-    if (dctx->bmi2) {
-        return ZSTD1_decompressSequencesLong_bmi2(dctx, dst, maxDstSize, seqStart, seqSize, nbSeq, isLongOffset);
-    }
-#endif
-  return ZSTD1_decompressSequencesLong_default(dctx, dst, maxDstSize, seqStart, seqSize, nbSeq, isLongOffset);
+    return ZSTD1_decompressSequencesLong_impl[dctx->cpuImpl](dctx, dst, maxDstSize, seqStart, seqSize, nbSeq, isLongOffset);
 }
 
 /* ZSTD1_getLongOffsetsShare() :
@@ -2276,6 +2349,7 @@ size_t ZSTD1_decompressBegin(ZSTD1_DCtx* dctx)
     dctx->MLTptr = dctx->entropy.MLTable;
     dctx->OFTptr = dctx->entropy.OFTable;
     dctx->HUFptr = dctx->entropy.hufTable;
+    ZSTD1_DCtx_selectCpuImpl(dctx);   /* follows ZSTD1_forceCpuImpl() between frames */
     return 0;
 }
 
@@ -0,0 +1,242 @@
+package zstd1
+
+/*
+#define ZSTD1_STATIC_LINKING_ONLY
+#include "zstd.h"
+#include "stdint.h"  // for uintptr_t
+
+// See zstd_ctx.go for why these *_wrapper functions take uintptr_t.
+
+static size_t ZSTD1_compress_usingCDict_wrapper(ZSTD1_CCtx* cctx, uintptr_t dst, size_t maxDstSize, const uintptr_t src, size_t srcSize, const ZSTD1_CDict* cdict, int attach) {
+	size_t const err = ZSTD1_CCtx_setParameter(cctx, ZSTD1_p_forceAttachDict, attach);
+	if (ZSTD1_isError(err)) return err;
+	return ZSTD1_compress_usingCDict(cctx, (void*)dst, maxDstSize, (const void*)src, srcSize, cdict);
+}
+
+static size_t ZSTD1_decompress_usingDDict_wrapper(ZSTD1_DCtx* dctx, uintptr_t dst, size_t maxDstSize, uintptr_t src, size_t srcSize, const ZSTD1_DDict* ddict) {
+	return ZSTD1_decompress_usingDDict(dctx, (void*)dst, maxDstSize, (const void *)src, srcSize, ddict);
+}
+*/
+import "C"
+import (
+	"errors"
+	"io"
+	"runtime"
+	"unsafe"
+)
+
+var (
+	// ErrEmptyDictionary is returned when creating a prepared dictionary from
+	// an empty slice
+	ErrEmptyDictionary = errors.New("Dictionary is empty")
+	// ErrDictionaryAllocation is returned when zstd fails to digest a dictionary
+	ErrDictionaryAllocation = errors.New("Failed to create dictionary")
+)
+
+// DictAttach selects how compressions use the match-finder tables of a
+// CompressionDict.
+type DictAttach int
+
+const (
+	// DictAttachAuto attaches the dictionary to inputs of up to 8 KB to
+	// 32 KB depending on the level, and to streams, and copies it otherwise
+	DictAttachAuto DictAttach = C.ZSTD1_dictDefaultAttach
+	// DictAttachAlways attaches the dictionary whatever the input size
+	DictAttachAlways DictAttach = C.ZSTD1_dictForceAttach
+	// DictAttachNever copies the tables of the dictionary before every
+	// compression, the only mode before attaching was supported
+	DictAttachNever DictAttach = C.ZSTD1_dictForceCopy
+)
+
+// CompressionDict is a dictionary digested for compression.  Creating it
+// parses the entropy tables and hashes the dictionary content once, instead of
+// every time a payload or stream is compressed with the raw dictionary bytes.
+//
+// Compressing with an attached dictionary searches its tables in place, while
+// the context only indexes the input: otherwise the tables, hundreds of KB for
+// a large dictionary, are copied into the context before every compression,
+// which costs more than compressing a small payload.  The search is a little
+// slower per byte though, and the binary tree strategies of levels 12 to 13
+// and above always copy, see SetAttach.
+//
+// A CompressionDict is immutable and can be shared by any number of goroutines.
+// Its compression level is fixed when it is created.  Call Close to free it
+// once it is no longer used; it is otherwise freed when garbage collected.
+type CompressionDict struct {
+	cdict  *C.ZSTD1_CDict
+	level  int
+	attach DictAttach
+}
+
+// NewCompressionDict digests dict for compressing at level.  The contents of
+// dict are copied, so it can be modified once NewCompressionDict returns.
+func NewCompressionDict(dict []byte, level int) (*CompressionDict, error) {
+	if len(dict) == 0 {
+		return nil, ErrEmptyDictionary
+	}
+	if err := checkLevel(level); err != nil {
+		return nil, err
+	}
+	cdict := C.ZSTD1_createCDict(unsafe.Pointer(&dict[0]), C.size_t(len(dict)), C.int(level))
+	if cdict == nil {
+		return nil, ErrDictionaryAllocation
+	}
+	d := &CompressionDict{cdict: cdict, level: level}
+	runtime.SetFinalizer(d, (*CompressionDict).Close)
+	return d, nil
+}
+
+// Level returns the compression level the dictionary was digested for.
+func (d *CompressionDict) Level() int {
+	return d.level
+}
+
+// SetAttach selects whether compressions attach the dictionary or copy its
+// tables, DictAttachAuto by default.  It must not be called while the
+// dictionary is in use; streams already started keep the previous mode.
+func (d *CompressionDict) SetAttach(attach DictAttach) error {
+	if attach < DictAttachAuto || attach > DictAttachNever {
+		return errParamOutOfBound
+	}
+	d.attach = attach
+	return nil
+}
+
+// Close frees the allocated C objects.  The dictionary must not be in use by
+// any compression when Close is called.
+func (d *CompressionDict) Close() error {
+	if d.cdict == nil {
+		return nil
+	}
+	err := getError(int(C.ZSTD1_freeCDict(d.cdict)))
+	d.cdict = nil
+	runtime.SetFinalizer(d, nil)
+	return err
+}
+
+// DecompressionDict is a dictionary digested for decompression, the
+// counterpart of CompressionDict.
+//
+// A DecompressionDict is immutable and can be shared by any number of
+// goroutines.  Call Close to free it once it is no longer used; it is
+// otherwise freed when garbage collected.
+type DecompressionDict struct {
+	ddict *C.ZSTD1_DDict
+}
+
+// NewDecompressionDict digests dict for decompression.  The contents of dict
+// are copied, so it can be modified once NewDecompressionDict returns.
+func NewDecompressionDict(dict []byte) (*DecompressionDict, error) {
+	if len(dict) == 0 {
+		return nil, ErrEmptyDictionary
+	}
+	ddict := C.ZSTD1_createDDict(unsafe.Pointer(&dict[0]), C.size_t(len(dict)))
+	if ddict == nil {
+		return nil, ErrDictionaryAllocation
+	}
+	d := &DecompressionDict{ddict: ddict}
+	runtime.SetFinalizer(d, (*DecompressionDict).Close)
+	return d, nil
+}
+
+// ID returns the dictionary ID stored in the dictionary, or 0 if it is a raw
+// content dictionary.
+func (d *DecompressionDict) ID() uint32 {
+	id := uint32(C.ZSTD1_getDictID_fromDDict(d.ddict))
+	runtime.KeepAlive(d)
+	return id
+}
+
+// Close frees the allocated C objects.  The dictionary must not be in use by
+// any decompression when Close is called.
+func (d *DecompressionDict) Close() error {
+	if d.ddict == nil {
+		return nil
+	}
+	err := getError(int(C.ZSTD1_freeDDict(d.ddict)))
+	d.ddict = nil
+	runtime.SetFinalizer(d, nil)
+	return err
+}
+
+// CompressDict compresses src into dst using a prepared dictionary, at the
+// level the dictionary was created with.  Buffer handling is the same as for
+// Compress.
+func CompressDict(dst, src []byte, dict *CompressionDict) ([]byte, error) {
+	if len(src) == 0 {
+		return []byte{}, ErrEmptySlice
+	}
+	c, err := getCompressCtx(dict.level, len(src))
+	if err != nil {
+		return nil, err
+	}
+	defer putCompressCtx(c)
+	return c.CompressDict(dst, src, dict)
+}
+
+// DecompressDict decompresses src into dst using a prepared dictionary.
+// Buffer handling is the same as for Decompress.
+func DecompressDict(dst, src []byte, dict *DecompressionDict) ([]byte, error) {
+	if len(src) == 0 {
+		return []byte{}, ErrEmptySlice
+	}
+	d, err := getDecompressCtx()
+	if err != nil {
+		return nil, err
+	}
+	defer putDecompressCtx(d)
+	return d.DecompressDict(dst, src, dict)
+}
+
+// CompressDict is the same as CompressLevel but compresses with a prepared
+// dictionary, at the level the dictionary was created with.
+func (c *CompressCtx) CompressDict(dst, src []byte, dict *CompressionDict) ([]byte, error) {
+	if len(src) == 0 {
+		return []byte{}, ErrEmptySlice
+	}
+	bound := CompressBound(len(src))
+	if cap(dst) >= bound {
+		dst = dst[0:bound] // Reuse dst buffer
+	} else {
+		dst = make([]byte, bound)
+	}
+
+	cWritten := C.ZSTD1_compress_usingCDict_wrapper(
+		c.cctx,
+		C.uintptr_t(uintptr(unsafe.Pointer(&dst[0]))),
+		C.size_t(len(dst)),
+		C.uintptr_t(uintptr(unsafe.Pointer(&src[0]))),
+		C.size_t(len(src)),
+		dict.cdict,
+		C.int(dict.attach))
+	runtime.KeepAlive(c)
+	runtime.KeepAlive(dict)
+	runtime.KeepAlive(src)
+
+	written := int(cWritten)
+	// Check if the return is an Error code
+	if err := getError(written); err != nil {
+		return nil, err
+	}
+	return dst[:written], nil
+}
+
+// DecompressDict is the same as Decompress but decompresses with a prepared
+// dictionary.
+func (d *DecompressCtx) DecompressDict(dst, src []byte, dict *DecompressionDict) ([]byte, error) {
+	defer runtime.KeepAlive(d)
+	defer runtime.KeepAlive(dict)
+	return decompressSized(dst, src, func(dst, src []byte) int {
+		written := int(C.ZSTD1_decompress_usingDDict_wrapper(
+			d.dctx,
+			C.uintptr_t(uintptr(unsafe.Pointer(&dst[0]))),
+			C.size_t(len(dst)),
+			C.uintptr_t(uintptr(unsafe.Pointer(&src[0]))),
+			C.size_t(len(src)),
+			dict.ddict))
+		runtime.KeepAlive(src)
+		return written
+	}, func(r io.Reader) io.ReadCloser {
+		return NewReaderDecompressionDict(r, dict)
+	})
+}
@@ -0,0 +1,365 @@
+package zstd1
+
+import (
+	"bytes"
+	"fmt"
+	"io/ioutil"
+	"sync"
+	"testing"
+)
+
+// testDict is a raw content dictionary sharing vocabulary with makePayload
+var testDict = makePayload(16 << 10)
+
+func newTestDicts(t testing.TB, level int) (*CompressionDict, *DecompressionDict) {
+	cdict, err := NewCompressionDict(testDict, level)
+	if err != nil {
+		t.Fatalf("Failed to create compression dictionary: %s", err)
+	}
+	ddict, err := NewDecompressionDict(testDict)
+	if err != nil {
+		t.Fatalf("Failed to create decompression dictionary: %s", err)
+	}
+	return cdict, ddict
+}
+
+func TestDictCompressDecompress(t *testing.T) {
+	cdict, ddict := newTestDicts(t, DefaultCompression)
+	defer cdict.Close()
+	defer ddict.Close()
+
+	if cdict.Level() != DefaultCompression {
+		t.Fatalf("Unexpected dictionary level: %v", cdict.Level())
+	}
+	if ddict.ID() != 0 {
+		t.Fatalf("Raw content dictionary should not have an ID, got %v", ddict.ID())
+	}
+
+	payload := makePayload(300)
+	compressed, err := CompressDict(nil, payload, cdict)
+	failOnError(t, "Failed to compress with dictionary", err)
+	plain, err := Compress(nil, payload)
+	failOnError(t, "Failed to compress", err)
+	t.Logf("Compressed %v -> %v bytes with dictionary, %v bytes without", len(payload), len(compressed), len(plain))
+	if len(compressed) >= len(plain) {
+		t.Fatalf("Dictionary did not improve compression: %v >= %v", len(compressed), len(plain))
+	}
+
+	decompressed, err := DecompressDict(nil, compressed, ddict)
+	failOnError(t, "Failed to decompress with dictionary", err)
+	if !bytes.Equal(payload, decompressed) {
+		t.Fatalf("Payload did not match, lengths: %v & %v", len(payload), len(decompressed))
+	}
+
+	// The raw dictionary bytes must decompress the same frame
+	r := NewReaderDict(bytes.NewReader(compressed), testDict)
+	decompressed, err = ioutil.ReadAll(r)
+	failOnError(t, "Failed to decompress with raw dictionary", err)
+	failOnError(t, "Failed to close decompress object", r.Close())
+	if !bytes.Equal(payload, decompressed) {
+		t.Fatalf("Payload did not match, lengths: %v & %v", len(payload), len(decompressed))
+	}
+}
+
+func TestDictTooSmall(t *testing.T) {
+	cdict, ddict := newTestDicts(t, DefaultCompression)
+	defer cdict.Close()
+	defer ddict.Close()
+
+	payload := bytes.Repeat([]byte("Hellow World!"), 10000)
+	compressed, err := CompressDict(nil, payload, cdict)
+	failOnError(t, "Failed to compress with dictionary", err)
+	// This should switch to the decompression stream to handle too small dst
+	decompressed, err := DecompressDict(make([]byte, 1), compressed, ddict)
+	failOnError(t, "Failed to decompress with dictionary", err)
+	if !bytes.Equal(payload, decompressed) {
+		t.Fatalf("Payload did not match, lengths: %v & %v", len(payload), len(decompressed))
+	}
+}
+
+func TestDictStream(t *testing.T) {
+	cdict, ddict := newTestDicts(t, 7)
+	defer cdict.Close()
+	defer ddict.Close()
+
+	payload := makePayload(50 << 10)
+	var buf bytes.Buffer
+	w := NewWriterCompressionDict(&buf, cdict)
+	if w.CompressionLevel != 7 {
+		t.Fatalf("Writer should use the dictionary level, got %v", w.CompressionLevel)
+	}
+	_, err := w.Write(payload)
+	failOnError(t, "Failed writing to compress object", err)
+	failOnError(t, "Failed to close compress object", w.Close())
+
+	r := NewReaderDecompressionDict(bytes.NewReader(buf.Bytes()), ddict)
+	decompressed, err := ioutil.ReadAll(r)
+	failOnError(t, "Failed to decompress", err)
+	failOnError(t, "Failed to close decompress object", r.Close())
+	if !bytes.Equal(payload, decompressed) {
+		t.Fatalf("Payload did not match, lengths: %v & %v", len(payload), len(decompressed))
+	}
+
+	decompressed, err = DecompressDict(nil, buf.Bytes(), ddict)
+	failOnError(t, "Failed to decompress with DecompressDict", err)
+	if !bytes.Equal(payload, decompressed) {
+		t.Fatalf("Payload did not match, lengths: %v & %v", len(payload), len(decompressed))
+	}
+}
+
+func TestDictSharedConcurrently(t *testing.T) {
+	cdict, ddict := newTestDicts(t, DefaultCompression)
+	defer cdict.Close()
+	defer ddict.Close()
+
+	var wg sync.WaitGroup
+	errs := make(chan error, 32)
+	for g := 0; g < 32; g++ {
+		wg.Add(1)
+		go func(g int) {
+			defer wg.Done()
+			for i := 0; i < 50; i++ {
+				payload := makePayload(100 + g*10 + i)
+				compressed, err := CompressDict(nil, payload, cdict)
+				if err != nil {
+					errs <- err
+					return
+				}
+				decompressed, err := DecompressDict(nil, compressed, ddict)
+				if err != nil {
+					errs <- err
+					return
+				}
+				if !bytes.Equal(payload, decompressed) {
+					errs <- fmt.Errorf("payload mismatch for size %v", len(payload))
+					return
+				}
+			}
+		}(g)
+	}
+	wg.Wait()
+	close(errs)
+	for err := range errs {
+		t.Fatal(err)
+	}
+}
+
+func TestDictEmpty(t *testing.T) {
+	if _, err := NewCompressionDict(nil, DefaultCompression); err != ErrEmptyDictionary {
+		t.Fatalf("Did not get the correct error: %s", err)
+	}
+	if _, err := NewDecompressionDict([]byte{}); err != ErrEmptyDictionary {
+		t.Fatalf("Did not get the correct error: %s", err)
+	}
+}
+
+func BenchmarkDictStreamCompression(b *testing.B) {
+	cdict, _ := newTestDicts(b, DefaultCompression)
+	defer cdict.Close()
+	payload := makePayload(300)
+	var buf bytes.Buffer
+
+	b.Run("RawDict", func(b *testing.B) {
+		b.SetBytes(int64(len(payload)))
+		for i := 0; i < b.N; i++ {
+			buf.Reset()
+			w := NewWriterLevelDict(&buf, DefaultCompression, testDict)
+			w.Write(payload)
+			if err := w.Close(); err != nil {
+				b.Fatalf("Failed to close compress object: %s", err)
+			}
+		}
+	})
+	b.Run("CompressionDict", func(b *testing.B) {
+		b.SetBytes(int64(len(payload)))
+		for i := 0; i < b.N; i++ {
+			buf.Reset()
+			w := NewWriterCompressionDict(&buf, cdict)
+			w.Write(payload)
+			if err := w.Close(); err != nil {
+				b.Fatalf("Failed to close compress object: %s", err)
+			}
+		}
+	})
+	b.Run("CompressDict", func(b *testing.B) {
+		dst := make([]byte, CompressBound(len(payload)))
+		b.SetBytes(int64(len(payload)))
+		for i := 0; i < b.N; i++ {
+			if _, err := CompressDict(dst, payload, cdict); err != nil {
+				b.Fatalf("Failed compressing: %s", err)
+			}
+		}
+	})
+}
+
+func BenchmarkDictStreamDecompression(b *testing.B) {
+	cdict, ddict := newTestDicts(b, DefaultCompression)
+	defer cdict.Close()
+	defer ddict.Close()
+	payload := makePayload(300)
+	compressed, err := CompressDict(nil, payload, cdict)
+	if err != nil {
+		b.Fatalf("Failed compressing: %s", err)
+	}
+	dst := make([]byte, len(payload))
+
+	b.Run("RawDict", func(b *testing.B) {
+		b.SetBytes(int64(len(payload)))
+		for i := 0; i < b.N; i++ {
+			r := NewReaderDict(bytes.NewReader(compressed), testDict)
+			if _, err := r.Read(dst); err != nil {
+				b.Fatalf("Failed to decompress: %s", err)
+			}
+			r.Close()
+		}
+	})
+	b.Run("DecompressionDict", func(b *testing.B) {
+		b.SetBytes(int64(len(payload)))
+		for i := 0; i < b.N; i++ {
+			r := NewReaderDecompressionDict(bytes.NewReader(compressed), ddict)
+			if _, err := r.Read(dst); err != nil {
+				b.Fatalf("Failed to decompress: %s", err)
+			}
+			r.Close()
+		}
+	})
+	b.Run("DecompressDict", func(b *testing.B) {
+		b.SetBytes(int64(len(payload)))
+		for i := 0; i < b.N; i++ {
+			if _, err := DecompressDict(dst, compressed, ddict); err != nil {
+				b.Fatalf("Failed decompressing: %s", err)
+			}
+		}
+	})
+}
+
+var attachModes = []struct {
+	name   string
+	attach DictAttach
+}{{"Auto", DictAttachAuto}, {"Attach", DictAttachAlways}, {"Copy", DictAttachNever}}
+
+func TestDictAttach(t *testing.T) {
+	cctx := mustCompressCtx(t)
+	defer cctx.Close()
+	dctx := mustDecompressCtx(t)
+	defer dctx.Close()
+
+	// A context shared by every mode, level and dictionary checks that the
+	// tables left by one compression never leak into the next
+	for _, dict := range [][]byte{testDict[:8], testDict, makePayload(128 << 10)} {
+		ddict, err := NewDecompressionDict(dict)
+		failOnError(t, "Failed to create decompression dictionary", err)
+		for _, level := range []int{-5, 1, 3, 5, 8, 12, 19} {
+			cdict, err := NewCompressionDict(dict, level)
+			failOnError(t, "Failed to create compression dictionary", err)
+			for _, size := range []int{1, 37, 1 << 10, 20 << 10, 200 << 10} {
+				payload := makePayload(size)
+				var sizes []int
+				for _, mode := range attachModes {
+					failOnError(t, "Failed to set attach mode", cdict.SetAttach(mode.attach))
+					compressed, err := cctx.CompressDict(nil, payload, cdict)
+					failOnError(t, "Failed to compress", err)
+					decompressed, err := dctx.DecompressDict(nil, compressed, ddict)
+					failOnError(t, "Failed to decompress", err)
+					if !bytes.Equal(payload, decompressed) {
+						t.Fatalf("Dict %v, level %v, size %v, %s: payload did not match",
+							len(dict), level, size, mode.name)
+					}
+					sizes = append(sizes, len(compressed))
+				}
+				// Attaching searches the same positions as copying
+				if attached, copied := sizes[1], sizes[2]; attached > copied+copied/20+8 {
+					t.Errorf("Dict %v, level %v, size %v: attaching compressed to %v bytes, copying to %v",
+						len(dict), level, size, attached, copied)
+				}
+			}
+			cdict.Close()
+		}
+		ddict.Close()
+	}
+}
+
+func TestDictAttachStream(t *testing.T) {
+	cdict, ddict := newTestDicts(t, BestSpeed)
+	defer cdict.Close()
+	defer ddict.Close()
+
+	// Streams have no known size and attach in the default mode, until they
+	// move past the window of the dictionary: 2 MB outgrow the 512 KB window
+	// of level 1
+	var buf bytes.Buffer
+	w := NewWriterCompressionDict(&buf, cdict)
+	for _, size := range []int{300, 40 << 10, 2 << 20} {
+		for _, mode := range attachModes {
+			failOnError(t, "Failed to set attach mode", cdict.SetAttach(mode.attach))
+			buf.Reset()
+			w.Reset(&buf)
+			payload := makePayload(size)
+			for len(payload) > 0 {
+				n := 7 << 10
+				if n > len(payload) {
+					n = len(payload)
+				}
+				_, err := w.Write(payload[:n])
+				failOnError(t, "Failed to write", err)
+				payload = payload[n:]
+			}
+			failOnError(t, "Failed to close writer", w.Close())
+
+			r := NewReaderDecompressionDict(&buf, ddict)
+			decompressed, err := ioutil.ReadAll(r)
+			failOnError(t, "Failed to read", err)
+			failOnError(t, "Failed to close reader", r.Close())
+			if !bytes.Equal(makePayload(size), decompressed) {
+				t.Fatalf("Size %v, %s: stream did not match", size, mode.name)
+			}
+		}
+	}
+
+	compressed, err := CompressBatchDict(nil, [][]byte{makePayload(100), makePayload(5000)}, cdict)
+	failOnError(t, "Failed to compress batch", err)
+	for i, c := range compressed {
+		decompressed, err := DecompressDict(nil, c, ddict)
+		failOnError(t, "Failed to decompress batch item", err)
+		if !bytes.Equal(makePayload([]int{100, 5000}[i]), decompressed) {
+			t.Fatalf("Batch item %v did not match", i)
+		}
+	}
+
+	if err := cdict.SetAttach(DictAttachNever + 1); err == nil {
+		t.Fatalf("Invalid attach mode should fail")
+	}
+}
+
+// BenchmarkDictAttach compresses messages of a few sizes with dictionaries of
+// a few sizes, attaching the dictionary or copying its tables
+func BenchmarkDictAttach(b *testing.B) {
+	for _, dictSize := range []int{16 << 10, 64 << 10, 256 << 10} {
+		dict := makePayload(dictSize + 1)[:dictSize] // not seeded like a message
+		for _, level := range []int{BestSpeed, DefaultCompression} {
+			cdict, err := NewCompressionDict(dict, level)
+			if err != nil {
+				b.Fatalf("Failed to create compression dictionary: %s", err)
+			}
+			for _, size := range []int{256, 1 << 10, 4 << 10, 16 << 10} {
+				payload := makePayload(size)
+				for _, mode := range attachModes[1:] {
+					name := fmt.Sprintf("Dict%dK/Level%d/%d/%s", dictSize>>10, level, size, mode.name)
+					b.Run(name, func(b *testing.B) {
+						cdict.SetAttach(mode.attach)
+						cctx := mustCompressCtx(b)
+						defer cctx.Close()
+						dst := make([]byte, CompressBound(size))
+						b.SetBytes(int64(size))
+						for i := 0; i < b.N; i++ {
+							if _, err := cctx.CompressDict(dst, payload, cdict); err != nil {
+								b.Fatalf("Failed compressing: %s", err)
+							}
+						}
+					})
+				}
+			}
+			cdict.Close()
+		}
+	}
+}
@@ -178,6 +178,206 @@ size_t ZSTD1_compressBlock_doubleFast(
 }
 
 
+/* Like ZSTD1_compressBlock_doubleFast_generic(), falling back to the long
+ * and short hash tables of the attached dictionary, which are read only.
+ * A dictionary index translates to the context's index space by adding
+ * dictIndexDelta. */
+FORCE_INLINE_TEMPLATE
+size_t ZSTD1_compressBlock_doubleFast_dictMatchState_generic(
+        ZSTD1_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD1_REP_NUM],
+        ZSTD1_compressionParameters const* cParams, void const* src, size_t srcSize,
+        U32 const mls /* template */)
+{
+    U32* const hashLong = ms->hashTable;
+    const U32 hBitsL = cParams->hashLog;
+    U32* const hashSmall = ms->chainTable;
+    const U32 hBitsS = cParams->chainLog;
+    const BYTE* const base = ms->window.base;
+    const BYTE* const istart = (const BYTE*)src;
+    const BYTE* ip = istart;
+    const BYTE* anchor = istart;
+    const U32 prefixStartIndex = ms->window.dictLimit;
+    const BYTE* const prefixStart = base + prefixStartIndex;
+    const BYTE* const iend = istart + srcSize;
+    const BYTE* const ilimit = iend - HASH_READ_SIZE;
+    U32 offset_1=rep[0], offset_2=rep[1];
+    U32 offsetSaved = 0;
+
+    const ZSTD1_matchState_t* const dms = ms->dictMatchState;
+    const U32* const dictHashLong  = dms->hashTable;
+    const U32* const dictHashSmall = dms->chainTable;
+    const U32 dictStartIndex = dms->window.dictLimit;
+    const BYTE* const dictBase = dms->window.base;
+    const BYTE* const dictStart = dictBase + dictStartIndex;
+    const BYTE* const dictEnd = dms->window.nextSrc;
+    const U32 dictIndexDelta = prefixStartIndex - (U32)(dictEnd - dictBase);
+    const U32 lowestIndex = dictStartIndex + dictIndexDelta;   /* in the context's index space */
+
+    assert(prefixStartIndex >= (U32)(dictEnd - dictBase));
+
+    /* init */
+    ip += (ip==prefixStart) & (dictEnd==dictStart);
+    {   U32 const maxRep = (U32)(ip-prefixStart) + (U32)(dictEnd-dictStart);
+        if (offset_2 > maxRep) offsetSaved = offset_2, offset_2 = 0;
+        if (offset_1 > maxRep) offsetSaved = offset_1, offset_1 = 0;
+    }
+
+    /* Main Search Loop */
+    while (ip < ilimit) {   /* < instead of <=, because repcode check at (ip+1) */
+        size_t mLength;
+        U32 offset;
+        size_t const h2 = ZSTD1_hashPtr(ip, hBitsL, 8);
+        size_t const h = ZSTD1_hashPtr(ip, hBitsS, mls);
+        U32 const current = (U32)(ip-base);
+        U32 const matchIndexL = hashLong[h2];
+        U32 const matchIndexS = hashSmall[h];
+        const BYTE* matchLong = base + matchIndexL;
+        const BYTE* match = base + matchIndexS;
+        U32 const repIndex = current + 1 - offset_1;
+        const BYTE* const repMatch = repIndex < prefixStartIndex ?
+                                     dictBase + (repIndex - dictIndexDelta) :
+                                     base + repIndex;
+        hashLong[h2] = hashSmall[h] = current;   /* update hash tables */
+
+        if ( (offset_1 > 0)
+          && (((U32)((prefixStartIndex-1) - repIndex) >= 3) /* intentional underflow */ & (repIndex > lowestIndex))
+          && (MEM_read32(repMatch) == MEM_read32(ip+1)) ) {
+            /* favor repcode */
+            const BYTE* const repMatchEnd = repIndex < prefixStartIndex ? dictEnd : iend;
+            mLength = ZSTD1_count_2segments(ip+1+4, repMatch+4, iend, repMatchEnd, prefixStart) + 4;
+            ip++;
+            ZSTD1_storeSeq(seqStore, ip-anchor, anchor, 0, mLength-MINMATCH);
+            goto _match_stored;
+        }
+
+        if ( (matchIndexL > prefixStartIndex) && (MEM_read64(matchLong) == MEM_read64(ip)) ) {
+            mLength = ZSTD1_count(ip+8, matchLong+8, iend) + 8;
+            offset = (U32)(ip-matchLong);
+            while (((ip>anchor) & (matchLong>prefixStart)) && (ip[-1] == matchLong[-1])) { ip--; matchLong--; mLength++; } /* catch up */
+            goto _match_found;
+        }
+        {   U32 const dictMatchIndexL = dictHashLong[h2];
+            const BYTE* dictMatchL = dictBase + dictMatchIndexL;
+            if ( (dictMatchIndexL > dictStartIndex) && (MEM_read64(dictMatchL) == MEM_read64(ip)) ) {
+                mLength = ZSTD1_count_2segments(ip+8, dictMatchL+8, iend, dictEnd, prefixStart) + 8;
+                offset = current - (dictMatchIndexL + dictIndexDelta);
+                while (((ip>anchor) & (dictMatchL>dictStart)) && (ip[-1] == dictMatchL[-1])) { ip--; dictMatchL--; mLength++; } /* catch up */
+                goto _match_found;
+        }   }
+
+        {   /* short match candidate, from the prefix first */
+            const BYTE* matchEnd = iend;
+            const BYTE* lowMatchPtr = prefixStart;
+            if ( (matchIndexS <= prefixStartIndex) || (MEM_read32(match) != MEM_read32(ip)) ) {
+                U32 const dictMatchIndexS = dictHashSmall[h];
+                match = dictBase + dictMatchIndexS;
+                matchEnd = dictEnd;
+                lowMatchPtr = dictStart;
+                offset = current - (dictMatchIndexS + dictIndexDelta);
+                if ( (dictMatchIndexS <= dictStartIndex) || (MEM_read32(match) != MEM_read32(ip)) ) {
+                    ip += ((ip-anchor) >> kSearchStrength) + 1;
+                    continue;
+                }
+            } else {
+                offset = (U32)(ip-match);
+            }
+
+            /* look for a long match at ip+1 before settling for the short one */
+            {   size_t const hl3 = ZSTD1_hashPtr(ip+1, hBitsL, 8);
+                U32 const matchIndexL3 = hashLong[hl3];
+                const BYTE* matchL3 = base + matchIndexL3;
+                hashLong[hl3] = current + 1;
+                if ( (matchIndexL3 > prefixStartIndex) && (MEM_read64(matchL3) == MEM_read64(ip+1)) ) {
+                    mLength = ZSTD1_count(ip+9, matchL3+8, iend) + 8;
+                    ip++;
+                    offset = (U32)(ip-matchL3);
+                    while (((ip>anchor) & (matchL3>prefixStart)) && (ip[-1] == matchL3[-1])) { ip--; matchL3--; mLength++; } /* catch up */
+                    goto _match_found;
+                }
+                {   U32 const dictMatchIndexL3 = dictHashLong[hl3];
+                    const BYTE* dictMatchL3 = dictBase + dictMatchIndexL3;
+                    if ( (dictMatchIndexL3 > dictStartIndex) && (MEM_read64(dictMatchL3) == MEM_read64(ip+1)) ) {
+                        mLength = ZSTD1_count_2segments(ip+1+8, dictMatchL3+8, iend, dictEnd, prefixStart) + 8;
+                        ip++;
+                        offset = current + 1 - (dictMatchIndexL3 + dictIndexDelta);
+                        while (((ip>anchor) & (dictMatchL3>dictStart)) && (ip[-1] == dictMatchL3[-1])) { ip--; dictMatchL3--; mLength++; } /* catch up */
+                        goto _match_found;
+            }   }   }
+
+            mLength = ZSTD1_count_2segments(ip+4, match+4, iend, matchEnd, prefixStart) + 4;
+            while (((ip>anchor) & (match>lowMatchPtr)) && (ip[-1] == match[-1])) { ip--; match--; mLength++; } /* catch up */
+        }
+
+_match_found:
+        offset_2 = offset_1;
+        offset_1 = offset;
+        ZSTD1_storeSeq(seqStore, ip-anchor, anchor, offset + ZSTD1_REP_MOVE, mLength-MINMATCH);
+
+_match_stored:
+        /* match found */
+        ip += mLength;
+        anchor = ip;
+
+        if (ip <= ilimit) {
+            /* Fill Table */
+            hashLong[ZSTD1_hashPtr(base+current+2, hBitsL, 8)] =
+                hashSmall[ZSTD1_hashPtr(base+current+2, hBitsS, mls)] = current+2;  /* here because current+2 could be > iend-8 */
+            hashLong[ZSTD1_hashPtr(ip-2, hBitsL, 8)] =
+                hashSmall[ZSTD1_hashPtr(ip-2, hBitsS, mls)] = (U32)(ip-2-base);
+
+            /* check immediate repcode */
+            while (ip <= ilimit) {
+                U32 const current2 = (U32)(ip-base);
+                U32 const repIndex2 = current2 - offset_2;
+                const BYTE* const repMatch2 = repIndex2 < prefixStartIndex ?
+                                              dictBase + (repIndex2 - dictIndexDelta) :
+                                              base + repIndex2;
+                if ( (offset_2 > 0)
+                  && (((U32)((prefixStartIndex-1) - repIndex2) >= 3) & (repIndex2 > lowestIndex))  /* intentional overflow */
+                  && (MEM_read32(repMatch2) == MEM_read32(ip)) ) {
+                    const BYTE* const repEnd2 = repIndex2 < prefixStartIndex ? dictEnd : iend;
+                    size_t const repLength2 = ZSTD1_count_2segments(ip+4, repMatch2+4, iend, repEnd2, prefixStart) + 4;
+                    U32 const tmpOffset = offset_2; offset_2 = offset_1; offset_1 = tmpOffset;   /* swap offset_2 <=> offset_1 */
+                    ZSTD1_storeSeq(seqStore, 0, anchor, 0, repLength2-MINMATCH);
+                    hashSmall[ZSTD1_hashPtr(ip, hBitsS, mls)] = current2;
+                    hashLong[ZSTD1_hashPtr(ip, hBitsL, 8)] = current2;
+                    ip += repLength2;
+                    anchor = ip;
+                    continue;
+                }
+                break;
+    }   }   }
+
+    /* save reps for next block */
+    rep[0] = offset_1 ? offset_1 : offsetSaved;
+    rep[1] = offset_2 ? offset_2 : offsetSaved;
+
+    /* Return the last literals size */
+    return iend - anchor;
+}
+
+
+size_t ZSTD1_compressBlock_doubleFast_dictMatchState(
+        ZSTD1_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD1_REP_NUM],
+        ZSTD1_compressionParameters const* cParams, void const* src, size_t srcSize)
+{
+    const U32 mls = cParams->searchLength;
+    assert(ms->dictMatchState != NULL);
+    switch(mls)
+    {
+    default: /* includes case 3 */
+    case 4 :
+        return ZSTD1_compressBlock_doubleFast_dictMatchState_generic(ms, seqStore, rep, cParams, src, srcSize, 4);
+    case 5 :
+        return ZSTD1_compressBlock_doubleFast_dictMatchState_generic(ms, seqStore, rep, cParams, src, srcSize, 5);
+    case 6 :
+        return ZSTD1_compressBlock_doubleFast_dictMatchState_generic(ms, seqStore, rep, cParams, src, srcSize, 6);
+    case 7 :
+        return ZSTD1_compressBlock_doubleFast_dictMatchState_generic(ms, seqStore, rep, cParams, src, srcSize, 7);
+    }
+}
+
+
 static size_t ZSTD1_compressBlock_doubleFast_extDict_generic(
         ZSTD1_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD1_REP_NUM],
         ZSTD1_compressionParameters const* cParams, void const* src, size_t srcSize,
@@ -24,6 +24,9 @@ void ZSTD1_fillDoubleHashTable(ZSTD1_matchState_t* ms,
 size_t ZSTD1_compressBlock_doubleFast(
         ZSTD1_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD1_REP_NUM],
         ZSTD1_compressionParameters const* cParams, void const* src, size_t srcSize);
+size_t ZSTD1_compressBlock_doubleFast_dictMatchState(
+        ZSTD1_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD1_REP_NUM],
+        ZSTD1_compressionParameters const* cParams, void const* src, size_t srcSize);
 size_t ZSTD1_compressBlock_doubleFast_extDict(
         ZSTD1_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD1_REP_NUM],
         ZSTD1_compressionParameters const* cParams, void const* src, size_t srcSize);
@@ -38,11 +38,20 @@ void ZSTD1_fillHashTable(ZSTD1_matchState_t* ms,
     }
 }
 
+/* Negative levels set stepSize to their acceleration factor.  From
+ * ZSTD1_FAST_ACCEL_MIN on, the search loop no longer probes the repcode at
+ * ip+1 before every hash lookup, and only one position is inserted into the
+ * hash table after a match : most positions are skipped anyway at such
+ * speeds, and these probes and insertions dominate the remaining cost. */
+#ifndef ZSTD1_FAST_ACCEL_MIN
+#  define ZSTD1_FAST_ACCEL_MIN 8
+#endif
+
 FORCE_INLINE_TEMPLATE
 size_t ZSTD1_compressBlock_fast_generic(
         ZSTD1_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD1_REP_NUM],
         void const* src, size_t srcSize,
-        U32 const hlog, U32 const stepSize, U32 const mls)
+        U32 const hlog, U32 const stepSize, U32 const mls, U32 const accel)
 {
     U32* const hashTable = ms->hashTable;
     const BYTE* const base = ms->window.base;
@@ -72,7 +81,7 @@ size_t ZSTD1_compressBlock_fast_generic(
         const BYTE* match = base + matchIndex;
         hashTable[h] = current;   /* update hash table */
 
-        if ((offset_1 > 0) & (MEM_read32(ip+1-offset_1) == MEM_read32(ip+1))) {
+        if (!accel && (offset_1 > 0) & (MEM_read32(ip+1-offset_1) == MEM_read32(ip+1))) {
             mLength = ZSTD1_count(ip+1+4, ip+1+4-offset_1, iend) + 4;
             ip++;
             ZSTD1_storeSeq(seqStore, ip-anchor, anchor, 0, mLength-MINMATCH);
@@ -97,7 +106,8 @@ size_t ZSTD1_compressBlock_fast_generic(
 
         if (ip <= ilimit) {
             /* Fill Table */
-            hashTable[ZSTD1_hashPtr(base+current+2, hlog, mls)] = current+2;  /* here because current+2 could be > iend-8 */
+            if (!accel)
+                hashTable[ZSTD1_hashPtr(base+current+2, hlog, mls)] = current+2;  /* here because current+2 could be > iend-8 */
             hashTable[ZSTD1_hashPtr(ip-2, hlog, mls)] = (U32)(ip-2-base);
             /* check immediate repcode */
             while ( (ip <= ilimit)
@@ -129,17 +139,180 @@ size_t ZSTD1_compressBlock_fast(
     U32 const hlog = cParams->hashLog;
     U32 const mls = cParams->searchLength;
     U32 const stepSize = cParams->targetLength;
+    if (stepSize >= ZSTD1_FAST_ACCEL_MIN) {
+        switch(mls)
+        {
+        default: /* includes case 3 */
+        case 4 :
+            return ZSTD1_compressBlock_fast_generic(ms, seqStore, rep, src, srcSize, hlog, stepSize, 4, 1);
+        case 5 :
+            return ZSTD1_compressBlock_fast_generic(ms, seqStore, rep, src, srcSize, hlog, stepSize, 5, 1);
+        case 6 :
+            return ZSTD1_compressBlock_fast_generic(ms, seqStore, rep, src, srcSize, hlog, stepSize, 6, 1);
+        case 7 :
+            return ZSTD1_compressBlock_fast_generic(ms, seqStore, rep, src, srcSize, hlog, stepSize, 7, 1);
+        }
+    }
+    switch(mls)
+    {
+    default: /* includes case 3 */
+    case 4 :
+        return ZSTD1_compressBlock_fast_generic(ms, seqStore, rep, src, srcSize, hlog, stepSize, 4, 0);
+    case 5 :
+        return ZSTD1_compressBlock_fast_generic(ms, seqStore, rep, src, srcSize, hlog, stepSize, 5, 0);
+    case 6 :
+        return ZSTD1_compressBlock_fast_generic(ms, seqStore, rep, src, srcSize, hlog, stepSize, 6, 0);
+    case 7 :
+        return ZSTD1_compressBlock_fast_generic(ms, seqStore, rep, src, srcSize, hlog, stepSize, 7, 0);
+    }
+}
+
+
+/* Searches the prefix through the context's hash table, then the attached
+ * dictionary through its own, read-only, hash table.  A dictionary index
+ * translates to the context's index space by adding dictIndexDelta, which
+ * ZSTD1_resetCCtx_attachDict() guarantees not to underflow. */
+FORCE_INLINE_TEMPLATE
+size_t ZSTD1_compressBlock_fast_dictMatchState_generic(
+        ZSTD1_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD1_REP_NUM],
+        void const* src, size_t srcSize,
+        U32 const hlog, U32 const stepSize, U32 const mls)
+{
+    U32* const hashTable = ms->hashTable;
+    const BYTE* const base = ms->window.base;
+    const BYTE* const istart = (const BYTE*)src;
+    const BYTE* ip = istart;
+    const BYTE* anchor = istart;
+    const U32   prefixStartIndex = ms->window.dictLimit;
+    const BYTE* const prefixStart = base + prefixStartIndex;
+    const BYTE* const iend = istart + srcSize;
+    const BYTE* const ilimit = iend - HASH_READ_SIZE;
+    U32 offset_1=rep[0], offset_2=rep[1];
+    U32 offsetSaved = 0;
+
+    const ZSTD1_matchState_t* const dms = ms->dictMatchState;
+    const U32* const dictHashTable = dms->hashTable;
+    const U32   dictStartIndex = dms->window.dictLimit;
+    const BYTE* const dictBase = dms->window.base;
+    const BYTE* const dictStart = dictBase + dictStartIndex;
+    const BYTE* const dictEnd = dms->window.nextSrc;
+    const U32   dictIndexDelta = prefixStartIndex - (U32)(dictEnd - dictBase);
+    const U32   lowestIndex = dictStartIndex + dictIndexDelta;   /* in the context's index space */
+
+    assert(prefixStartIndex >= (U32)(dictEnd - dictBase));
+
+    /* init */
+    ip += (ip==prefixStart) & (dictEnd==dictStart);
+    {   U32 const maxRep = (U32)(ip-prefixStart) + (U32)(dictEnd-dictStart);
+        if (offset_2 > maxRep) offsetSaved = offset_2, offset_2 = 0;
+        if (offset_1 > maxRep) offsetSaved = offset_1, offset_1 = 0;
+    }
+
+    /* Main Search Loop */
+    while (ip < ilimit) {   /* < instead of <=, because repcode check at (ip+1) */
+        size_t mLength;
+        size_t const h = ZSTD1_hashPtr(ip, hlog, mls);
+        U32 const current = (U32)(ip-base);
+        U32 const matchIndex = hashTable[h];
+        const BYTE* match = base + matchIndex;
+        U32 const repIndex = current + 1 - offset_1;   /* offset_1 expected <= current +1 */
+        const BYTE* const repMatch = repIndex < prefixStartIndex ?
+                                     dictBase + (repIndex - dictIndexDelta) :
+                                     base + repIndex;
+        hashTable[h] = current;   /* update hash table */
+
+        if ( (offset_1 > 0)
+          && (((U32)((prefixStartIndex-1) - repIndex) >= 3) /* intentional underflow */ & (repIndex > lowestIndex))
+          && (MEM_read32(repMatch) == MEM_read32(ip+1)) ) {
+            const BYTE* const repMatchEnd = repIndex < prefixStartIndex ? dictEnd : iend;
+            mLength = ZSTD1_count_2segments(ip+1+4, repMatch+4, iend, repMatchEnd, prefixStart) + 4;
+            ip++;
+            ZSTD1_storeSeq(seqStore, ip-anchor, anchor, 0, mLength-MINMATCH);
+        } else if ( (matchIndex > prefixStartIndex)
+                 && (MEM_read32(match) == MEM_read32(ip)) ) {
+            /* found a match in the prefix */
+            U32 const offset = (U32)(ip-match);
+            mLength = ZSTD1_count(ip+4, match+4, iend) + 4;
+            while (((ip>anchor) & (match>prefixStart)) && (ip[-1] == match[-1])) { ip--; match--; mLength++; } /* catch up */
+            offset_2 = offset_1;
+            offset_1 = offset;
+            ZSTD1_storeSeq(seqStore, ip-anchor, anchor, offset + ZSTD1_REP_MOVE, mLength-MINMATCH);
+        } else {
+            U32 const dictMatchIndex = dictHashTable[h];
+            const BYTE* dictMatch = dictBase + dictMatchIndex;
+            if ( (dictMatchIndex <= dictStartIndex)
+              || (MEM_read32(dictMatch) != MEM_read32(ip)) ) {
+                assert(stepSize >= 1);
+                ip += ((ip-anchor) >> kSearchStrength) + stepSize;
+                continue;
+            }
+            /* found a match in the dictionary */
+            {   U32 const offset = current - (dictMatchIndex + dictIndexDelta);
+                mLength = ZSTD1_count_2segments(ip+4, dictMatch+4, iend, dictEnd, prefixStart) + 4;
+                while (((ip>anchor) & (dictMatch>dictStart)) && (ip[-1] == dictMatch[-1])) { ip--; dictMatch--; mLength++; } /* catch up */
+                offset_2 = offset_1;
+                offset_1 = offset;
+                ZSTD1_storeSeq(seqStore, ip-anchor, anchor, offset + ZSTD1_REP_MOVE, mLength-MINMATCH);
+        }   }
+
+        /* match found */
+        ip += mLength;
+        anchor = ip;
+
+        if (ip <= ilimit) {
+            /* Fill Table */
+            hashTable[ZSTD1_hashPtr(base+current+2, hlog, mls)] = current+2;  /* here because current+2 could be > iend-8 */
+            hashTable[ZSTD1_hashPtr(ip-2, hlog, mls)] = (U32)(ip-2-base);
+            /* check immediate repcode */
+            while (ip <= ilimit) {
+                U32 const current2 = (U32)(ip-base);
+                U32 const repIndex2 = current2 - offset_2;
+                const BYTE* const repMatch2 = repIndex2 < prefixStartIndex ?
+                                              dictBase + (repIndex2 - dictIndexDelta) :
+                                              base + repIndex2;
+                if ( (offset_2 > 0)
+                  && (((U32)((prefixStartIndex-1) - repIndex2) >= 3) & (repIndex2 > lowestIndex))  /* intentional overflow */
+                  && (MEM_read32(repMatch2) == MEM_read32(ip)) ) {
+                    const BYTE* const repEnd2 = repIndex2 < prefixStartIndex ? dictEnd : iend;
+                    size_t const repLength2 = ZSTD1_count_2segments(ip+4, repMatch2+4, iend, repEnd2, prefixStart) + 4;
+                    U32 const tmpOffset = offset_2; offset_2 = offset_1; offset_1 = tmpOffset;   /* swap offset_2 <=> offset_1 */
+                    ZSTD1_storeSeq(seqStore, 0, anchor, 0, repLength2-MINMATCH);
+                    hashTable[ZSTD1_hashPtr(ip, hlog, mls)] = current2;
+                    ip += repLength2;
+                    anchor = ip;
+                    continue;
+                }
+                break;
+    }   }   }
+
+    /* save reps for next block */
+    rep[0] = offset_1 ? offset_1 : offsetSaved;
+    rep[1] = offset_2 ? offset_2 : offsetSaved;
+
+    /* Return the last literals size */
+    return iend - anchor;
+}
+
+
+size_t ZSTD1_compressBlock_fast_dictMatchState(
+        ZSTD1_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD1_REP_NUM],
+        ZSTD1_compressionParameters const* cParams, void const* src, size_t srcSize)
+{
+    U32 const hlog = cParams->hashLog;
+    U32 const mls = cParams->searchLength;
+    U32 const stepSize = cParams->targetLength;
+    assert(ms->dictMatchState != NULL);
     switch(mls)
     {
     default: /* includes case 3 */
     case 4 :
-        return ZSTD1_compressBlock_fast_generic(ms, seqStore, rep, src, srcSize, hlog, stepSize, 4);
+        return ZSTD1_compressBlock_fast_dictMatchState_generic(ms, seqStore, rep, src, srcSize, hlog, stepSize, 4);
     case 5 :
-        return ZSTD1_compressBlock_fast_generic(ms, seqStore, rep, src, srcSize, hlog, stepSize, 5);
+        return ZSTD1_compressBlock_fast_dictMatchState_generic(ms, seqStore, rep, src, srcSize, hlog, stepSize, 5);
     case 6 :
-        return ZSTD1_compressBlock_fast_generic(ms, seqStore, rep, src, srcSize, hlog, stepSize, 6);
+        return ZSTD1_compressBlock_fast_dictMatchState_generic(ms, seqStore, rep, src, srcSize, hlog, stepSize, 6);
     case 7 :
-        return ZSTD1_compressBlock_fast_generic(ms, seqStore, rep, src, srcSize, hlog, stepSize, 7);
+        return ZSTD1_compressBlock_fast_dictMatchState_generic(ms, seqStore, rep, src, srcSize, hlog, stepSize, 7);
     }
 }
 
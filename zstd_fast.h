@@ -24,6 +24,9 @@ void ZSTD1_fillHashTable(ZSTD1_matchState_t* ms,
 size_t ZSTD1_compressBlock_fast(
         ZSTD1_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD1_REP_NUM],
         ZSTD1_compressionParameters const* cParams, void const* src, size_t srcSize);
+size_t ZSTD1_compressBlock_fast_dictMatchState(
+        ZSTD1_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD1_REP_NUM],
+        ZSTD1_compressionParameters const* cParams, void const* src, size_t srcSize);
 size_t ZSTD1_compressBlock_fast_extDict(
         ZSTD1_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD1_REP_NUM],
         ZSTD1_compressionParameters const* cParams, void const* src, size_t srcSize);
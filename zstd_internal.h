@@ -187,8 +187,8 @@ static void ZSTD1_copy8(void* dst, const void* src) { memcpy(dst, src, 8); }
 #define COPY8(d,s) { ZSTD1_copy8(d,s); d+=8; s+=8; }
 
 /*! ZSTD1_wildcopy() :
- *  custom version of memcpy(), can overwrite up to WILDCOPY_OVERLENGTH bytes (if length==0) */
-#define WILDCOPY_OVERLENGTH 8
+ *  custom version of memcpy(), can overwrite up to 8 bytes (if length==0) */
+#define WILDCOPY_OVERLENGTH 32   /* the decoder copies up to 32 bytes at a time */
 MEM_STATIC void ZSTD1_wildcopy(void* dst, const void* src, ptrdiff_t length)
 {
     const BYTE* ip = (const BYTE*)src;
@@ -239,6 +239,20 @@ void* ZSTD1_malloc(size_t size, ZSTD1_customMem customMem);
 void* ZSTD1_calloc(size_t size, ZSTD1_customMem customMem);
 void ZSTD1_free(void* ptr, ZSTD1_customMem customMem);
 
+/* ZSTD1_countWide :
+ * vector variant of the loop of ZSTD1_count() for the CPU tier in use, NULL
+ * when the tier has none.  zstd_common.c resolves it with the tier, and
+ * republishes it when ZSTD1_forceCpuImpl() changes the tier.
+ * Requires pInLimit - pIn >= ZSTD1_COUNT_WIDE_MIN. */
+#define ZSTD1_COUNT_WIDE_MIN 32
+typedef size_t (*ZSTD1_countWide_f)(const BYTE* pIn, const BYTE* pMatch, const BYTE* pInLimit);
+extern ZSTD1_countWide_f ZSTD1_countWide;   /* compress */
+
+MEM_STATIC ZSTD1_countWide_f ZSTD1_getCountWide(void)
+{
+    return __atomic_load_n(&ZSTD1_countWide, __ATOMIC_RELAXED);
+}
+
 
 MEM_STATIC U32 ZSTD1_highbit32(U32 val)   /* compress, dictBuilder, decodeCorpus */
 {
@@ -376,7 +376,7 @@ size_t ZSTD1_HcFindBestMatch_generic (
                         ZSTD1_matchState_t* ms, ZSTD1_compressionParameters const* cParams,
                         const BYTE* const ip, const BYTE* const iLimit,
                         size_t* offsetPtr,
-                        const U32 mls, const U32 extDict)
+                        const U32 mls, const ZSTD1_dictMode_e dictMode)
 {
     U32* const chainTable = ms->chainTable;
     const U32 chainSize = (1 << cParams->chainLog);
@@ -397,7 +397,7 @@ size_t ZSTD1_HcFindBestMatch_generic (
 
     for ( ; (matchIndex>lowLimit) & (nbAttempts>0) ; nbAttempts--) {
         size_t currentMl=0;
-        if ((!extDict) || matchIndex >= dictLimit) {
+        if ((dictMode != ZSTD1_extDict) || matchIndex >= dictLimit) {
             const BYTE* const match = base + matchIndex;
             if (match[ml] == ip[ml])   /* potentially better */
                 currentMl = ZSTD1_count(ip, match, iLimit);
@@ -419,6 +419,39 @@ size_t ZSTD1_HcFindBestMatch_generic (
         matchIndex = NEXT_IN_CHAIN(matchIndex, chainMask);
     }
 
+    if (dictMode == ZSTD1_dictMatchState) {
+        /* continue with the chain of the attached dictionary, which shares
+         * the table sizes of the context */
+        const ZSTD1_matchState_t* const dms = ms->dictMatchState;
+        const U32* const dmsChainTable = dms->chainTable;
+        const U32 dmsLowestIndex = dms->window.dictLimit;
+        const BYTE* const dmsBase = dms->window.base;
+        const BYTE* const dmsEnd = dms->window.nextSrc;
+        const U32 dmsSize = (U32)(dmsEnd - dmsBase);
+        const U32 dmsIndexDelta = dictLimit - dmsSize;
+        const U32 dmsMinChain = dmsSize > chainSize ? dmsSize - chainSize : 0;
+
+        matchIndex = dms->hashTable[ZSTD1_hashPtr(ip, cParams->hashLog, mls)];
+
+        for ( ; (matchIndex>dmsLowestIndex) & (nbAttempts>0) ; nbAttempts--) {
+            size_t currentMl=0;
+            const BYTE* const match = dmsBase + matchIndex;
+            assert(match+4 <= dmsEnd);
+            if (MEM_read32(match) == MEM_read32(ip))   /* assumption : matchIndex <= dmsSize-4 (by table construction) */
+                currentMl = ZSTD1_count_2segments(ip+4, match+4, iLimit, dmsEnd, prefixStart) + 4;
+
+            /* save best solution */
+            if (currentMl > ml) {
+                ml = currentMl;
+                *offsetPtr = current - (matchIndex + dmsIndexDelta) + ZSTD1_REP_MOVE;
+                if (ip+currentMl == iLimit) break; /* best possible, avoids read overflow on next attempt */
+            }
+
+            if (matchIndex <= dmsMinChain) break;
+            matchIndex = dmsChainTable[matchIndex & chainMask];
+        }
+    }
+
     return ml;
 }
 
@@ -431,10 +464,10 @@ FORCE_INLINE_TEMPLATE size_t ZSTD1_HcFindBestMatch_selectMLS (
     switch(cParams->searchLength)
     {
     default : /* includes case 3 */
-    case 4 : return ZSTD1_HcFindBestMatch_generic(ms, cParams, ip, iLimit, offsetPtr, 4, 0);
-    case 5 : return ZSTD1_HcFindBestMatch_generic(ms, cParams, ip, iLimit, offsetPtr, 5, 0);
+    case 4 : return ZSTD1_HcFindBestMatch_generic(ms, cParams, ip, iLimit, offsetPtr, 4, ZSTD1_noDict);
+    case 5 : return ZSTD1_HcFindBestMatch_generic(ms, cParams, ip, iLimit, offsetPtr, 5, ZSTD1_noDict);
     case 7 :
-    case 6 : return ZSTD1_HcFindBestMatch_generic(ms, cParams, ip, iLimit, offsetPtr, 6, 0);
+    case 6 : return ZSTD1_HcFindBestMatch_generic(ms, cParams, ip, iLimit, offsetPtr, 6, ZSTD1_noDict);
     }
 }
 
@@ -447,10 +480,26 @@ FORCE_INLINE_TEMPLATE size_t ZSTD1_HcFindBestMatch_extDict_selectMLS (
     switch(cParams->searchLength)
     {
     default : /* includes case 3 */
-    case 4 : return ZSTD1_HcFindBestMatch_generic(ms, cParams, ip, iLimit, offsetPtr, 4, 1);
-    case 5 : return ZSTD1_HcFindBestMatch_generic(ms, cParams, ip, iLimit, offsetPtr, 5, 1);
+    case 4 : return ZSTD1_HcFindBestMatch_generic(ms, cParams, ip, iLimit, offsetPtr, 4, ZSTD1_extDict);
+    case 5 : return ZSTD1_HcFindBestMatch_generic(ms, cParams, ip, iLimit, offsetPtr, 5, ZSTD1_extDict);
+    case 7 :
+    case 6 : return ZSTD1_HcFindBestMatch_generic(ms, cParams, ip, iLimit, offsetPtr, 6, ZSTD1_extDict);
+    }
+}
+
+
+FORCE_INLINE_TEMPLATE size_t ZSTD1_HcFindBestMatch_dictMatchState_selectMLS (
+                        ZSTD1_matchState_t* ms, ZSTD1_compressionParameters const* cParams,
+                        const BYTE* ip, const BYTE* const iLimit,
+                        size_t* const offsetPtr)
+{
+    switch(cParams->searchLength)
+    {
+    default : /* includes case 3 */
+    case 4 : return ZSTD1_HcFindBestMatch_generic(ms, cParams, ip, iLimit, offsetPtr, 4, ZSTD1_dictMatchState);
+    case 5 : return ZSTD1_HcFindBestMatch_generic(ms, cParams, ip, iLimit, offsetPtr, 5, ZSTD1_dictMatchState);
     case 7 :
-    case 6 : return ZSTD1_HcFindBestMatch_generic(ms, cParams, ip, iLimit, offsetPtr, 6, 1);
+    case 6 : return ZSTD1_HcFindBestMatch_generic(ms, cParams, ip, iLimit, offsetPtr, 6, ZSTD1_dictMatchState);
     }
 }
 
@@ -623,12 +672,13 @@ size_t ZSTD1_compressBlock_greedy(
 
 
 FORCE_INLINE_TEMPLATE
-size_t ZSTD1_compressBlock_lazy_extDict_generic(
+size_t ZSTD1_compressBlock_lazy_2segments_generic(
                         ZSTD1_matchState_t* ms, seqStore_t* seqStore,
                         U32 rep[ZSTD1_REP_NUM],
                         ZSTD1_compressionParameters const* cParams,
                         const void* src, size_t srcSize,
-                        const U32 searchMethod, const U32 depth)
+                        const U32 searchMethod, const U32 depth,
+                        const ZSTD1_dictMode_e dictMode)
 {
     const BYTE* const istart = (const BYTE*)src;
     const BYTE* ip = istart;
@@ -637,22 +687,47 @@ size_t ZSTD1_compressBlock_lazy_extDict_generic(
     const BYTE* const ilimit = iend - 8;
     const BYTE* const base = ms->window.base;
     const U32 dictLimit = ms->window.dictLimit;
-    const U32 lowestIndex = ms->window.lowLimit;
     const BYTE* const prefixStart = base + dictLimit;
-    const BYTE* const dictBase = ms->window.dictBase;
+    /* The segment below the prefix is either the extDict of the window, or
+     * the content of the attached dictionary, whose indexes are offset by
+     * (prefixStart - dictEnd) : dictBase is then virtual, only ever added
+     * indexes below dictLimit. */
+    const ZSTD1_matchState_t* const dms = ms->dictMatchState;
+    const U32 dictIndexDelta = dictMode == ZSTD1_dictMatchState ?
+                               dictLimit - (U32)(dms->window.nextSrc - dms->window.base) : 0;
+    const U32 lowestIndex = dictMode == ZSTD1_dictMatchState ?
+                            dms->window.dictLimit + dictIndexDelta : ms->window.lowLimit;
+    const BYTE* const dictBase = dictMode == ZSTD1_dictMatchState ?
+                                 dms->window.base - dictIndexDelta : ms->window.dictBase;
     const BYTE* const dictEnd  = dictBase + dictLimit;
     const BYTE* const dictStart  = dictBase + lowestIndex;
 
     typedef size_t (*searchMax_f)(
                         ZSTD1_matchState_t* ms, ZSTD1_compressionParameters const* cParams,
                         const BYTE* ip, const BYTE* iLimit, size_t* offsetPtr);
-    searchMax_f searchMax = searchMethod ? ZSTD1_BtFindBestMatch_selectMLS_extDict : ZSTD1_HcFindBestMatch_extDict_selectMLS;
+    searchMax_f searchMax = searchMethod ? ZSTD1_BtFindBestMatch_selectMLS_extDict :
+                            dictMode == ZSTD1_dictMatchState ? ZSTD1_HcFindBestMatch_dictMatchState_selectMLS :
+                            ZSTD1_HcFindBestMatch_extDict_selectMLS;
 
-    U32 offset_1 = rep[0], offset_2 = rep[1];
+    U32 offset_1 = rep[0], offset_2 = rep[1], savedOffset=0;
+
+    assert(dictMode == ZSTD1_extDict || dictMode == ZSTD1_dictMatchState);
+    assert(dictMode == ZSTD1_extDict || !searchMethod);
 
     /* init */
     ms->nextToUpdate3 = ms->nextToUpdate;
-    ip += (ip == prefixStart);
+    if (dictMode == ZSTD1_dictMatchState) {
+        /* an attached dictionary is searchable from the first position */
+        ip += (ip == prefixStart) & (dictEnd == dictStart);
+    } else {
+        ip += (ip == prefixStart);
+    }
+    if (dictMode == ZSTD1_dictMatchState) {
+        /* reps of the dictionary may reach before its start */
+        U32 const maxRep = (U32)(ip - prefixStart) + (U32)(dictEnd - dictStart);
+        if (offset_2 > maxRep) savedOffset = offset_2, offset_2 = 0;
+        if (offset_1 > maxRep) savedOffset = offset_1, offset_1 = 0;
+    }
 
     /* Match Loop */
     while (ip < ilimit) {
@@ -665,7 +740,7 @@ size_t ZSTD1_compressBlock_lazy_extDict_generic(
         {   const U32 repIndex = (U32)(current+1 - offset_1);
             const BYTE* const repBase = repIndex < dictLimit ? dictBase : base;
             const BYTE* const repMatch = repBase + repIndex;
-            if (((U32)((dictLimit-1) - repIndex) >= 3) & (repIndex > lowestIndex))   /* intentional overflow */
+            if ((offset_1 > 0) & ((U32)((dictLimit-1) - repIndex) >= 3) & (repIndex > lowestIndex))   /* intentional overflow */
             if (MEM_read32(ip+1) == MEM_read32(repMatch)) {
                 /* repcode detected we should take it */
                 const BYTE* const repEnd = repIndex < dictLimit ? dictEnd : iend;
@@ -695,7 +770,7 @@ size_t ZSTD1_compressBlock_lazy_extDict_generic(
                 const U32 repIndex = (U32)(current - offset_1);
                 const BYTE* const repBase = repIndex < dictLimit ? dictBase : base;
                 const BYTE* const repMatch = repBase + repIndex;
-                if (((U32)((dictLimit-1) - repIndex) >= 3) & (repIndex > lowestIndex))  /* intentional overflow */
+                if ((offset_1 > 0) & ((U32)((dictLimit-1) - repIndex) >= 3) & (repIndex > lowestIndex))  /* intentional overflow */
                 if (MEM_read32(ip) == MEM_read32(repMatch)) {
                     /* repcode detected */
                     const BYTE* const repEnd = repIndex < dictLimit ? dictEnd : iend;
@@ -725,7 +800,7 @@ size_t ZSTD1_compressBlock_lazy_extDict_generic(
                     const U32 repIndex = (U32)(current - offset_1);
                     const BYTE* const repBase = repIndex < dictLimit ? dictBase : base;
                     const BYTE* const repMatch = repBase + repIndex;
-                    if (((U32)((dictLimit-1) - repIndex) >= 3) & (repIndex > lowestIndex))  /* intentional overflow */
+                    if ((offset_1 > 0) & ((U32)((dictLimit-1) - repIndex) >= 3) & (repIndex > lowestIndex))  /* intentional overflow */
                     if (MEM_read32(ip) == MEM_read32(repMatch)) {
                         /* repcode detected */
                         const BYTE* const repEnd = repIndex < dictLimit ? dictEnd : iend;
@@ -769,7 +844,7 @@ _storeSequence:
             const U32 repIndex = (U32)((ip-base) - offset_2);
             const BYTE* const repBase = repIndex < dictLimit ? dictBase : base;
             const BYTE* const repMatch = repBase + repIndex;
-            if (((U32)((dictLimit-1) - repIndex) >= 3) & (repIndex > lowestIndex))  /* intentional overflow */
+            if ((offset_2 > 0) & ((U32)((dictLimit-1) - repIndex) >= 3) & (repIndex > lowestIndex))  /* intentional overflow */
             if (MEM_read32(ip) == MEM_read32(repMatch)) {
                 /* repcode detected we should take it */
                 const BYTE* const repEnd = repIndex < dictLimit ? dictEnd : iend;
@@ -784,19 +859,41 @@ _storeSequence:
     }   }
 
     /* Save reps for next block */
-    rep[0] = offset_1;
-    rep[1] = offset_2;
+    rep[0] = offset_1 ? offset_1 : savedOffset;
+    rep[1] = offset_2 ? offset_2 : savedOffset;
 
     /* Return the last literals size */
     return iend - anchor;
 }
 
 
+size_t ZSTD1_compressBlock_greedy_dictMatchState(
+        ZSTD1_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD1_REP_NUM],
+        ZSTD1_compressionParameters const* cParams, void const* src, size_t srcSize)
+{
+    return ZSTD1_compressBlock_lazy_2segments_generic(ms, seqStore, rep, cParams, src, srcSize, 0, 0, ZSTD1_dictMatchState);
+}
+
+size_t ZSTD1_compressBlock_lazy_dictMatchState(
+        ZSTD1_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD1_REP_NUM],
+        ZSTD1_compressionParameters const* cParams, void const* src, size_t srcSize)
+{
+    return ZSTD1_compressBlock_lazy_2segments_generic(ms, seqStore, rep, cParams, src, srcSize, 0, 1, ZSTD1_dictMatchState);
+}
+
+size_t ZSTD1_compressBlock_lazy2_dictMatchState(
+        ZSTD1_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD1_REP_NUM],
+        ZSTD1_compressionParameters const* cParams, void const* src, size_t srcSize)
+{
+    return ZSTD1_compressBlock_lazy_2segments_generic(ms, seqStore, rep, cParams, src, srcSize, 0, 2, ZSTD1_dictMatchState);
+}
+
+
 size_t ZSTD1_compressBlock_greedy_extDict(
         ZSTD1_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD1_REP_NUM],
         ZSTD1_compressionParameters const* cParams, void const* src, size_t srcSize)
 {
-    return ZSTD1_compressBlock_lazy_extDict_generic(ms, seqStore, rep, cParams, src, srcSize, 0, 0);
+    return ZSTD1_compressBlock_lazy_2segments_generic(ms, seqStore, rep, cParams, src, srcSize, 0, 0, ZSTD1_extDict);
 }
 
 size_t ZSTD1_compressBlock_lazy_extDict(
@@ -804,7 +901,7 @@ size_t ZSTD1_compressBlock_lazy_extDict(
         ZSTD1_compressionParameters const* cParams, void const* src, size_t srcSize)
 
 {
-    return ZSTD1_compressBlock_lazy_extDict_generic(ms, seqStore, rep, cParams, src, srcSize, 0, 1);
+    return ZSTD1_compressBlock_lazy_2segments_generic(ms, seqStore, rep, cParams, src, srcSize, 0, 1, ZSTD1_extDict);
 }
 
 size_t ZSTD1_compressBlock_lazy2_extDict(
@@ -812,7 +909,7 @@ size_t ZSTD1_compressBlock_lazy2_extDict(
         ZSTD1_compressionParameters const* cParams, void const* src, size_t srcSize)
 
 {
-    return ZSTD1_compressBlock_lazy_extDict_generic(ms, seqStore, rep, cParams, src, srcSize, 0, 2);
+    return ZSTD1_compressBlock_lazy_2segments_generic(ms, seqStore, rep, cParams, src, srcSize, 0, 2, ZSTD1_extDict);
 }
 
 size_t ZSTD1_compressBlock_btlazy2_extDict(
@@ -820,5 +917,5 @@ size_t ZSTD1_compressBlock_btlazy2_extDict(
         ZSTD1_compressionParameters const* cParams, void const* src, size_t srcSize)
 
 {
-    return ZSTD1_compressBlock_lazy_extDict_generic(ms, seqStore, rep, cParams, src, srcSize, 1, 2);
+    return ZSTD1_compressBlock_lazy_2segments_generic(ms, seqStore, rep, cParams, src, srcSize, 1, 2, ZSTD1_extDict);
 }
@@ -592,11 +592,11 @@ static rawSeq maybeSplitSequence(rawSeqStore_t* rawSeqStore,
 size_t ZSTD1_ldm_blockCompress(rawSeqStore_t* rawSeqStore,
     ZSTD1_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD1_REP_NUM],
     ZSTD1_compressionParameters const* cParams, void const* src, size_t srcSize,
-    int const extDict)
+    ZSTD1_dictMode_e const dictMode)
 {
     unsigned const minMatch = cParams->searchLength;
     ZSTD1_blockCompressor const blockCompressor =
-        ZSTD1_selectBlockCompressor(cParams->strategy, extDict);
+        ZSTD1_selectBlockCompressor(cParams->strategy, dictMode);
     BYTE const* const base = ms->window.base;
     /* Input bounds */
     BYTE const* const istart = (BYTE const*)src;
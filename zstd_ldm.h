@@ -63,7 +63,7 @@ size_t ZSTD1_ldm_blockCompress(rawSeqStore_t* rawSeqStore,
             ZSTD1_matchState_t* ms, seqStore_t* seqStore, U32 rep[ZSTD1_REP_NUM],
             ZSTD1_compressionParameters const* cParams,
             void const* src, size_t srcSize,
-            int const extDict);
+            ZSTD1_dictMode_e const dictMode);
 
 /**
  * ZSTD1_ldm_skipSequences():
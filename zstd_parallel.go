@@ -0,0 +1,422 @@
+package zstd1
+
+/*
+#define ZSTD1_STATIC_LINKING_ONLY
+#include "zstd.h"
+#include "zstdmt_compress.h"
+#include "stdint.h"  // for uintptr_t
+
+// See zstd_ctx.go for why these *_wrapper functions take uintptr_t.
+
+static size_t ZSTDMT_compressCCtx_wrapper(ZSTDMT_CCtx* mtctx, uintptr_t dst, size_t maxDstSize, const uintptr_t src, size_t srcSize, int compressionLevel) {
+	return ZSTDMT_compressCCtx(mtctx, (void*)dst, maxDstSize, (const void*)src, srcSize, compressionLevel);
+}
+*/
+import "C"
+import (
+	"errors"
+	"fmt"
+	"io"
+	"runtime"
+	"sync"
+	"unsafe"
+)
+
+// maxWorkers mirrors ZSTDMT_NBWORKERS_MAX
+const maxWorkers = 200
+
+var (
+	errIncompleteFrame = errors.New("incomplete frame")
+	errReaderClosed    = errors.New("reader is closed")
+)
+
+func normalizeWorkers(workers int) int {
+	if workers <= 0 {
+		workers = runtime.NumCPU()
+	}
+	if workers > maxWorkers {
+		workers = maxWorkers
+	}
+	return workers
+}
+
+// mtCtx owns a ZSTDMT_CCtx and its worker threads.  Contexts are pooled per
+// number of workers, as creating one starts its thread pool.
+type mtCtx struct {
+	mtctx   *C.ZSTDMT_CCtx
+	workers int
+}
+
+var mtCtxPools sync.Map // int -> *sync.Pool of *mtCtx
+
+func getMTCtx(workers int) *mtCtx {
+	p, ok := mtCtxPools.Load(workers)
+	if !ok {
+		p, _ = mtCtxPools.LoadOrStore(workers, &sync.Pool{})
+	}
+	if m, _ := p.(*sync.Pool).Get().(*mtCtx); m != nil {
+		return m
+	}
+	m := &mtCtx{mtctx: C.ZSTDMT_createCCtx(C.uint(workers)), workers: workers}
+	if m.mtctx == nil {
+		return nil
+	}
+	runtime.SetFinalizer(m, (*mtCtx).free)
+	return m
+}
+
+func putMTCtx(m *mtCtx) {
+	if p, ok := mtCtxPools.Load(m.workers); ok {
+		p.(*sync.Pool).Put(m)
+	}
+}
+
+func (m *mtCtx) free() {
+	C.ZSTDMT_freeCCtx(m.mtctx)
+	m.mtctx = nil
+}
+
+// CompressParallel compresses src into dst like CompressLevel, but splits the
+// work between the given number of threads.  The result is a single standard
+// frame.  Inputs smaller than a job (1 MB) gain nothing from extra workers.
+// A workers value of 0 or less uses one worker per CPU.
+func CompressParallel(dst, src []byte, level int, workers int) ([]byte, error) {
+	if len(src) == 0 {
+		return []byte{}, ErrEmptySlice
+	}
+	if err := checkLevel(level); err != nil {
+		return nil, err
+	}
+	workers = normalizeWorkers(workers)
+	bound := CompressBound(len(src))
+	if cap(dst) >= bound {
+		dst = dst[0:bound] // Reuse dst buffer
+	} else {
+		dst = make([]byte, bound)
+	}
+
+	m := getMTCtx(workers)
+	if m == nil {
+		return nil, ErrContextAllocation
+	}
+	defer putMTCtx(m)
+	cWritten := C.ZSTDMT_compressCCtx_wrapper(
+		m.mtctx,
+		C.uintptr_t(uintptr(unsafe.Pointer(&dst[0]))),
+		C.size_t(len(dst)),
+		C.uintptr_t(uintptr(unsafe.Pointer(&src[0]))),
+		C.size_t(len(src)),
+		C.int(level))
+	runtime.KeepAlive(m)
+	runtime.KeepAlive(src)
+
+	written := int(cWritten)
+	// Check if the return is an Error code
+	if err := getError(written); err != nil {
+		return nil, err
+	}
+	return dst[:written], nil
+}
+
+// frameCompressedSize returns the size of the frame, zstd or skippable, at the
+// start of src.  It returns errIncompleteFrame if src ends before the frame.
+func frameCompressedSize(src []byte) (int, error) {
+	if len(src) == 0 {
+		return 0, errIncompleteFrame
+	}
+	size := int(C.ZSTD1_findFrameCompressedSize(unsafe.Pointer(&src[0]), C.size_t(len(src))))
+	if err := getError(size); err != nil {
+		if isSrcSizeWrongError(err) {
+			return 0, errIncompleteFrame
+		}
+		return 0, err
+	}
+	if size > len(src) { // skippable frame headers are not checked against srcSize
+		return 0, errIncompleteFrame
+	}
+	return size, nil
+}
+
+// frameContentSize returns the decompressed size declared by the frame at the
+// start of src, or -1 if it is not declared.
+func frameContentSize(src []byte) int {
+	size := uint64(C.ZSTD1_getFrameContentSize(unsafe.Pointer(&src[0]), C.size_t(len(src))))
+	if size == C.ZSTD1_CONTENTSIZE_UNKNOWN || size == C.ZSTD1_CONTENTSIZE_ERROR ||
+		size > uint64(len(src))*maxCompressionRatio {
+		return -1
+	}
+	return int(size)
+}
+
+// DecompressParallel decompresses src, which may hold several concatenated
+// frames, decoding independent frames concurrently on the given number of
+// goroutines.  Output written by CompressParallel or NewWriterParallel is a
+// single frame and is not split any further; inputs built from many frames,
+// such as a stream of CompressLevel outputs or the seekable format, are.
+// When every frame declares its content size, frames are decoded straight into
+// their final position in dst.  Buffer handling is otherwise the same as for
+// Decompress.  A workers value of 0 or less uses one worker per CPU.
+func DecompressParallel(dst, src []byte, workers int) ([]byte, error) {
+	if len(src) == 0 {
+		return []byte{}, ErrEmptySlice
+	}
+	workers = normalizeWorkers(workers)
+
+	// Locate frames and the offset of their output
+	type frame struct {
+		src     []byte
+		offset  int
+		size    int
+		decoded []byte
+		err     error
+	}
+	var frames []frame
+	total, sized := 0, true
+	for off := 0; off < len(src); {
+		n, err := frameCompressedSize(src[off:])
+		if err == errIncompleteFrame {
+			return nil, io.ErrUnexpectedEOF
+		} else if err != nil {
+			return nil, err
+		}
+		f := frame{src: src[off : off+n], offset: total, size: frameContentSize(src[off : off+n])}
+		if f.size < 0 {
+			sized = false
+		} else {
+			total += f.size
+		}
+		frames = append(frames, f)
+		off += n
+	}
+	if len(frames) == 1 || workers == 1 {
+		return Decompress(dst, src)
+	}
+
+	if sized {
+		if cap(dst) >= total {
+			dst = dst[:total]
+		} else {
+			dst = make([]byte, total)
+		}
+	}
+
+	next := make(chan int, len(frames))
+	for i := range frames {
+		next <- i
+	}
+	close(next)
+	if workers > len(frames) {
+		workers = len(frames)
+	}
+	var wg sync.WaitGroup
+	for w := 0; w < workers; w++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			d, err := getDecompressCtx()
+			if err != nil {
+				for i := range next {
+					frames[i].err = err
+				}
+				return
+			}
+			defer putDecompressCtx(d)
+			for i := range next {
+				f := &frames[i]
+				var out []byte
+				if sized {
+					out = dst[f.offset : f.offset : f.offset+f.size]
+				}
+				f.decoded, f.err = d.Decompress(out, f.src)
+			}
+		}()
+	}
+	wg.Wait()
+
+	for i := range frames {
+		if frames[i].err != nil {
+			return nil, frames[i].err
+		}
+	}
+	if sized {
+		return dst, nil
+	}
+	// Frame sizes were only known after decoding, assemble the output
+	dst = dst[:0]
+	for i := range frames {
+		dst = append(dst, frames[i].decoded...)
+	}
+	return dst, nil
+}
+
+// parallelJob is a frame being decoded by a parallelReader worker.
+type parallelJob struct {
+	src  []byte
+	out  []byte
+	err  error
+	done chan struct{}
+}
+
+// parallelReader decodes the frames of its input concurrently, keeping a
+// bounded number of frames in flight and returning their output in order.
+type parallelReader struct {
+	underlyingReader io.Reader
+	pending          chan *parallelJob // jobs in stream order
+	work             chan *parallelJob // jobs waiting for a worker
+	quit             chan struct{}
+	current          *parallelJob
+	off              int
+	err              error
+	closeOnce        sync.Once
+}
+
+// NewReaderParallel is like NewReader but decodes up to workers frames of the
+// input concurrently, while Read still returns the output in order.  The input
+// is cut at frame boundaries, so it only helps with inputs made of several
+// frames, and each frame is buffered in full before it is decoded.  It is the
+// caller's responsibility to call Close, which stops the workers.  A workers
+// value of 0 or less uses one worker per CPU.
+func NewReaderParallel(r io.Reader, workers int) io.ReadCloser {
+	workers = normalizeWorkers(workers)
+	pr := &parallelReader{
+		underlyingReader: r,
+		pending:          make(chan *parallelJob, workers),
+		work:             make(chan *parallelJob, workers),
+		quit:             make(chan struct{}),
+	}
+	for i := 0; i < workers; i++ {
+		go pr.decodeFrames()
+	}
+	go pr.splitFrames()
+	return pr
+}
+
+// splitFrames reads the underlying reader, cuts it into frames and queues
+// them, in order, for decoding.
+func (r *parallelReader) splitFrames() {
+	defer close(r.work)
+	defer close(r.pending)
+
+	minRead := int(C.ZSTD1_DStreamInSize())
+	buf := make([]byte, 0, minRead)
+	start, eof := 0, false
+	for {
+		size, err := frameCompressedSize(buf[start:])
+		if err == errIncompleteFrame {
+			if eof {
+				if start < len(buf) {
+					r.queue(&parallelJob{err: io.ErrUnexpectedEOF})
+				}
+				return
+			}
+			// Move the partial frame to the front, and read at least as much
+			// as is buffered so that scanning a large frame again after each
+			// read stays linear overall
+			buf = buf[:copy(buf, buf[start:])]
+			start = 0
+			if free := cap(buf) - len(buf); free < minRead || free < len(buf) {
+				grown := make([]byte, len(buf), 2*cap(buf)+minRead)
+				copy(grown, buf)
+				buf = grown
+			}
+			n, rerr := r.underlyingReader.Read(buf[len(buf):cap(buf)])
+			buf = buf[:len(buf)+n]
+			if rerr == io.EOF {
+				eof = true
+			} else if rerr != nil {
+				r.queue(&parallelJob{err: fmt.Errorf("failed to read from underlying reader: %s", rerr)})
+				return
+			}
+			continue
+		} else if err != nil {
+			r.queue(&parallelJob{err: fmt.Errorf("failed to decompress: %s", err)})
+			return
+		}
+
+		job := &parallelJob{src: make([]byte, size), done: make(chan struct{})}
+		copy(job.src, buf[start:start+size])
+		start += size
+		if !r.queue(job) {
+			return
+		}
+		select {
+		case r.work <- job:
+		case <-r.quit:
+			return
+		}
+	}
+}
+
+// queue appends job to the ordered output queue, returning false once the
+// reader is closed.
+func (r *parallelReader) queue(job *parallelJob) bool {
+	if job.done == nil {
+		job.done = make(chan struct{})
+		close(job.done)
+	}
+	select {
+	case r.pending <- job:
+		return true
+	case <-r.quit:
+		return false
+	}
+}
+
+func (r *parallelReader) decodeFrames() {
+	d, err := getDecompressCtx()
+	if err != nil {
+		for job := range r.work {
+			job.err = err
+			close(job.done)
+		}
+		return
+	}
+	defer putDecompressCtx(d)
+	for job := range r.work {
+		job.out, job.err = d.Decompress(nil, job.src)
+		close(job.done)
+	}
+}
+
+func (r *parallelReader) Read(p []byte) (int, error) {
+	got := 0
+	for got < len(p) && r.err == nil {
+		if r.current == nil || r.off == len(r.current.out) {
+			if got > 0 {
+				// Do not wait for the next frame when there is data to return
+				break
+			}
+			job, ok := <-r.pending
+			if !ok {
+				r.err = io.EOF
+				break
+			}
+			<-job.done
+			if job.err != nil {
+				r.err = job.err
+				break
+			}
+			r.current, r.off = job, 0
+			continue
+		}
+		n := copy(p[got:], r.current.out[r.off:])
+		r.off += n
+		got += n
+	}
+	if got > 0 {
+		return got, nil
+	}
+	return 0, r.err
+}
+
+// Close stops decoding and releases the buffered frames.  It does not close
+// the underlying reader, and a Read of the underlying reader in progress
+// completes in the background.
+func (r *parallelReader) Close() error {
+	r.closeOnce.Do(func() {
+		close(r.quit)
+		r.current = nil
+		r.err = errReaderClosed
+	})
+	return nil
+}
@@ -0,0 +1,207 @@
+package zstd1
+
+import (
+	"bytes"
+	"fmt"
+	"io"
+	"io/ioutil"
+	"runtime"
+	"testing"
+	"testing/iotest"
+)
+
+func TestCompressParallel(t *testing.T) {
+	payload := makePayload(5 << 20)
+	for _, workers := range []int{0, 1, 4} {
+		compressed, err := CompressParallel(nil, payload, DefaultCompression, workers)
+		failOnError(t, "Failed to compress", err)
+		decompressed, err := Decompress(nil, compressed)
+		failOnError(t, "Failed to decompress", err)
+		if !bytes.Equal(payload, decompressed) {
+			t.Fatalf("Payload did not match for %v workers", workers)
+		}
+	}
+	if _, err := CompressParallel(nil, nil, DefaultCompression, 2); err != ErrEmptySlice {
+		t.Fatalf("Did not get the correct error: %s", err)
+	}
+}
+
+func TestStreamParallel(t *testing.T) {
+	payload := makePayload(5 << 20)
+	var buf bytes.Buffer
+	w := NewWriterParallel(&buf, DefaultCompression, 4)
+	for off := 0; off < len(payload); off += 100 << 10 {
+		end := off + 100<<10
+		if end > len(payload) {
+			end = len(payload)
+		}
+		_, err := w.Write(payload[off:end])
+		failOnError(t, "Failed writing to compress object", err)
+	}
+	failOnError(t, "Failed to flush compress object", w.Flush())
+	failOnError(t, "Failed to close compress object", w.Close())
+
+	r := NewReader(&buf)
+	decompressed, err := ioutil.ReadAll(r)
+	failOnError(t, "Failed to decompress", err)
+	failOnError(t, "Failed to close decompress object", r.Close())
+	if !bytes.Equal(payload, decompressed) {
+		t.Fatalf("Payload did not match, lengths: %v & %v", len(payload), len(decompressed))
+	}
+}
+
+func BenchmarkCompressParallel(b *testing.B) {
+	payload := makePayload(32 << 20)
+	dst := make([]byte, CompressBound(len(payload)))
+	b.Run("CompressLevel", func(b *testing.B) {
+		b.SetBytes(int64(len(payload)))
+		for i := 0; i < b.N; i++ {
+			if _, err := CompressLevel(dst, payload, DefaultCompression); err != nil {
+				b.Fatalf("Failed compressing: %s", err)
+			}
+		}
+	})
+	for _, workers := range []int{1, 2, 4, runtime.NumCPU()} {
+		b.Run(fmt.Sprintf("Workers/%d", workers), func(b *testing.B) {
+			b.SetBytes(int64(len(payload)))
+			for i := 0; i < b.N; i++ {
+				if _, err := CompressParallel(dst, payload, DefaultCompression, workers); err != nil {
+					b.Fatalf("Failed compressing: %s", err)
+				}
+			}
+		})
+	}
+}
+
+// makeFrames returns payload compressed as independent frames of frameSize
+// bytes, as CompressLevel outputs, or as stream frames without a content size.
+func makeFrames(t testing.TB, payload []byte, frameSize int, sized bool) []byte {
+	var out []byte
+	for off := 0; off < len(payload); off += frameSize {
+		end := off + frameSize
+		if end > len(payload) {
+			end = len(payload)
+		}
+		if sized {
+			compressed, err := Compress(nil, payload[off:end])
+			if err != nil {
+				t.Fatalf("Failed to compress: %s", err)
+			}
+			out = append(out, compressed...)
+			continue
+		}
+		var buf bytes.Buffer
+		w := NewWriter(&buf)
+		w.Write(payload[off:end])
+		if err := w.Close(); err != nil {
+			t.Fatalf("Failed to close compress object: %s", err)
+		}
+		out = append(out, buf.Bytes()...)
+	}
+	return out
+}
+
+func TestDecompressParallel(t *testing.T) {
+	payload := makePayload(3 << 20)
+	for _, sized := range []bool{true, false} {
+		compressed := makeFrames(t, payload, 100<<10, sized)
+		for _, workers := range []int{0, 1, 3} {
+			decompressed, err := DecompressParallel(nil, compressed, workers)
+			failOnError(t, "Failed to decompress", err)
+			if !bytes.Equal(payload, decompressed) {
+				t.Fatalf("Payload did not match for %v workers (sized: %v)", workers, sized)
+			}
+		}
+		// A large enough dst is reused
+		dst := make([]byte, len(payload))
+		decompressed, err := DecompressParallel(dst, compressed, 4)
+		failOnError(t, "Failed to decompress", err)
+		if sized && &decompressed[0] != &dst[0] {
+			t.Fatalf("dst was not reused")
+		}
+		if !bytes.Equal(payload, decompressed) {
+			t.Fatalf("Payload did not match (sized: %v)", sized)
+		}
+		if _, err := DecompressParallel(nil, compressed[:len(compressed)-1], 4); err != io.ErrUnexpectedEOF {
+			t.Fatalf("Did not get the correct error on truncated input: %s", err)
+		}
+	}
+	if _, err := DecompressParallel(nil, nil, 2); err != ErrEmptySlice {
+		t.Fatalf("Did not get the correct error: %s", err)
+	}
+}
+
+func TestReaderParallel(t *testing.T) {
+	payload := makePayload(3 << 20)
+	// Skippable frames, such as seek tables, produce no output
+	skippable := []byte{0x50, 0x2a, 0x4d, 0x18, 4, 0, 0, 0, 1, 2, 3, 4}
+	for _, sized := range []bool{true, false} {
+		compressed := makeFrames(t, payload, 100<<10, sized)
+		compressed = append(compressed, skippable...)
+		for _, workers := range []int{0, 1, 3} {
+			r := NewReaderParallel(iotest.HalfReader(bytes.NewReader(compressed)), workers)
+			decompressed, err := ioutil.ReadAll(r)
+			failOnError(t, "Failed to decompress", err)
+			failOnError(t, "Failed to close decompress object", r.Close())
+			if !bytes.Equal(payload, decompressed) {
+				t.Fatalf("Payload did not match for %v workers (sized: %v), lengths: %v & %v",
+					workers, sized, len(payload), len(decompressed))
+			}
+		}
+	}
+}
+
+func TestReaderParallelTruncated(t *testing.T) {
+	compressed := makeFrames(t, makePayload(1<<20), 100<<10, true)
+	r := NewReaderParallel(bytes.NewReader(compressed[:len(compressed)-10]), 4)
+	defer r.Close()
+	if _, err := ioutil.ReadAll(r); err != io.ErrUnexpectedEOF {
+		t.Fatalf("Did not get the correct error: %s", err)
+	}
+}
+
+func TestReaderParallelCloseEarly(t *testing.T) {
+	compressed := makeFrames(t, makePayload(4<<20), 64<<10, true)
+	r := NewReaderParallel(bytes.NewReader(compressed), 2)
+	buf := make([]byte, 1000)
+	_, err := io.ReadFull(r, buf)
+	failOnError(t, "Failed to decompress", err)
+	failOnError(t, "Failed to close decompress object", r.Close())
+	if _, err := r.Read(buf); err == nil {
+		t.Fatalf("Read after Close should fail")
+	}
+}
+
+func BenchmarkDecompressParallel(b *testing.B) {
+	payload := makePayload(32 << 20)
+	compressed := makeFrames(b, payload, 1<<20, true)
+	dst := make([]byte, len(payload))
+	b.Run("Decompress", func(b *testing.B) {
+		b.SetBytes(int64(len(payload)))
+		for i := 0; i < b.N; i++ {
+			if _, err := Decompress(dst, compressed); err != nil {
+				b.Fatalf("Failed decompressing: %s", err)
+			}
+		}
+	})
+	for _, workers := range []int{1, 2, 4, runtime.NumCPU()} {
+		b.Run(fmt.Sprintf("Workers/%d", workers), func(b *testing.B) {
+			b.SetBytes(int64(len(payload)))
+			for i := 0; i < b.N; i++ {
+				if _, err := DecompressParallel(dst, compressed, workers); err != nil {
+					b.Fatalf("Failed decompressing: %s", err)
+				}
+			}
+		})
+		b.Run(fmt.Sprintf("Reader/%d", workers), func(b *testing.B) {
+			b.SetBytes(int64(len(payload)))
+			for i := 0; i < b.N; i++ {
+				r := NewReaderParallel(bytes.NewReader(compressed), workers)
+				if _, err := io.Copy(ioutil.Discard, r); err != nil {
+					b.Fatalf("Failed decompressing: %s", err)
+				}
+				r.Close()
+			}
+		})
+	}
+}
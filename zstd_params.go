@@ -0,0 +1,316 @@
+package zstd1
+
+/*
+#define ZSTD1_STATIC_LINKING_ONLY
+#include "zstd.h"
+#include "zstd_errors.h"
+#include "stdint.h"  // for uintptr_t
+
+// See zstd_ctx.go for why these *_wrapper functions take uintptr_t.
+
+// Advanced parameters as passed from Go.  Fields left to 0 use the value
+// derived from the level.
+typedef struct compress_params_s {
+	int level;
+	ZSTD1_compressionParameters cParams;
+	unsigned checksum;
+	unsigned enableLdm;
+	unsigned ldmHashLog;
+	unsigned ldmMinMatch;
+	unsigned ldmBucketSizeLog;
+	unsigned ldmHashEveryLog;
+} compress_params;
+
+// Mirrors the checks of ZSTD1_CCtx_setParameter for long distance matching
+static size_t ZSTD1_checkLdmParams(compress_params p) {
+	if (p.ldmHashLog && (p.ldmHashLog < ZSTD1_HASHLOG_MIN || p.ldmHashLog > ZSTD1_HASHLOG_MAX))
+		return (size_t)-ZSTD1_error_parameter_outOfBound;
+	if (p.ldmMinMatch && (p.ldmMinMatch < ZSTD1_LDM_MINMATCH_MIN || p.ldmMinMatch > ZSTD1_LDM_MINMATCH_MAX))
+		return (size_t)-ZSTD1_error_parameter_outOfBound;
+	if (p.ldmBucketSizeLog > ZSTD1_LDM_BUCKETSIZELOG_MAX)
+		return (size_t)-ZSTD1_error_parameter_outOfBound;
+	if (p.ldmHashEveryLog > ZSTD1_WINDOWLOG_MAX - ZSTD1_HASHLOG_MIN)
+		return (size_t)-ZSTD1_error_parameter_outOfBound;
+	return 0;
+}
+
+static size_t ZSTD1_checkParams_wrapper(compress_params p) {
+	ZSTD1_compressionParameters resolved = ZSTD1_getCParams(p.level, 0, 0);
+	size_t err;
+	if (p.cParams.windowLog) resolved.windowLog = p.cParams.windowLog;
+	if (p.cParams.hashLog) resolved.hashLog = p.cParams.hashLog;
+	if (p.cParams.chainLog) resolved.chainLog = p.cParams.chainLog;
+	if (p.cParams.searchLog) resolved.searchLog = p.cParams.searchLog;
+	if (p.cParams.searchLength) resolved.searchLength = p.cParams.searchLength;
+	if (p.cParams.targetLength) resolved.targetLength = p.cParams.targetLength;
+	if (p.cParams.strategy) resolved.strategy = p.cParams.strategy;
+	err = ZSTD1_checkCParams(resolved);
+	if (ZSTD1_isError(err)) return err;
+	return ZSTD1_checkLdmParams(p);
+}
+
+// Sets every parameter, so that values left over from a previous use of
+// cctx are reset to their defaults
+static size_t ZSTD1_CCtx_setParams_wrapper(ZSTD1_CCtx* cctx, compress_params p) {
+	size_t err = ZSTD1_checkParams_wrapper(p);
+	if (p.level == 0) p.level = 3;  // ZSTD1_CLEVEL_DEFAULT, 0 would keep the previous level
+#define SET_PARAMETER(param, value) \
+	if (!ZSTD1_isError(err)) err = ZSTD1_CCtx_setParameter(cctx, param, value);
+	SET_PARAMETER(ZSTD1_p_compressionLevel, (unsigned)p.level)
+	SET_PARAMETER(ZSTD1_p_windowLog, p.cParams.windowLog)
+	SET_PARAMETER(ZSTD1_p_hashLog, p.cParams.hashLog)
+	SET_PARAMETER(ZSTD1_p_chainLog, p.cParams.chainLog)
+	SET_PARAMETER(ZSTD1_p_searchLog, p.cParams.searchLog)
+	SET_PARAMETER(ZSTD1_p_minMatch, p.cParams.searchLength)
+	SET_PARAMETER(ZSTD1_p_targetLength, p.cParams.targetLength)
+	SET_PARAMETER(ZSTD1_p_compressionStrategy, (unsigned)p.cParams.strategy)
+	SET_PARAMETER(ZSTD1_p_checksumFlag, p.checksum)
+	SET_PARAMETER(ZSTD1_p_enableLongDistanceMatching, p.enableLdm)
+	SET_PARAMETER(ZSTD1_p_ldmHashLog, p.ldmHashLog)
+	SET_PARAMETER(ZSTD1_p_ldmMinMatch, p.ldmMinMatch)
+	SET_PARAMETER(ZSTD1_p_ldmBucketSizeLog, p.ldmBucketSizeLog)
+	SET_PARAMETER(ZSTD1_p_ldmHashEveryLog, p.ldmHashEveryLog)
+#undef SET_PARAMETER
+	return ZSTD1_isError(err) ? err : 0;
+}
+
+// Restores the parameters of a new context.  ZSTD1_CCtx_reset keeps them,
+// and ZSTD1_compressCCtx and ZSTD1_compress_usingDict inherit them, so a
+// context must not leave ZSTD1_compressParams_wrapper with long distance
+// matching or another override still set.
+static void ZSTD1_CCtx_resetParams_wrapper(ZSTD1_CCtx* cctx) {
+	compress_params defaults = { 0 };
+	ZSTD1_CCtx_reset(cctx);
+	ZSTD1_CCtx_setParams_wrapper(cctx, defaults);  // cannot fail once reset
+}
+
+static size_t ZSTD1_compressParams_wrapper(ZSTD1_CCtx* cctx, uintptr_t dst, size_t maxDstSize, const uintptr_t src, size_t srcSize, compress_params p) {
+	ZSTD1_outBuffer outBuffer = { (void*)dst, maxDstSize, 0 };
+	ZSTD1_inBuffer inBuffer = { (const void*)src, srcSize, 0 };
+	size_t err;
+	ZSTD1_CCtx_reset(cctx);
+	err = ZSTD1_CCtx_setParams_wrapper(cctx, p);
+	if (!ZSTD1_isError(err)) err = ZSTD1_CCtx_setPledgedSrcSize(cctx, srcSize);
+	if (!ZSTD1_isError(err)) err = ZSTD1_compress_generic(cctx, &outBuffer, &inBuffer, ZSTD1_e_end);
+	ZSTD1_CCtx_resetParams_wrapper(cctx);
+	if (ZSTD1_isError(err)) return err;
+	if (err != 0) return (size_t)-ZSTD1_error_dstSize_tooSmall;  // the frame did not fit in dst
+	return outBuffer.pos;
+}
+*/
+import "C"
+import (
+	"io"
+	"runtime"
+	"unsafe"
+)
+
+// Strategy is the match finding algorithm used by the compressor, from the
+// fastest to the strongest.
+type Strategy int
+
+// Strategies as defined by zstd.h
+const (
+	StrategyFast    Strategy = C.ZSTD1_fast
+	StrategyDfast   Strategy = C.ZSTD1_dfast
+	StrategyGreedy  Strategy = C.ZSTD1_greedy
+	StrategyLazy    Strategy = C.ZSTD1_lazy
+	StrategyLazy2   Strategy = C.ZSTD1_lazy2
+	StrategyBtlazy2 Strategy = C.ZSTD1_btlazy2
+	StrategyBtopt   Strategy = C.ZSTD1_btopt
+	StrategyBtultra Strategy = C.ZSTD1_btultra
+)
+
+// Params are advanced compression parameters.  Level selects the defaults of
+// every other parameter; fields left to 0 keep that default.  See
+// ZSTD1_compressionParameters and ZSTD1_cParameter in zstd.h for the valid
+// range of each field.
+//
+// Lowering HashLog and ChainLog below the defaults of a level reduces the
+// memory of a compression context and its cache misses, often at little cost
+// in ratio.  A WindowLog above 27 requires the decompressor to accept larger
+// windows, see NewReaderWindowLogMax.
+type Params struct {
+	Level int
+
+	// WindowLog is the log2 of the largest match distance
+	WindowLog int
+	// HashLog is the log2 of the number of entries of the hash table
+	HashLog int
+	// ChainLog is the log2 of the size of the match chain or binary tree
+	ChainLog int
+	// SearchLog is the log2 of the number of searches per position
+	SearchLog int
+	// SearchLength is the minimum match length
+	SearchLength int
+	// TargetLength is the match length considered good enough by the
+	// optimal parser, or the match sampling distance of StrategyFast
+	TargetLength int
+	Strategy     Strategy
+
+	// Checksum appends a checksum of the content to every frame
+	Checksum bool
+
+	// LongDistanceMatching finds matches far behind the regular match
+	// finder, for large inputs with repetitions megabytes apart such as
+	// archives of similar files.  It raises the default WindowLog to 27.
+	LongDistanceMatching bool
+	// LDMHashLog is the log2 of the size of the long distance hash table
+	LDMHashLog int
+	// LDMMinMatch is the minimum length of a long distance match
+	LDMMinMatch int
+	// LDMBucketSizeLog is the log2 of the number of entries per hash bucket
+	LDMBucketSizeLog int
+	// LDMHashEveryLog is the log2 of the distance between positions
+	// inserted in the hash table
+	LDMHashEveryLog int
+}
+
+var errParamOutOfBound = ErrorCode(-C.ZSTD1_error_parameter_outOfBound)
+
+// ParamsForLevel returns the parameters zstd uses for level when compressing
+// srcSize bytes, or an input of unknown size if srcSize is 0.  It is a
+// starting point for tuning individual parameters.
+func ParamsForLevel(level int, srcSize int) Params {
+	cParams := C.ZSTD1_getCParams(C.int(level), C.ulonglong(srcSize), 0)
+	return Params{
+		Level:        level,
+		WindowLog:    int(cParams.windowLog),
+		HashLog:      int(cParams.hashLog),
+		ChainLog:     int(cParams.chainLog),
+		SearchLog:    int(cParams.searchLog),
+		SearchLength: int(cParams.searchLength),
+		TargetLength: int(cParams.targetLength),
+		Strategy:     Strategy(cParams.strategy),
+	}
+}
+
+// cParams converts p to the C structure, failing on negative values that
+// would wrap around as unsigned
+func (p Params) cParams() (C.compress_params, error) {
+	if p.WindowLog < 0 || p.HashLog < 0 || p.ChainLog < 0 || p.SearchLog < 0 ||
+		p.SearchLength < 0 || p.TargetLength < 0 || p.Strategy < 0 ||
+		p.LDMHashLog < 0 || p.LDMMinMatch < 0 || p.LDMBucketSizeLog < 0 || p.LDMHashEveryLog < 0 {
+		return C.compress_params{}, errParamOutOfBound
+	}
+	if err := checkLevel(p.Level); err != nil {
+		return C.compress_params{}, err
+	}
+	return C.compress_params{
+		level: C.int(p.Level),
+		cParams: C.ZSTD1_compressionParameters{
+			windowLog:    C.uint(p.WindowLog),
+			hashLog:      C.uint(p.HashLog),
+			chainLog:     C.uint(p.ChainLog),
+			searchLog:    C.uint(p.SearchLog),
+			searchLength: C.uint(p.SearchLength),
+			targetLength: C.uint(p.TargetLength),
+			strategy:     C.ZSTD1_strategy(p.Strategy),
+		},
+		checksum:         cBool(p.Checksum),
+		enableLdm:        cBool(p.LongDistanceMatching),
+		ldmHashLog:       C.uint(p.LDMHashLog),
+		ldmMinMatch:      C.uint(p.LDMMinMatch),
+		ldmBucketSizeLog: C.uint(p.LDMBucketSizeLog),
+		ldmHashEveryLog:  C.uint(p.LDMHashEveryLog),
+	}, nil
+}
+
+func cBool(b bool) C.uint {
+	if b {
+		return 1
+	}
+	return 0
+}
+
+// Validate checks the parameters with ZSTD1_checkCParams, once the fields
+// left to 0 are resolved from the level, and the long distance matching
+// parameters against their bounds.
+func (p Params) Validate() error {
+	cParams, err := p.cParams()
+	if err != nil {
+		return err
+	}
+	return getError(int(C.ZSTD1_checkParams_wrapper(cParams)))
+}
+
+// CompressParams is the same as CompressLevel but compresses with advanced
+// parameters.  The parameters are validated on every call.
+func CompressParams(dst, src []byte, p Params) ([]byte, error) {
+	if len(src) == 0 {
+		return []byte{}, ErrEmptySlice
+	}
+	if !p.levelSized() {
+		// zstd never shrinks a workspace: a context sized for these
+		// parameters must not be handed to later CompressLevel calls
+		c, err := NewCompressCtx()
+		if err != nil {
+			return nil, err
+		}
+		defer c.Close()
+		return c.CompressParams(dst, src, p)
+	}
+	c, err := getCompressCtx(p.Level, len(src))
+	if err != nil {
+		return nil, err
+	}
+	defer putCompressCtx(c)
+	return c.CompressParams(dst, src, p)
+}
+
+// levelSized reports whether p sizes a context as its level alone does, so
+// that the context can go back to the pool of that level.
+func (p Params) levelSized() bool {
+	return p == Params{Level: p.Level, Checksum: p.Checksum}
+}
+
+// CompressParams is the same as CompressLevel but compresses with advanced
+// parameters.
+func (c *CompressCtx) CompressParams(dst, src []byte, p Params) ([]byte, error) {
+	if len(src) == 0 {
+		return []byte{}, ErrEmptySlice
+	}
+	cParams, err := p.cParams()
+	if err != nil {
+		return nil, err
+	}
+	bound := CompressBound(len(src))
+	if cap(dst) >= bound {
+		dst = dst[0:bound] // Reuse dst buffer
+	} else {
+		dst = make([]byte, bound)
+	}
+
+	cWritten := C.ZSTD1_compressParams_wrapper(
+		c.cctx,
+		C.uintptr_t(uintptr(unsafe.Pointer(&dst[0]))),
+		C.size_t(len(dst)),
+		C.uintptr_t(uintptr(unsafe.Pointer(&src[0]))),
+		C.size_t(len(src)),
+		cParams)
+	runtime.KeepAlive(c)
+	runtime.KeepAlive(src)
+
+	written := int(cWritten)
+	// Check if the return is an Error code
+	if err := getError(written); err != nil {
+		return nil, err
+	}
+	return dst[:written], nil
+}
+
+// NewWriterParams is like NewWriterLevel but compresses with advanced
+// parameters.  Invalid parameters are reported by the first Write, Flush or
+// Close.
+func NewWriterParams(w io.Writer, p Params) *Writer {
+	return newWriter(w, p, 0, nil, nil)
+}
+
+// setParams applies p to a context that is not compressing
+func setParams(cctx *C.ZSTD1_CCtx, p Params) error {
+	cParams, err := p.cParams()
+	if err != nil {
+		return err
+	}
+	return getError(int(C.ZSTD1_CCtx_setParams_wrapper(cctx, cParams)))
+}
@@ -0,0 +1,286 @@
+package zstd1
+
+import (
+	"bytes"
+	"fmt"
+	"io/ioutil"
+	"math/rand"
+	"testing"
+)
+
+func TestParamsForLevel(t *testing.T) {
+	p := ParamsForLevel(DefaultCompression, 0)
+	if p.Level != DefaultCompression || p.WindowLog == 0 || p.HashLog == 0 || p.Strategy == 0 {
+		t.Fatalf("Unexpected parameters: %+v", p)
+	}
+	failOnError(t, "Level parameters should be valid", p.Validate())
+	// Small inputs get smaller tables
+	if small := ParamsForLevel(DefaultCompression, 1000); small.WindowLog >= p.WindowLog {
+		t.Fatalf("Window was not reduced for a small input: %+v", small)
+	}
+}
+
+func TestParamsValidate(t *testing.T) {
+	for _, p := range []Params{
+		{Level: 3, WindowLog: 5},
+		{Level: 3, HashLog: 40},
+		{Level: 3, SearchLength: 9},
+		{Level: 3, Strategy: 42},
+		{Level: 3, ChainLog: -1},
+	} {
+		if err := p.Validate(); err == nil {
+			t.Fatalf("Parameters should be invalid: %+v", p)
+		}
+		if _, err := CompressParams(nil, []byte("payload"), p); err == nil {
+			t.Fatalf("Compressing with invalid parameters should fail: %+v", p)
+		}
+		w := NewWriterParams(ioutil.Discard, p)
+		if _, err := w.Write([]byte("payload")); err == nil {
+			t.Fatalf("Writer with invalid parameters should fail: %+v", p)
+		}
+		w.Close()
+	}
+	failOnError(t, "Default parameters should be valid", Params{}.Validate())
+}
+
+func TestCompressParams(t *testing.T) {
+	payload := makePayload(200 << 10)
+	for _, p := range []Params{
+		{},
+		{Level: 3, HashLog: 12, ChainLog: 12},
+		{Level: 1, Strategy: StrategyLazy2, SearchLog: 3},
+		{Level: 19, WindowLog: 20, TargetLength: 64},
+		{Level: 5, SearchLength: 6, Checksum: true},
+	} {
+		compressed, err := CompressParams(nil, payload, p)
+		failOnError(t, fmt.Sprintf("Failed to compress with %+v", p), err)
+		decompressed, err := Decompress(nil, compressed)
+		failOnError(t, "Failed to decompress", err)
+		if !bytes.Equal(payload, decompressed) {
+			t.Fatalf("Payload did not match for %+v", p)
+		}
+
+		var buf bytes.Buffer
+		w := NewWriterParams(&buf, p)
+		_, err = w.Write(payload)
+		failOnError(t, "Failed writing to compress object", err)
+		failOnError(t, "Failed to close compress object", w.Close())
+		decompressed, err = Decompress(nil, buf.Bytes())
+		failOnError(t, "Failed to decompress stream", err)
+		if !bytes.Equal(payload, decompressed) {
+			t.Fatalf("Stream payload did not match for %+v", p)
+		}
+	}
+}
+
+func TestCompressParamsChecksum(t *testing.T) {
+	payload := makePayload(10 << 10)
+	plain, err := CompressParams(nil, payload, Params{Level: 3})
+	failOnError(t, "Failed to compress", err)
+	checked, err := CompressParams(nil, payload, Params{Level: 3, Checksum: true})
+	failOnError(t, "Failed to compress", err)
+	if len(checked) != len(plain)+4 {
+		t.Fatalf("Checksum should add 4 bytes: %v vs %v", len(checked), len(plain))
+	}
+	// The checksum does not stick to the pooled context
+	again, err := CompressParams(nil, payload, Params{Level: 3})
+	failOnError(t, "Failed to compress", err)
+	if !bytes.Equal(plain, again) {
+		t.Fatalf("Parameters leaked between calls")
+	}
+	checked[len(checked)-1] ^= 0xff
+	if _, err := Decompress(nil, checked); err == nil {
+		t.Fatalf("Corrupted checksum was not detected")
+	}
+}
+
+func BenchmarkCompressParams(b *testing.B) {
+	payload := makePayload(1 << 20)
+	dst := make([]byte, CompressBound(len(payload)))
+	base := ParamsForLevel(DefaultCompression, len(payload))
+	for _, delta := range []int{0, 2, 4, 6} {
+		p := base
+		p.HashLog -= delta
+		p.ChainLog -= delta
+		b.Run(fmt.Sprintf("HashLog%d/ChainLog%d", p.HashLog, p.ChainLog), func(b *testing.B) {
+			compressed, err := CompressParams(dst, payload, p)
+			if err != nil {
+				b.Fatalf("Failed compressing: %s", err)
+			}
+			b.Logf("ratio %.3f", float64(len(payload))/float64(len(compressed)))
+			b.SetBytes(int64(len(payload)))
+			for i := 0; i < b.N; i++ {
+				if _, err := CompressParams(dst, payload, p); err != nil {
+					b.Fatalf("Failed compressing: %s", err)
+				}
+			}
+		})
+	}
+}
+
+// makeImages returns a corpus of similar disk images: copies of a base image
+// of poorly compressible data, each with a few scattered sectors rewritten,
+// so that duplicates are one image size apart.
+func makeImages(imageSize, copies int) []byte {
+	rng := rand.New(rand.NewSource(42))
+	base := make([]byte, imageSize)
+	for i := range base {
+		base[i] = byte(rng.Intn(64)) // some entropy coding gain, few matches
+	}
+	corpus := make([]byte, 0, imageSize*copies)
+	for c := 0; c < copies; c++ {
+		image := append([]byte(nil), base...)
+		for s := 0; s < imageSize/512/100; s++ { // 1% of the sectors
+			sector := image[rng.Intn(imageSize/512)*512:][:512]
+			rng.Read(sector)
+		}
+		corpus = append(corpus, image...)
+	}
+	return corpus
+}
+
+func TestLongDistanceMatching(t *testing.T) {
+	corpus := makeImages(1<<20, 4)
+	regular, err := CompressParams(nil, corpus, Params{Level: 1})
+	failOnError(t, "Failed to compress", err)
+	ldm, err := CompressParams(nil, corpus, Params{Level: 1, LongDistanceMatching: true})
+	failOnError(t, "Failed to compress with long distance matching", err)
+	if len(ldm) > len(regular)/2 {
+		t.Fatalf("Long distance matching did not find the duplicates: %v vs %v", len(ldm), len(regular))
+	}
+	decompressed, err := Decompress(nil, ldm)
+	failOnError(t, "Failed to decompress", err)
+	if !bytes.Equal(corpus, decompressed) {
+		t.Fatalf("Payload did not match")
+	}
+
+	var buf bytes.Buffer
+	w := NewWriterParams(&buf, Params{Level: 1, LongDistanceMatching: true, LDMHashLog: 16, LDMMinMatch: 128})
+	_, err = w.Write(corpus)
+	failOnError(t, "Failed writing to compress object", err)
+	failOnError(t, "Failed to close compress object", w.Close())
+	if buf.Len() > len(regular)/2 {
+		t.Fatalf("Long distance matching did not find the duplicates: %v vs %v", buf.Len(), len(regular))
+	}
+	decompressed, err = Decompress(nil, buf.Bytes())
+	failOnError(t, "Failed to decompress stream", err)
+	if !bytes.Equal(corpus, decompressed) {
+		t.Fatalf("Stream payload did not match")
+	}
+
+	for _, p := range []Params{
+		{LongDistanceMatching: true, LDMHashLog: 40},
+		{LongDistanceMatching: true, LDMMinMatch: 2},
+		{LongDistanceMatching: true, LDMBucketSizeLog: 9},
+		{LongDistanceMatching: true, LDMHashEveryLog: -1},
+	} {
+		if err := p.Validate(); err == nil {
+			t.Fatalf("Parameters should be invalid: %+v", p)
+		}
+	}
+}
+
+// Contexts are shared through the pool: advanced parameters must not leak
+// into the next compression that borrows the same context.
+func TestCompressParamsDoNotLeak(t *testing.T) {
+	corpus := makeImages(256<<10, 4)
+	fresh, err := mustCompressCtx(t).CompressLevel(nil, corpus, 1)
+	failOnError(t, "Failed to compress", err)
+
+	c := mustCompressCtx(t)
+	_, err = c.CompressParams(nil, corpus, Params{Level: 1, WindowLog: 20, HashLog: 12, LongDistanceMatching: true, Checksum: true})
+	failOnError(t, "Failed to compress with long distance matching", err)
+	reused, err := c.CompressLevel(nil, corpus, 1)
+	failOnError(t, "Failed to compress", err)
+	if !bytes.Equal(fresh, reused) {
+		t.Fatalf("Parameters leaked into CompressLevel: %v vs %v bytes", len(reused), len(fresh))
+	}
+
+	_, err = CompressParams(nil, corpus, Params{Level: 1, LongDistanceMatching: true})
+	failOnError(t, "Failed to compress with long distance matching", err)
+	pooled, err := CompressLevel(nil, corpus, 1)
+	failOnError(t, "Failed to compress", err)
+	if !bytes.Equal(fresh, pooled) {
+		t.Fatalf("Parameters leaked into a pooled context: %v vs %v bytes", len(pooled), len(fresh))
+	}
+}
+
+func TestParamsLevelSized(t *testing.T) {
+	for p, expected := range map[Params]bool{
+		{}:                                     true,
+		{Level: 19, Checksum: true}:            true,
+		{Level: 3, WindowLog: 27}:              false,
+		{Level: 3, HashLog: 12}:                false,
+		{Level: 1, LongDistanceMatching: true}: false,
+	} {
+		if p.levelSized() != expected {
+			t.Fatalf("levelSized is %v for %+v", !expected, p)
+		}
+	}
+}
+
+func TestWindowLogMax(t *testing.T) {
+	payload := makePayload(1 << 20)
+	var buf bytes.Buffer
+	w := NewWriterParams(&buf, Params{Level: 1, WindowLog: 28})
+	_, err := w.Write(payload)
+	failOnError(t, "Failed writing to compress object", err)
+	failOnError(t, "Failed to close compress object", w.Close())
+
+	r := NewReader(bytes.NewReader(buf.Bytes()))
+	if _, err := ioutil.ReadAll(r); err == nil {
+		t.Fatalf("A window of 256 MB should be refused by default")
+	}
+	r.Close()
+
+	r = NewReaderWindowLogMax(bytes.NewReader(buf.Bytes()), 28)
+	decompressed, err := ioutil.ReadAll(r)
+	failOnError(t, "Failed to decompress with a larger window", err)
+	failOnError(t, "Failed to close decompress object", r.Close())
+	if !bytes.Equal(payload, decompressed) {
+		t.Fatalf("Payload did not match")
+	}
+
+	r = NewReaderWindowLogMax(bytes.NewReader(buf.Bytes()), 64)
+	if _, err := ioutil.ReadAll(r); err == nil {
+		t.Fatalf("An invalid window log should fail")
+	}
+	r.Close()
+}
+
+// BenchmarkLongDistanceMatching compresses 8 near duplicate 4 MB images.  The
+// default window of levels 1 and 3 is smaller than an image and misses the
+// duplicates.  A larger WindowLog lets the regular match finder reach them,
+// and long distance matching adds a finder dedicated to long matches, at a
+// cost in throughput.
+func BenchmarkLongDistanceMatching(b *testing.B) {
+	corpus := makeImages(4<<20, 8)
+	dst := make([]byte, CompressBound(len(corpus)))
+	for _, bench := range []struct {
+		name string
+		p    Params
+	}{
+		{"Level1", Params{Level: 1}},
+		{"Level1/WindowLog27", Params{Level: 1, WindowLog: 27}},
+		{"Level1/LDM", Params{Level: 1, LongDistanceMatching: true}},
+		{"Level3", Params{Level: 3}},
+		{"Level3/WindowLog27", Params{Level: 3, WindowLog: 27}},
+		{"Level3/LDM", Params{Level: 3, LongDistanceMatching: true}},
+		{"Level3/LDM/MinMatch256", Params{Level: 3, LongDistanceMatching: true, LDMMinMatch: 256}},
+	} {
+		b.Run(bench.name, func(b *testing.B) {
+			compressed, err := CompressParams(dst, corpus, bench.p)
+			if err != nil {
+				b.Fatalf("Failed compressing: %s", err)
+			}
+			b.Logf("ratio %.3f", float64(len(corpus))/float64(len(compressed)))
+			b.SetBytes(int64(len(corpus)))
+			b.ResetTimer()
+			for i := 0; i < b.N; i++ {
+				if _, err := CompressParams(dst, corpus, bench.p); err != nil {
+					b.Fatalf("Failed compressing: %s", err)
+				}
+			}
+		})
+	}
+}
@@ -0,0 +1,95 @@
+package zstd1
+
+import (
+	"sync"
+)
+
+// Compression contexts are pooled by (level, windowLog).  ZSTD1_compressCCtx
+// only reuses a context's workspace in place (ZSTD1_continueCCtx) when the
+// new parameters are equivalent to the ones it was last reset with, and the
+// parameters zstd derives from a level only depend on the level and on the
+// window the source size fits in.  Handing out a context that was last used
+// for the same key therefore skips the workspace reallocation and the
+// memset of its tables.
+//
+// Contexts dropped by a sync.Pool during GC are freed by their finalizer.
+
+const (
+	poolWindowLogMin = 10 // ZSTD1_WINDOWLOG_ABSOLUTEMIN
+	poolWindowLogMax = 27 // largest windowLog of the default level tables
+	poolLevelMax     = 22 // ZSTD1_MAX_CLEVEL, higher levels are clamped to it
+)
+
+type ctxPoolKey struct {
+	level     int
+	windowLog int
+}
+
+var (
+	cctxPools sync.Map  // ctxPoolKey -> *sync.Pool of *CompressCtx
+	dctxPool  sync.Pool // *DecompressCtx
+)
+
+// poolWindowLog mirrors the window size reduction ZSTD1_adjustCParams applies
+// for a source of srcSize bytes.
+func poolWindowLog(srcSize int) int {
+	windowLog := poolWindowLogMin
+	for windowLog < poolWindowLogMax && 1<<uint(windowLog) < srcSize {
+		windowLog++
+	}
+	return windowLog
+}
+
+// newCtxPoolKey maps level to one of a bounded set of keys.  Negative levels
+// only differ by targetLength, which does not size the workspace, so they all
+// share the pool of level -1.
+func newCtxPoolKey(level, srcSize int) ctxPoolKey {
+	switch {
+	case level == 0:
+		level = 3 // ZSTD1_CLEVEL_DEFAULT
+	case level < 0:
+		level = -1
+	case level > poolLevelMax:
+		level = poolLevelMax
+	}
+	return ctxPoolKey{level: level, windowLog: poolWindowLog(srcSize)}
+}
+
+// getCompressCtx returns a compression context whose workspace was last sized
+// for compressing srcSize bytes at level, or a new one.
+func getCompressCtx(level, srcSize int) (*CompressCtx, error) {
+	key := newCtxPoolKey(level, srcSize)
+	p, ok := cctxPools.Load(key)
+	if !ok {
+		p, _ = cctxPools.LoadOrStore(key, &sync.Pool{})
+	}
+	c, _ := p.(*sync.Pool).Get().(*CompressCtx)
+	if c == nil {
+		var err error
+		if c, err = NewCompressCtx(); err != nil {
+			return nil, err
+		}
+		c.key = key
+	}
+	return c, nil
+}
+
+// putCompressCtx returns c to the pool it was taken from.
+func putCompressCtx(c *CompressCtx) {
+	if p, ok := cctxPools.Load(c.key); ok {
+		p.(*sync.Pool).Put(c)
+	}
+}
+
+// getDecompressCtx returns a pooled decompression context, or a new one.
+func getDecompressCtx() (*DecompressCtx, error) {
+	if d, _ := dctxPool.Get().(*DecompressCtx); d != nil {
+		return d, nil
+	}
+	return NewDecompressCtx()
+}
+
+// putDecompressCtx returns d to the pool.
+func putDecompressCtx(d *DecompressCtx) {
+	dctxPool.Put(d)
+}
@@ -0,0 +1,123 @@
+package zstd1
+
+import (
+	"bytes"
+	"fmt"
+	"runtime"
+	"sync"
+	"testing"
+)
+
+func TestPoolWindowLog(t *testing.T) {
+	tests := map[int]int{
+		0:         10,
+		1:         10,
+		1024:      10,
+		1025:      11,
+		64 << 10:  16,
+		100 << 10: 17,
+		1 << 30:   27,
+	}
+	for srcSize, expected := range tests {
+		if got := poolWindowLog(srcSize); got != expected {
+			t.Fatalf("For %v, windowLog is %v, expected %v", srcSize, got, expected)
+		}
+	}
+}
+
+func TestPoolKeys(t *testing.T) {
+	c, err := getCompressCtx(DefaultCompression, 4<<10)
+	failOnError(t, "Failed to get a context", err)
+	if c.key != (ctxPoolKey{level: DefaultCompression, windowLog: 12}) {
+		t.Fatalf("Unexpected pool key: %+v", c.key)
+	}
+	putCompressCtx(c)
+	if newCtxPoolKey(0, 100) != newCtxPoolKey(3, 100) {
+		t.Fatalf("Level 0 should share the default level pool")
+	}
+	if newCtxPoolKey(-5, 100) != newCtxPoolKey(MinCompressionLevel, 100) {
+		t.Fatalf("Negative levels should share a pool")
+	}
+	if newCtxPoolKey(22, 100) != newCtxPoolKey(1000, 100) {
+		t.Fatalf("Levels above the maximum should share its pool")
+	}
+}
+
+func TestPoolConcurrentCompressDecompress(t *testing.T) {
+	var wg sync.WaitGroup
+	errs := make(chan error, 64)
+	for g := 0; g < 64; g++ {
+		wg.Add(1)
+		go func(g int) {
+			defer wg.Done()
+			for i := 0; i < 20; i++ {
+				size := benchSizes[(g+i)%len(benchSizes)]
+				level := 1 + (g+i)%9
+				payload := makePayload(size)
+				compressed, err := CompressLevel(nil, payload, level)
+				if err != nil {
+					errs <- err
+					return
+				}
+				decompressed, err := Decompress(nil, compressed)
+				if err != nil {
+					errs <- err
+					return
+				}
+				if !bytes.Equal(payload, decompressed) {
+					errs <- fmt.Errorf("payload mismatch for size %v, level %v", size, level)
+					return
+				}
+			}
+		}(g)
+	}
+	wg.Wait()
+	close(errs)
+	for err := range errs {
+		t.Fatal(err)
+	}
+}
+
+func TestPoolFinalizer(t *testing.T) {
+	// Leaked contexts must be freed by their finalizer without crashing
+	for i := 0; i < 100; i++ {
+		c := mustCompressCtx(t)
+		if _, err := c.Compress(nil, makePayload(1024)); err != nil {
+			t.Fatalf("Failed to compress: %s", err)
+		}
+		d := mustDecompressCtx(t)
+		_ = d
+	}
+	runtime.GC()
+	runtime.GC()
+}
+
+func BenchmarkPoolCompressionParallel(b *testing.B) {
+	for _, size := range benchSizes {
+		payload := makePayload(size)
+		b.Run(fmt.Sprintf("Pooled/%d", size), func(b *testing.B) {
+			b.SetBytes(int64(size))
+			b.RunParallel(func(pb *testing.PB) {
+				dst := make([]byte, CompressBound(size))
+				for pb.Next() {
+					if _, err := CompressLevel(dst, payload, DefaultCompression); err != nil {
+						b.Fatalf("Failed compressing: %s", err)
+					}
+				}
+			})
+		})
+		b.Run(fmt.Sprintf("NewCtx/%d", size), func(b *testing.B) {
+			b.SetBytes(int64(size))
+			b.RunParallel(func(pb *testing.PB) {
+				dst := make([]byte, CompressBound(size))
+				for pb.Next() {
+					c := mustCompressCtx(b)
+					if _, err := c.CompressLevel(dst, payload, DefaultCompression); err != nil {
+						b.Fatalf("Failed compressing: %s", err)
+					}
+					c.Close()
+				}
+			})
+		})
+	}
+}
@@ -0,0 +1,194 @@
+package zstd1
+
+/*
+#define ZSTD1_STATIC_LINKING_ONLY
+#include "zstd.h"
+#include "zstd_errors.h"
+*/
+import "C"
+import (
+	"bytes"
+	"encoding/binary"
+	"errors"
+	"io"
+	"sync"
+	"sync/atomic"
+)
+
+var (
+	// ErrUnknownDictionary is returned when decompressing a frame that needs
+	// a dictionary missing from the registry
+	ErrUnknownDictionary = errors.New("Unknown dictionary ID")
+	// ErrNoDictionaryID is returned when adding a raw content dictionary, which
+	// has no ID, to a registry
+	ErrNoDictionaryID = errors.New("Dictionary has no ID")
+)
+
+// DictRegistry holds prepared dictionaries by ID, so that frames compressed
+// with different dictionaries can be decompressed without knowing which one
+// each of them used: zstd writes the ID of the dictionary in the frame header.
+//
+// A DictRegistry can be shared by any number of goroutines.  Lookups do not
+// lock: the dictionaries are in a map that is copied on every change, which
+// suits registries updated now and then and read for every payload.
+type DictRegistry struct {
+	mu    sync.Mutex   // serializes changes
+	dicts atomic.Value // map[uint32]*DecompressionDict, never modified
+}
+
+// NewDictRegistry returns an empty registry.
+func NewDictRegistry() *DictRegistry {
+	r := &DictRegistry{}
+	r.dicts.Store(map[uint32]*DecompressionDict{})
+	return r
+}
+
+// Add registers dict under its ID, replacing any dictionary with the same ID.
+// The replaced dictionary is not closed, as decompressions may still use it.
+func (r *DictRegistry) Add(dict *DecompressionDict) error {
+	id := dict.ID()
+	if id == 0 {
+		return ErrNoDictionaryID
+	}
+	r.update(func(dicts map[uint32]*DecompressionDict) {
+		dicts[id] = dict
+	})
+	return nil
+}
+
+// Remove unregisters the dictionary with the given ID and returns it, or nil
+// if there was none.  It is left to the caller to close it once it is no
+// longer in use.
+func (r *DictRegistry) Remove(id uint32) *DecompressionDict {
+	var removed *DecompressionDict
+	r.update(func(dicts map[uint32]*DecompressionDict) {
+		removed = dicts[id]
+		delete(dicts, id)
+	})
+	return removed
+}
+
+// Get returns the dictionary registered under id, or nil if there is none.
+func (r *DictRegistry) Get(id uint32) *DecompressionDict {
+	return r.dicts.Load().(map[uint32]*DecompressionDict)[id]
+}
+
+// update applies change to a copy of the dictionaries and publishes it
+func (r *DictRegistry) update(change func(map[uint32]*DecompressionDict)) {
+	r.mu.Lock()
+	defer r.mu.Unlock()
+	old := r.dicts.Load().(map[uint32]*DecompressionDict)
+	dicts := make(map[uint32]*DecompressionDict, len(old)+1)
+	for id, d := range old {
+		dicts[id] = d
+	}
+	change(dicts)
+	r.dicts.Store(dicts)
+}
+
+// errDictionaryWrong is returned by zstd when a frame needs another
+// dictionary than the one it is decompressed with
+var errDictionaryWrong = ErrorCode(-C.ZSTD1_error_dictionary_wrong)
+
+// frameDictID returns the dictionary ID in the header of the frame at the
+// start of src, or 0 if it has none.  Only the few bytes up to the ID are
+// read, in Go as a cgo call would cost more than the lookup itself; anything
+// but a zstd frame, skippable or invalid, has no ID and is left for zstd to
+// handle.  It returns errIncompleteFrame if src ends before the ID.
+func frameDictID(src []byte) (uint32, error) {
+	if len(src) < 5 {
+		return 0, errIncompleteFrame
+	}
+	if binary.LittleEndian.Uint32(src) != C.ZSTD1_MAGICNUMBER {
+		return 0, nil
+	}
+	descriptor := src[4]
+	pos := 5
+	if descriptor&0x20 == 0 {
+		pos++ // window descriptor, absent from single segment frames
+	}
+	size := [4]int{0, 1, 2, 4}[descriptor&3]
+	if len(src) < pos+size {
+		return 0, errIncompleteFrame
+	}
+	switch size {
+	case 1:
+		return uint32(src[pos]), nil
+	case 2:
+		return uint32(binary.LittleEndian.Uint16(src[pos:])), nil
+	case 4:
+		return binary.LittleEndian.Uint32(src[pos:]), nil
+	}
+	return 0, nil
+}
+
+// lookup returns the dictionary needed by the frame at the start of src, nil
+// if it needs none
+func (r *DictRegistry) lookup(src []byte) (*DecompressionDict, error) {
+	id, err := frameDictID(src)
+	if err != nil || id == 0 {
+		return nil, err
+	}
+	dict := r.Get(id)
+	if dict == nil {
+		return nil, ErrUnknownDictionary
+	}
+	return dict, nil
+}
+
+// DecompressRegistry decompresses src into dst with the dictionary of reg
+// that the frame was compressed with, or without one if the frame names none.
+// src may hold several frames, each using its own dictionary.  Buffer handling
+// is the same as for Decompress.
+func DecompressRegistry(dst, src []byte, reg *DictRegistry) ([]byte, error) {
+	if len(src) == 0 {
+		return []byte{}, ErrEmptySlice
+	}
+	dict, err := reg.lookup(src)
+	if err == errIncompleteFrame {
+		// Let zstd report the truncated frame
+		return Decompress(dst, src)
+	} else if err != nil {
+		return nil, err
+	}
+	var out []byte
+	if dict == nil {
+		out, err = Decompress(dst, src)
+	} else {
+		out, err = DecompressDict(dst, src, dict)
+	}
+	if err == errDictionaryWrong {
+		// A later frame uses another dictionary, which the reader handles
+		r := NewReaderRegistry(bytes.NewReader(src), reg)
+		defer r.Close()
+		return readAllInto(dst[:0], r)
+	}
+	return out, err
+}
+
+// NewReaderRegistry is like NewReader but decompresses every frame with the
+// dictionary of reg that it was compressed with.  The dictionary is looked up
+// when a frame starts, so dictionaries added to reg while reading apply to the
+// following frames.
+func NewReaderRegistry(r io.Reader, reg *DictRegistry) io.ReadCloser {
+	zr := newReader(r)
+	zr.registry = reg
+	zr.firstError = zr.init()
+	return zr
+}
+
+// selectDict loads the dictionary of the frame starting at src into r, unless
+// it is already loaded
+func (r *reader) selectDict(src []byte) error {
+	dict, err := r.registry.lookup(src)
+	if err != nil || dict == r.ddict {
+		return err
+	}
+	if dict == nil {
+		err = getError(int(C.ZSTD1_initDStream(r.ctx)))
+	} else {
+		err = getError(int(C.ZSTD1_initDStream_usingDDict(r.ctx, dict.ddict)))
+	}
+	r.ddict = dict
+	return err
+}
@@ -0,0 +1,229 @@
+package zstd1
+
+import (
+	"bytes"
+	"io"
+	"io/ioutil"
+	"sync"
+	"testing"
+	"testing/iotest"
+)
+
+var (
+	registryOnce  sync.Once
+	registryDicts [][]byte
+)
+
+// registryTestDicts returns three dictionaries with IDs 1 to 3, trained on
+// events of different seeds
+func registryTestDicts(t testing.TB) [][]byte {
+	registryOnce.Do(func() {
+		for id := 1; id <= 3; id++ {
+			dict, err := TrainDictionary(makeEvents(1000, int64(id)), 4<<10, CoverParams{K: 200, D: 8, DictID: uint32(id)})
+			if err != nil {
+				t.Fatalf("Failed to train dictionary: %s", err)
+			}
+			registryDicts = append(registryDicts, dict)
+		}
+	})
+	return registryDicts
+}
+
+// newTestRegistry returns a registry with the dictionaries of
+// registryTestDicts, and their compression counterparts
+func newTestRegistry(t testing.TB) (*DictRegistry, []*CompressionDict) {
+	reg := NewDictRegistry()
+	var cdicts []*CompressionDict
+	for _, dict := range registryTestDicts(t) {
+		ddict, err := NewDecompressionDict(dict)
+		if err != nil {
+			t.Fatalf("Failed to create decompression dictionary: %s", err)
+		}
+		if err := reg.Add(ddict); err != nil {
+			t.Fatalf("Failed to register dictionary: %s", err)
+		}
+		cdict, err := NewCompressionDict(dict, DefaultCompression)
+		if err != nil {
+			t.Fatalf("Failed to create compression dictionary: %s", err)
+		}
+		cdicts = append(cdicts, cdict)
+	}
+	return reg, cdicts
+}
+
+func TestDictRegistry(t *testing.T) {
+	reg, cdicts := newTestRegistry(t)
+	events := makeEvents(30, 4)
+	var all, expected []byte
+	for i, event := range events {
+		var compressed []byte
+		var err error
+		if i%4 == 3 {
+			compressed, err = Compress(nil, event)
+		} else {
+			compressed, err = CompressDict(nil, event, cdicts[i%4])
+		}
+		failOnError(t, "Failed to compress", err)
+		decompressed, err := DecompressRegistry(nil, compressed, reg)
+		failOnError(t, "Failed to decompress with registry", err)
+		if !bytes.Equal(event, decompressed) {
+			t.Fatalf("Event %v did not match", i)
+		}
+		all = append(all, compressed...)
+		expected = append(expected, event...)
+	}
+
+	// Concatenated frames switch dictionaries as they go
+	decompressed, err := DecompressRegistry(nil, all, reg)
+	failOnError(t, "Failed to decompress frames with registry", err)
+	if !bytes.Equal(expected, decompressed) {
+		t.Fatalf("Frames did not match, lengths: %v & %v", len(expected), len(decompressed))
+	}
+
+	// Reading byte by byte stops at every frame header
+	r := NewReaderRegistry(iotest.OneByteReader(bytes.NewReader(all)), reg)
+	decompressed, err = ioutil.ReadAll(r)
+	failOnError(t, "Failed to read frames with registry", err)
+	failOnError(t, "Failed to close reader", r.Close())
+	if !bytes.Equal(expected, decompressed) {
+		t.Fatalf("Streamed frames did not match, lengths: %v & %v", len(expected), len(decompressed))
+	}
+}
+
+func TestDictRegistryErrors(t *testing.T) {
+	reg, cdicts := newTestRegistry(t)
+	raw, err := NewDecompressionDict([]byte("raw content dictionary"))
+	failOnError(t, "Failed to create decompression dictionary", err)
+	defer raw.Close()
+	if err := reg.Add(raw); err != ErrNoDictionaryID {
+		t.Fatalf("Adding a raw dictionary should fail with ErrNoDictionaryID, got %v", err)
+	}
+
+	event := makeEvents(1, 5)[0]
+	compressed, err := CompressDict(nil, event, cdicts[1])
+	failOnError(t, "Failed to compress", err)
+	removed := reg.Remove(2)
+	if removed == nil || removed.ID() != 2 {
+		t.Fatalf("Remove should return dictionary 2, got %v", removed)
+	}
+	defer removed.Close()
+	if reg.Get(2) != nil || reg.Remove(2) != nil {
+		t.Fatalf("Dictionary 2 should be gone")
+	}
+	if _, err := DecompressRegistry(nil, compressed, reg); err != ErrUnknownDictionary {
+		t.Fatalf("Missing dictionary should fail with ErrUnknownDictionary, got %v", err)
+	}
+	r := NewReaderRegistry(bytes.NewReader(compressed), reg)
+	if _, err := ioutil.ReadAll(r); err != ErrUnknownDictionary {
+		t.Fatalf("Reading with a missing dictionary should fail with ErrUnknownDictionary, got %v", err)
+	}
+	r.Close()
+
+	// A header cut short
+	r = NewReaderRegistry(bytes.NewReader(compressed[:3]), reg)
+	if _, err := ioutil.ReadAll(r); err != io.ErrUnexpectedEOF {
+		t.Fatalf("Reading a truncated header should fail with io.ErrUnexpectedEOF, got %v", err)
+	}
+	r.Close()
+	if _, err := DecompressRegistry(nil, compressed[:3], reg); err == nil {
+		t.Fatalf("Decompressing a truncated header should fail")
+	}
+	if _, err := DecompressRegistry(nil, nil, reg); err != ErrEmptySlice {
+		t.Fatalf("Decompressing nothing should fail with ErrEmptySlice, got %v", err)
+	}
+}
+
+func TestFrameDictID(t *testing.T) {
+	magic := []byte{0x28, 0xb5, 0x2f, 0xfd}
+	for _, c := range []struct {
+		header []byte
+		id     uint32
+		err    error
+	}{
+		{[]byte{0x20, 0x00}, 0, nil},                            // single segment, no ID
+		{[]byte{0x21, 0x7f}, 0x7f, nil},                         // 1 byte ID
+		{[]byte{0x02, 0x00, 0x34, 0x12}, 0x1234, nil},           // window descriptor, 2 bytes ID
+		{[]byte{0x23, 0x78, 0x56, 0x34, 0x12}, 0x12345678, nil}, // 4 bytes ID
+		{[]byte{0x23, 0x78, 0x56}, 0, errIncompleteFrame},
+		{[]byte{}, 0, errIncompleteFrame},
+	} {
+		id, err := frameDictID(append(append([]byte{}, magic...), c.header...))
+		if id != c.id || err != c.err {
+			t.Fatalf("Header %x: expected ID %x and %v, got %x and %v", c.header, c.id, c.err, id, err)
+		}
+	}
+	// Skippable frames have no dictionary
+	if id, err := frameDictID([]byte{0x50, 0x2a, 0x4d, 0x18, 0x01}); id != 0 || err != nil {
+		t.Fatalf("Skippable frame: expected no ID, got %x and %v", id, err)
+	}
+}
+
+func TestDictRegistryConcurrently(t *testing.T) {
+	reg, cdicts := newTestRegistry(t)
+	event := makeEvents(1, 6)[0]
+	compressed, err := CompressDict(nil, event, cdicts[0])
+	failOnError(t, "Failed to compress", err)
+	dict := registryTestDicts(t)[1]
+
+	var wg sync.WaitGroup
+	errs := make(chan error, 4)
+	for i := 0; i < 4; i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for j := 0; j < 200; j++ {
+				decompressed, err := DecompressRegistry(nil, compressed, reg)
+				if err == nil && !bytes.Equal(event, decompressed) {
+					err = io.ErrShortBuffer
+				}
+				if err != nil {
+					errs <- err
+					return
+				}
+			}
+		}()
+	}
+	// Replace dictionary 2 while the others decompress with dictionary 1
+	for j := 0; j < 50; j++ {
+		ddict, err := NewDecompressionDict(dict)
+		failOnError(t, "Failed to create decompression dictionary", err)
+		failOnError(t, "Failed to register dictionary", reg.Add(ddict))
+	}
+	wg.Wait()
+	close(errs)
+	for err := range errs {
+		t.Fatalf("Failed to decompress concurrently: %s", err)
+	}
+}
+
+func BenchmarkDictRegistry(b *testing.B) {
+	reg, cdicts := newTestRegistry(b)
+	event := makeEvents(1, 7)[0]
+	compressed, err := CompressDict(nil, event, cdicts[0])
+	if err != nil {
+		b.Fatalf("Failed to compress: %s", err)
+	}
+	ddict := reg.Get(1)
+	b.Run("Registry", func(b *testing.B) {
+		b.SetBytes(int64(len(event)))
+		b.RunParallel(func(pb *testing.PB) {
+			dst := make([]byte, len(event))
+			for pb.Next() {
+				if _, err := DecompressRegistry(dst, compressed, reg); err != nil {
+					b.Fatalf("Failed to decompress: %s", err)
+				}
+			}
+		})
+	})
+	b.Run("Dict", func(b *testing.B) {
+		b.SetBytes(int64(len(event)))
+		b.RunParallel(func(pb *testing.PB) {
+			dst := make([]byte, len(event))
+			for pb.Next() {
+				if _, err := DecompressDict(dst, compressed, ddict); err != nil {
+					b.Fatalf("Failed to decompress: %s", err)
+				}
+			}
+		})
+	})
+}
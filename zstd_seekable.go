@@ -0,0 +1,435 @@
+package zstd1
+
+/*
+#define ZSTD1_STATIC_LINKING_ONLY
+#include "zstd.h"
+#include "xxhash.h"
+#include "stdint.h"  // for uintptr_t
+
+// See zstd_ctx.go for why these *_wrapper functions take uintptr_t.
+
+static unsigned seekable_checksum(uintptr_t src, size_t srcSize) {
+	return (unsigned)XXH64((const void*)src, srcSize, 0);
+}
+*/
+import "C"
+import (
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"io"
+	"runtime"
+	"sort"
+	"sync"
+	"unsafe"
+)
+
+// The seekable format is the one from zstd's contrib/seekable_format: a series
+// of independent frames followed by a skippable frame holding the seek table
+//
+//	magic (4) | frame size (4) | entries | frame count (4) | descriptor (1) | seekable magic (4)
+//
+// where each entry is the compressed and decompressed size of a frame and,
+// when the descriptor has the checksum flag, the low 32 bits of the XXH64 of
+// its decompressed content.  Plain zstd readers skip the seek table.
+const (
+	seekTableMagic      = C.ZSTD1_MAGIC_SKIPPABLE_START | 0xE
+	seekableMagic       = 0x8F92EAB1
+	seekTableFooterSize = 9
+	seekChecksumFlag    = 1 << 7
+
+	// DefaultSeekableFrameSize is the amount of uncompressed data per frame
+	// used by NewSeekableWriter when frameSize is 0
+	DefaultSeekableFrameSize = 256 << 10
+	// maxSeekableFrameSize is the largest size a seek table entry can hold
+	maxSeekableFrameSize = 1<<32 - 1
+
+	// defaultSeekableCacheFrames is the number of decompressed frames a
+	// SeekableReader keeps around
+	defaultSeekableCacheFrames = 8
+)
+
+var (
+	// ErrInvalidSeekTable is returned when opening data that does not end with
+	// a valid seek table
+	ErrInvalidSeekTable = errors.New("Invalid seek table")
+	// ErrSeekableChecksum is returned when a frame does not match the checksum
+	// stored in the seek table
+	ErrSeekableChecksum = errors.New("Seekable frame checksum mismatch")
+
+	errNegativeOffset = errors.New("negative offset")
+)
+
+func seekableChecksum(src []byte) uint32 {
+	if len(src) == 0 {
+		return uint32(C.seekable_checksum(0, 0))
+	}
+	checksum := uint32(C.seekable_checksum(C.uintptr_t(uintptr(unsafe.Pointer(&src[0]))), C.size_t(len(src))))
+	runtime.KeepAlive(src)
+	return checksum
+}
+
+type seekEntry struct {
+	compressedSize   uint32
+	decompressedSize uint32
+	checksum         uint32
+}
+
+// SeekableWriter compresses data in the seekable format: the input is cut in
+// independent frames of a fixed uncompressed size, and the sizes of all frames
+// are written as a seek table when the writer is closed.  The output is a
+// valid zstd stream that any reader can decompress, while a SeekableReader
+// can decompress any range of it by only touching the frames it overlaps.
+//
+// Smaller frames make random reads cheaper at the expense of compression
+// ratio, as every frame starts without history.
+type SeekableWriter struct {
+	level            int
+	frameSize        int
+	buffer           []byte
+	dstBuffer        []byte
+	entries          []seekEntry
+	firstError       error
+	underlyingWriter io.Writer
+}
+
+// NewSeekableWriter creates a SeekableWriter compressing frames of frameSize
+// uncompressed bytes at level.  A frameSize of 0 uses DefaultSeekableFrameSize.
+// You MUST call Close to write the last frame and the seek table.
+func NewSeekableWriter(w io.Writer, level int, frameSize int) *SeekableWriter {
+	if frameSize <= 0 {
+		frameSize = DefaultSeekableFrameSize
+	}
+	if uint64(frameSize) > maxSeekableFrameSize {
+		frameSize = maxSeekableFrameSize
+	}
+	return &SeekableWriter{
+		level:            level,
+		frameSize:        frameSize,
+		underlyingWriter: w,
+	}
+}
+
+// Write buffers p and writes out every frame it completes.
+func (w *SeekableWriter) Write(p []byte) (int, error) {
+	if w.firstError != nil {
+		return 0, w.firstError
+	}
+	written := 0
+	for len(p) > 0 {
+		// Complete frames are compressed straight from p
+		if len(w.buffer) == 0 && len(p) >= w.frameSize {
+			if err := w.writeFrame(p[:w.frameSize]); err != nil {
+				return written, err
+			}
+			p = p[w.frameSize:]
+			written += w.frameSize
+			continue
+		}
+		n := w.frameSize - len(w.buffer)
+		if n > len(p) {
+			n = len(p)
+		}
+		w.buffer = append(w.buffer, p[:n]...)
+		p = p[n:]
+		written += n
+		if len(w.buffer) == w.frameSize {
+			if err := w.writeFrame(w.buffer); err != nil {
+				return written, err
+			}
+			w.buffer = w.buffer[:0]
+		}
+	}
+	return written, nil
+}
+
+// Close writes the last frame and the seek table.  It does not close the
+// underlying writer.
+func (w *SeekableWriter) Close() error {
+	if w.firstError != nil {
+		if w.firstError == errWriterClosed {
+			return nil
+		}
+		return w.firstError
+	}
+	if len(w.buffer) > 0 {
+		if err := w.writeFrame(w.buffer); err != nil {
+			return err
+		}
+		w.buffer = nil
+	}
+
+	table := make([]byte, 8, 8+12*len(w.entries)+seekTableFooterSize)
+	binary.LittleEndian.PutUint32(table[0:], seekTableMagic)
+	binary.LittleEndian.PutUint32(table[4:], uint32(cap(table)-8))
+	var entry [12]byte
+	for _, e := range w.entries {
+		binary.LittleEndian.PutUint32(entry[0:], e.compressedSize)
+		binary.LittleEndian.PutUint32(entry[4:], e.decompressedSize)
+		binary.LittleEndian.PutUint32(entry[8:], e.checksum)
+		table = append(table, entry[:]...)
+	}
+	var footer [seekTableFooterSize]byte
+	binary.LittleEndian.PutUint32(footer[0:], uint32(len(w.entries)))
+	footer[4] = seekChecksumFlag
+	binary.LittleEndian.PutUint32(footer[5:], seekableMagic)
+	table = append(table, footer[:]...)
+
+	if _, err := w.underlyingWriter.Write(table); err != nil {
+		w.firstError = err
+		return err
+	}
+	w.firstError = errWriterClosed
+	w.dstBuffer = nil
+	return nil
+}
+
+// writeFrame compresses src as an independent frame and records it
+func (w *SeekableWriter) writeFrame(src []byte) error {
+	if uint64(len(w.entries)) >= maxSeekableFrameSize {
+		w.firstError = fmt.Errorf("too many frames in seekable stream")
+		return w.firstError
+	}
+	compressed, err := CompressLevel(w.dstBuffer, src, w.level)
+	if err != nil {
+		w.firstError = err
+		return err
+	}
+	w.dstBuffer = compressed[:0]
+	if _, err := w.underlyingWriter.Write(compressed); err != nil {
+		w.firstError = err
+		return err
+	}
+	w.entries = append(w.entries, seekEntry{
+		compressedSize:   uint32(len(compressed)),
+		decompressedSize: uint32(len(src)),
+		checksum:         seekableChecksum(src),
+	})
+	return nil
+}
+
+// SeekableReader gives random access to data written in the seekable format.
+// It implements io.ReaderAt, io.Reader and io.Seeker over the decompressed
+// content, and decompresses only the frames a read overlaps.  The most
+// recently used frames are cached so that small neighbouring reads do not
+// decompress the same frame again.
+//
+// ReadAt is safe for concurrent use; Read and Seek share an offset and are not.
+type SeekableReader struct {
+	underlyingReader io.ReaderAt
+	checksums        []uint32
+	// Offsets of the start of every frame, plus the end of the last one
+	compressedOffsets   []int64
+	decompressedOffsets []int64
+	checksumFlag        bool
+	offset              int64
+
+	mu    sync.Mutex
+	cache []seekableCacheEntry
+	clock uint64
+}
+
+type seekableCacheEntry struct {
+	frame int
+	data  []byte
+	used  uint64
+}
+
+// NewSeekableReader reads the seek table at the end of r, which holds size
+// bytes of seekable zstd data.  It is the caller's responsibility to keep r
+// open while the SeekableReader is used.
+func NewSeekableReader(r io.ReaderAt, size int64) (*SeekableReader, error) {
+	if size < 8+seekTableFooterSize {
+		return nil, ErrInvalidSeekTable
+	}
+	var footer [seekTableFooterSize]byte
+	if _, err := r.ReadAt(footer[:], size-seekTableFooterSize); err != nil {
+		return nil, err
+	}
+	if binary.LittleEndian.Uint32(footer[5:]) != seekableMagic || footer[4]&0x7c != 0 {
+		return nil, ErrInvalidSeekTable
+	}
+	frames := int64(binary.LittleEndian.Uint32(footer[0:]))
+	checksumFlag := footer[4]&seekChecksumFlag != 0
+	entrySize := int64(8)
+	if checksumFlag {
+		entrySize = 12
+	}
+	tableSize := 8 + frames*entrySize + seekTableFooterSize
+	if tableSize > size {
+		return nil, ErrInvalidSeekTable
+	}
+	table := make([]byte, tableSize-seekTableFooterSize)
+	if _, err := r.ReadAt(table, size-tableSize); err != nil {
+		return nil, err
+	}
+	if binary.LittleEndian.Uint32(table[0:]) != seekTableMagic ||
+		int64(binary.LittleEndian.Uint32(table[4:])) != tableSize-8 {
+		return nil, ErrInvalidSeekTable
+	}
+
+	sr := &SeekableReader{
+		underlyingReader:    r,
+		compressedOffsets:   make([]int64, frames+1),
+		decompressedOffsets: make([]int64, frames+1),
+		checksumFlag:        checksumFlag,
+		cache:               make([]seekableCacheEntry, 0, defaultSeekableCacheFrames),
+	}
+	if checksumFlag {
+		sr.checksums = make([]uint32, frames)
+	}
+	entries := table[8:]
+	for i := int64(0); i < frames; i++ {
+		e := entries[i*entrySize:]
+		sr.compressedOffsets[i+1] = sr.compressedOffsets[i] + int64(binary.LittleEndian.Uint32(e[0:]))
+		sr.decompressedOffsets[i+1] = sr.decompressedOffsets[i] + int64(binary.LittleEndian.Uint32(e[4:]))
+		if checksumFlag {
+			sr.checksums[i] = binary.LittleEndian.Uint32(e[8:])
+		}
+	}
+	// The frames must exactly fill the data before the seek table
+	if sr.compressedOffsets[frames] != size-tableSize {
+		return nil, ErrInvalidSeekTable
+	}
+	return sr, nil
+}
+
+// Size returns the size of the decompressed content.
+func (r *SeekableReader) Size() int64 {
+	return r.decompressedOffsets[len(r.decompressedOffsets)-1]
+}
+
+// NumFrames returns the number of frames in the seekable data.
+func (r *SeekableReader) NumFrames() int {
+	return len(r.decompressedOffsets) - 1
+}
+
+// ReadAt reads len(p) bytes of decompressed content starting at off.
+func (r *SeekableReader) ReadAt(p []byte, off int64) (int, error) {
+	if off < 0 {
+		return 0, errNegativeOffset
+	}
+	if off >= r.Size() {
+		return 0, io.EOF
+	}
+	// Find the last frame starting at or before off
+	frame := sort.Search(r.NumFrames(), func(i int) bool {
+		return r.decompressedOffsets[i+1] > off
+	})
+	got := 0
+	for got < len(p) && frame < r.NumFrames() {
+		n, err := r.readFrame(frame, p[got:], off+int64(got)-r.decompressedOffsets[frame])
+		got += n
+		if err != nil {
+			return got, err
+		}
+		frame++
+	}
+	if got < len(p) {
+		return got, io.EOF
+	}
+	return got, nil
+}
+
+// Read implements io.Reader, reading from the current offset.
+func (r *SeekableReader) Read(p []byte) (int, error) {
+	n, err := r.ReadAt(p, r.offset)
+	r.offset += int64(n)
+	if err == io.EOF && n > 0 {
+		err = nil
+	}
+	return n, err
+}
+
+// Seek implements io.Seeker over the decompressed content.
+func (r *SeekableReader) Seek(offset int64, whence int) (int64, error) {
+	switch whence {
+	case io.SeekStart:
+	case io.SeekCurrent:
+		offset += r.offset
+	case io.SeekEnd:
+		offset += r.Size()
+	default:
+		return r.offset, fmt.Errorf("invalid whence: %d", whence)
+	}
+	if offset < 0 {
+		return r.offset, errNegativeOffset
+	}
+	r.offset = offset
+	return offset, nil
+}
+
+// Close drops the cached frames.  It does not close the underlying reader.
+func (r *SeekableReader) Close() error {
+	r.mu.Lock()
+	r.cache = r.cache[:0]
+	r.mu.Unlock()
+	return nil
+}
+
+// readFrame copies the content of frame from off into p
+func (r *SeekableReader) readFrame(frame int, p []byte, off int64) (int, error) {
+	r.mu.Lock()
+	for i := range r.cache {
+		if e := &r.cache[i]; e.frame == frame {
+			r.clock++
+			e.used = r.clock
+			n := copy(p, e.data[off:])
+			r.mu.Unlock()
+			return n, nil
+		}
+	}
+	r.mu.Unlock()
+
+	// Decompress outside of the lock so that concurrent ReadAt calls on
+	// different frames proceed in parallel
+	data, err := r.decompressFrame(frame)
+	if err != nil {
+		return 0, err
+	}
+	n := copy(p, data[off:])
+
+	r.mu.Lock()
+	r.clock++
+	entry := seekableCacheEntry{frame: frame, data: data, used: r.clock}
+	slot := -1
+	for i := range r.cache {
+		if r.cache[i].frame == frame { // decompressed by a concurrent ReadAt
+			slot = i
+			break
+		}
+		if slot < 0 || r.cache[i].used < r.cache[slot].used {
+			slot = i
+		}
+	}
+	if len(r.cache) < cap(r.cache) && (slot < 0 || r.cache[slot].frame != frame) {
+		r.cache = append(r.cache, entry)
+	} else {
+		r.cache[slot] = entry
+	}
+	r.mu.Unlock()
+	return n, nil
+}
+
+func (r *SeekableReader) decompressFrame(frame int) ([]byte, error) {
+	start, end := r.compressedOffsets[frame], r.compressedOffsets[frame+1]
+	size := r.decompressedOffsets[frame+1] - r.decompressedOffsets[frame]
+	src := make([]byte, end-start)
+	if n, err := r.underlyingReader.ReadAt(src, start); n < len(src) {
+		if err == io.EOF {
+			err = io.ErrUnexpectedEOF
+		}
+		return nil, err
+	}
+	dst, err := Decompress(make([]byte, size), src)
+	if err != nil {
+		return nil, err
+	}
+	if int64(len(dst)) != size {
+		return nil, fmt.Errorf("frame %d decompressed to %d bytes instead of %d", frame, len(dst), size)
+	}
+	if r.checksumFlag && seekableChecksum(dst) != r.checksums[frame] {
+		return nil, ErrSeekableChecksum
+	}
+	return dst, nil
+}
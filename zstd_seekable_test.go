@@ -0,0 +1,247 @@
+package zstd1
+
+import (
+	"bytes"
+	"fmt"
+	"io"
+	"io/ioutil"
+	"math/rand"
+	"sync"
+	"testing"
+)
+
+func writeSeekable(t testing.TB, payload []byte, frameSize int, chunk int) []byte {
+	var buf bytes.Buffer
+	w := NewSeekableWriter(&buf, DefaultCompression, frameSize)
+	for off := 0; off < len(payload); off += chunk {
+		end := off + chunk
+		if end > len(payload) {
+			end = len(payload)
+		}
+		if _, err := w.Write(payload[off:end]); err != nil {
+			t.Fatalf("Failed writing to seekable writer: %s", err)
+		}
+	}
+	if err := w.Close(); err != nil {
+		t.Fatalf("Failed to close seekable writer: %s", err)
+	}
+	if err := w.Close(); err != nil {
+		t.Fatalf("Failed to close seekable writer twice: %s", err)
+	}
+	return buf.Bytes()
+}
+
+func TestSeekableRoundtrip(t *testing.T) {
+	payload := makePayload(1 << 20)
+	// Write sizes below, equal to and above the frame size
+	for _, chunk := range []int{1000, 64 << 10, 200 << 10} {
+		compressed := writeSeekable(t, payload, 64<<10, chunk)
+
+		// The seek table is a skippable frame, so the output is a plain stream
+		decompressed, err := Decompress(nil, compressed)
+		failOnError(t, "Failed to decompress seekable data", err)
+		if !bytes.Equal(payload, decompressed) {
+			t.Fatalf("Payload did not match, lengths: %v & %v", len(payload), len(decompressed))
+		}
+
+		r, err := NewSeekableReader(bytes.NewReader(compressed), int64(len(compressed)))
+		failOnError(t, "Failed to open seekable data", err)
+		if r.Size() != int64(len(payload)) || r.NumFrames() != 16 {
+			t.Fatalf("Unexpected size %v or frames %v", r.Size(), r.NumFrames())
+		}
+		decompressed, err = ioutil.ReadAll(r)
+		failOnError(t, "Failed to read seekable data", err)
+		failOnError(t, "Failed to close seekable reader", r.Close())
+		if !bytes.Equal(payload, decompressed) {
+			t.Fatalf("Payload did not match, lengths: %v & %v", len(payload), len(decompressed))
+		}
+	}
+}
+
+func TestSeekableReadAt(t *testing.T) {
+	payload := makePayload(1 << 20)
+	compressed := writeSeekable(t, payload, 10000, 1<<20)
+	r, err := NewSeekableReader(bytes.NewReader(compressed), int64(len(compressed)))
+	failOnError(t, "Failed to open seekable data", err)
+
+	rng := rand.New(rand.NewSource(1))
+	for i := 0; i < 500; i++ {
+		off := rng.Int63n(int64(len(payload)))
+		buf := make([]byte, rng.Intn(30000))
+		n, err := r.ReadAt(buf, off)
+		want := payload[off:]
+		if len(want) > len(buf) {
+			want = want[:len(buf)]
+		}
+		if n != len(want) || !bytes.Equal(buf[:n], want) {
+			t.Fatalf("ReadAt(%v, %v) returned %v bytes that did not match", len(buf), off, n)
+		}
+		if n < len(buf) && err != io.EOF {
+			t.Fatalf("Short ReadAt should return io.EOF, got %s", err)
+		} else if n == len(buf) && err != nil {
+			t.Fatalf("Failed to ReadAt: %s", err)
+		}
+	}
+	if _, err := r.ReadAt(make([]byte, 1), int64(len(payload))); err != io.EOF {
+		t.Fatalf("Did not get io.EOF reading at the end: %s", err)
+	}
+	if _, err := r.ReadAt(make([]byte, 1), -1); err == nil {
+		t.Fatalf("Negative offset should fail")
+	}
+}
+
+func TestSeekableSeek(t *testing.T) {
+	payload := makePayload(300 << 10)
+	compressed := writeSeekable(t, payload, 32<<10, 4096)
+	r, err := NewSeekableReader(bytes.NewReader(compressed), int64(len(compressed)))
+	failOnError(t, "Failed to open seekable data", err)
+
+	buf := make([]byte, 100)
+	for _, seek := range []struct {
+		offset int64
+		whence int
+		want   int64
+	}{
+		{1000, io.SeekStart, 1000},
+		{50000, io.SeekCurrent, 51100},
+		{-100, io.SeekEnd, int64(len(payload)) - 100},
+		{0, io.SeekStart, 0},
+	} {
+		pos, err := r.Seek(seek.offset, seek.whence)
+		failOnError(t, "Failed to seek", err)
+		if pos != seek.want {
+			t.Fatalf("Seek returned %v, expected %v", pos, seek.want)
+		}
+		_, err = io.ReadFull(r, buf)
+		failOnError(t, "Failed to read after seek", err)
+		if !bytes.Equal(buf, payload[pos:pos+100]) {
+			t.Fatalf("Data at %v did not match", pos)
+		}
+	}
+	if _, err := r.Seek(-1, io.SeekStart); err == nil {
+		t.Fatalf("Seeking before the start should fail")
+	}
+}
+
+func TestSeekableConcurrentReadAt(t *testing.T) {
+	payload := makePayload(1 << 20)
+	compressed := writeSeekable(t, payload, 16<<10, 1<<20)
+	r, err := NewSeekableReader(bytes.NewReader(compressed), int64(len(compressed)))
+	failOnError(t, "Failed to open seekable data", err)
+
+	var wg sync.WaitGroup
+	errs := make(chan error, 16)
+	for g := 0; g < 16; g++ {
+		wg.Add(1)
+		go func(g int) {
+			defer wg.Done()
+			rng := rand.New(rand.NewSource(int64(g)))
+			buf := make([]byte, 4096)
+			for i := 0; i < 200; i++ {
+				off := rng.Int63n(int64(len(payload) - len(buf)))
+				if _, err := r.ReadAt(buf, off); err != nil {
+					errs <- err
+					return
+				}
+				if !bytes.Equal(buf, payload[off:off+int64(len(buf))]) {
+					errs <- fmt.Errorf("data at %v did not match", off)
+					return
+				}
+			}
+		}(g)
+	}
+	wg.Wait()
+	close(errs)
+	for err := range errs {
+		t.Fatal(err)
+	}
+}
+
+func TestSeekableEmpty(t *testing.T) {
+	compressed := writeSeekable(t, nil, 0, 1)
+	r, err := NewSeekableReader(bytes.NewReader(compressed), int64(len(compressed)))
+	failOnError(t, "Failed to open seekable data", err)
+	if r.Size() != 0 || r.NumFrames() != 0 {
+		t.Fatalf("Unexpected size %v or frames %v", r.Size(), r.NumFrames())
+	}
+	if _, err := r.Read(make([]byte, 10)); err != io.EOF {
+		t.Fatalf("Did not get io.EOF: %s", err)
+	}
+}
+
+func TestSeekableInvalid(t *testing.T) {
+	payload := makePayload(100 << 10)
+	plain, err := Compress(nil, payload)
+	failOnError(t, "Failed to compress", err)
+	if _, err := NewSeekableReader(bytes.NewReader(plain), int64(len(plain))); err != ErrInvalidSeekTable {
+		t.Fatalf("Did not get the correct error: %s", err)
+	}
+
+	compressed := writeSeekable(t, payload, 10000, 1<<20)
+	truncated := compressed[1:]
+	if _, err := NewSeekableReader(bytes.NewReader(truncated), int64(len(truncated))); err != ErrInvalidSeekTable {
+		t.Fatalf("Did not get the correct error: %s", err)
+	}
+
+	// Corrupt a checksum
+	corrupted := append([]byte{}, compressed...)
+	corrupted[len(corrupted)-seekTableFooterSize-1] ^= 0xff
+	r, err := NewSeekableReader(bytes.NewReader(corrupted), int64(len(corrupted)))
+	failOnError(t, "Failed to open seekable data", err)
+	if _, err := r.ReadAt(make([]byte, 10), r.Size()-10); err != ErrSeekableChecksum {
+		t.Fatalf("Did not get the correct error: %s", err)
+	}
+}
+
+func BenchmarkSeekableRandomRead(b *testing.B) {
+	payload := makePayload(16 << 20)
+	const readSize = 4 << 10
+	for _, frameSize := range []int{16 << 10, 64 << 10, 256 << 10, 1 << 20} {
+		compressed := writeSeekable(b, payload, frameSize, 1<<20)
+		b.Run(fmt.Sprintf("Frame/%d", frameSize), func(b *testing.B) {
+			r, err := NewSeekableReader(bytes.NewReader(compressed), int64(len(compressed)))
+			if err != nil {
+				b.Fatalf("Failed to open seekable data: %s", err)
+			}
+			rng := rand.New(rand.NewSource(1))
+			buf := make([]byte, readSize)
+			b.SetBytes(readSize)
+			b.ResetTimer()
+			for i := 0; i < b.N; i++ {
+				if _, err := r.ReadAt(buf, rng.Int63n(int64(len(payload)-readSize))); err != nil {
+					b.Fatalf("Failed to read: %s", err)
+				}
+			}
+		})
+	}
+	// Baseline: decompressing the whole payload to read a range
+	plain, err := Compress(nil, payload)
+	if err != nil {
+		b.Fatalf("Failed compressing: %s", err)
+	}
+	b.Run("Decompress", func(b *testing.B) {
+		dst := make([]byte, len(payload))
+		b.SetBytes(readSize)
+		for i := 0; i < b.N; i++ {
+			if _, err := Decompress(dst, plain); err != nil {
+				b.Fatalf("Failed decompressing: %s", err)
+			}
+		}
+	})
+}
+
+func BenchmarkSeekableSequentialRead(b *testing.B) {
+	payload := makePayload(16 << 20)
+	compressed := writeSeekable(b, payload, DefaultSeekableFrameSize, 1<<20)
+	buf := make([]byte, 4<<10)
+	b.SetBytes(int64(len(payload)))
+	for i := 0; i < b.N; i++ {
+		r, err := NewSeekableReader(bytes.NewReader(compressed), int64(len(compressed)))
+		if err != nil {
+			b.Fatalf("Failed to open seekable data: %s", err)
+		}
+		if _, err := io.CopyBuffer(ioutil.Discard, struct{ io.Reader }{r}, buf); err != nil {
+			b.Fatalf("Failed to read: %s", err)
+		}
+	}
+}
@@ -2,29 +2,82 @@ package zstd1
 
 /*
 #define ZSTD1_STATIC_LINKING_ONLY
-#define ZBUFF1_DISABLE_DEPRECATE_WARNINGS
 #include "zstd.h"
-#include "zbuff.h"
+#include "stdint.h"  // for uintptr_t
+
+// See zstd_ctx.go for why these *_wrapper functions take uintptr_t.  The
+// streaming wrappers also report positions through a result struct owned by
+// the Go caller, as ZSTD1_inBuffer/ZSTD1_outBuffer would hold Go pointers.
+// They take the context as an integer too: cgo checks C pointers to
+// incomplete types by boxing them, which allocates on every call, and a
+// stream reused with Reset should not allocate at all.
+
+typedef struct stream_result_s {
+	size_t return_code;
+	size_t bytes_consumed;
+	size_t bytes_written;
+} stream_result;
+
+static void ZSTD1_compress_generic_wrapper(stream_result* result, uintptr_t cctx, uintptr_t dst, size_t maxDstSize, const uintptr_t src, size_t srcSize, ZSTD1_EndDirective endOp) {
+	ZSTD1_outBuffer outBuffer = { (void*)dst, maxDstSize, 0 };
+	ZSTD1_inBuffer inBuffer = { (const void*)src, srcSize, 0 };
+	result->return_code = ZSTD1_compress_generic((ZSTD1_CCtx*)cctx, &outBuffer, &inBuffer, endOp);
+	result->bytes_consumed = inBuffer.pos;
+	result->bytes_written = outBuffer.pos;
+}
+
+static void ZSTD1_decompressStream_wrapper(stream_result* result, uintptr_t zds, uintptr_t dst, size_t maxDstSize, const uintptr_t src, size_t srcSize) {
+	ZSTD1_outBuffer outBuffer = { (void*)dst, maxDstSize, 0 };
+	ZSTD1_inBuffer inBuffer = { (const void*)src, srcSize, 0 };
+	result->return_code = ZSTD1_decompressStream((ZSTD1_DStream*)zds, &outBuffer, &inBuffer);
+	result->bytes_consumed = inBuffer.pos;
+	result->bytes_written = outBuffer.pos;
+}
+
+static size_t ZSTD1_resetDStream_wrapper(uintptr_t zds) {
+	return ZSTD1_resetDStream((ZSTD1_DStream*)zds);
+}
 */
 import "C"
 import (
 	"errors"
 	"fmt"
 	"io"
+	"runtime"
+	"time"
 	"unsafe"
 )
 
-var errShortRead = errors.New("short read")
+var (
+	errShortRead    = errors.New("short read")
+	errWriterClosed = errors.New("writer is closed")
+)
 
 // Writer is an io.WriteCloser that zstd-compresses its input.
+//
+// Small writes are accumulated until a full block is available, so that the
+// block sizes, and the writes to the underlying io.Writer, do not depend on
+// how the input was split.  Use Flush to force buffered data out.
+//
+// A Writer can be reused for another stream with Reset, which keeps its C
+// context and buffers.
 type Writer struct {
 	CompressionLevel int
 
 	ctx              *C.ZSTD1_CCtx
+	params           Params
 	dict             []byte
+	cdict            *CompressionDict
+	srcBuffer        []byte
 	dstBuffer        []byte
 	firstError       error
 	underlyingWriter io.Writer
+	result           C.stream_result
+	workers          int
+	adapt            *adaptiveLevel
+	frameOpen        bool // input was handed to zstd since the last frame ended
+	closed           bool
+	reusable         bool // Close keeps ctx for Reset
 }
 
 func resize(in []byte, newSize int) []byte {
@@ -58,31 +111,126 @@ func NewWriterLevel(w io.Writer, level int) *Writer {
 // compress with.  If the dictionary is empty or nil it is ignored. The dictionary
 // should not be modified until the writer is closed.
 func NewWriterLevelDict(w io.Writer, level int, dict []byte) *Writer {
-	var err error
-	ctx := C.ZSTD1_createCCtx()
+	return newWriter(w, Params{Level: level}, 0, dict, nil)
+}
 
-	if dict == nil {
-		err = getError(int(C.ZSTD1_compressBegin(ctx,
-			C.int(level))))
-	} else {
-		err = getError(int(C.ZSTD1_compressBegin_usingDict(
-			ctx,
-			unsafe.Pointer(&dict[0]),
-			C.size_t(len(dict)),
-			C.int(level))))
-	}
+// NewWriterCompressionDict is like NewWriterLevelDict but compresses with a
+// prepared dictionary, at the level the dictionary was created with.  This
+// avoids digesting the dictionary again for every stream.  The dictionary must
+// not be closed until the writer is closed.
+func NewWriterCompressionDict(w io.Writer, dict *CompressionDict) *Writer {
+	return newWriter(w, Params{Level: dict.level}, 0, nil, dict)
+}
+
+// NewWriterParallel is like NewWriterLevel but compresses with the given
+// number of worker threads.  Input is cut into jobs of at least 1 MB that are
+// compressed concurrently into a single frame, so Write returns as soon as
+// its input has been handed to the workers.  A workers value of 0 compresses
+// in the calling goroutine like NewWriterLevel.
+func NewWriterParallel(w io.Writer, level int, workers int) *Writer {
+	return newWriter(w, Params{Level: level}, workers, nil, nil)
+}
 
-	return &Writer{
-		CompressionLevel: level,
-		ctx:              ctx,
+func newWriter(w io.Writer, p Params, workers int, dict []byte, cdict *CompressionDict) *Writer {
+	zw := &Writer{
+		CompressionLevel: p.Level,
+		params:           p,
 		dict:             dict,
-		dstBuffer:        make([]byte, CompressBound(1024)),
-		firstError:       err,
+		cdict:            cdict,
+		srcBuffer:        make([]byte, 0, int(C.ZSTD1_CStreamInSize())),
+		dstBuffer:        make([]byte, int(C.ZSTD1_CStreamOutSize())),
 		underlyingWriter: w,
+		workers:          workers,
 	}
+	zw.firstError = zw.init()
+	return zw
 }
 
-// Write writes a compressed form of p to the underlying io.Writer.
+// init creates the C context of w and applies its settings
+func (w *Writer) init() error {
+	w.ctx = C.ZSTD1_createCCtx()
+	if w.ctx == nil {
+		return ErrContextAllocation
+	}
+	err := setParams(w.ctx, w.params)
+	if err == nil && w.workers > 0 {
+		err = getError(int(C.ZSTD1_CCtx_setParameter(w.ctx, C.ZSTD1_p_nbWorkers, C.uint(w.workers))))
+	}
+	if err == nil && w.adapt != nil {
+		err = w.adaptiveParams()
+	}
+	if err == nil {
+		err = w.loadDict()
+	}
+	return err
+}
+
+// loadDict sets the dictionary of w on its context
+func (w *Writer) loadDict() error {
+	if len(w.dict) > 0 {
+		return getError(int(C.ZSTD1_CCtx_loadDictionary(
+			w.ctx,
+			unsafe.Pointer(&w.dict[0]),
+			C.size_t(len(w.dict)))))
+	}
+	if w.cdict != nil {
+		err := getError(int(C.ZSTD1_CCtx_setParameter(w.ctx, C.ZSTD1_p_forceAttachDict, C.uint(w.cdict.attach))))
+		if err != nil {
+			return err
+		}
+		return getError(int(C.ZSTD1_CCtx_refCDict(w.ctx, w.cdict.cdict)))
+	}
+	return nil
+}
+
+// Reset discards the state of the Writer, including data not yet written,
+// and makes it equivalent to a new Writer created with the same options but
+// writing to writer.  The C context and buffers are reused, so pooling Writers
+// and resetting them for every stream, like gzip.Writer, saves allocating
+// them: the context of a high level or with workers takes megabytes.
+//
+// Once a Writer has been Reset, Close ends the frame but keeps the C context
+// for the next Reset, and the context is freed when the Writer is garbage
+// collected.  A Writer that was closed before its first Reset gets a new
+// context.
+func (w *Writer) Reset(writer io.Writer) {
+	w.underlyingWriter = writer
+	w.srcBuffer = w.srcBuffer[:0]
+	w.closed = false
+	if !w.reusable {
+		w.reusable = true
+		runtime.SetFinalizer(w, (*Writer).free)
+	}
+	if w.adapt != nil {
+		w.adapt.reset()
+	}
+	if w.firstError != nil && w.firstError != errWriterClosed {
+		// The error may come from the settings: start over with a new context
+		w.free()
+	}
+	if w.ctx == nil {
+		w.CompressionLevel = w.params.Level
+		w.frameOpen = false
+		w.firstError = w.init()
+		return
+	}
+
+	var err error
+	if w.frameOpen {
+		// Drop the frame in progress.  This also drops the dictionary.
+		C.ZSTD1_CCtx_reset(w.ctx)
+		w.frameOpen = false
+		err = w.loadDict()
+	}
+	if err == nil && w.CompressionLevel != w.params.Level {
+		err = getError(int(C.ZSTD1_CCtx_setParameter(w.ctx, C.ZSTD1_p_compressionLevel, C.uint(w.params.Level))))
+	}
+	w.CompressionLevel = w.params.Level
+	w.firstError = err
+}
+
+// Write writes a compressed form of p to the underlying io.Writer.  Data may
+// be buffered until a full block is available, Flush or Close is called.
 func (w *Writer) Write(p []byte) (int, error) {
 	if w.firstError != nil {
 		return 0, w.firstError
@@ -90,79 +238,222 @@ func (w *Writer) Write(p []byte) (int, error) {
 	if len(p) == 0 {
 		return 0, nil
 	}
-	// Check if dstBuffer is enough
-	if len(w.dstBuffer) < CompressBound(len(p)) {
-		w.dstBuffer = make([]byte, CompressBound(len(p)))
+	if len(w.srcBuffer)+len(p) <= cap(w.srcBuffer) {
+		w.srcBuffer = append(w.srcBuffer, p...)
+		return len(p), nil
 	}
-
-	retCode := C.ZSTD1_compressContinue(
-		w.ctx,
-		unsafe.Pointer(&w.dstBuffer[0]),
-		C.size_t(len(w.dstBuffer)),
-		unsafe.Pointer(&p[0]),
-		C.size_t(len(p)))
-
-	if err := getError(int(retCode)); err != nil {
+	if err := w.compressBuffered(); err != nil {
 		return 0, err
 	}
-	written := int(retCode)
+	if len(p) < cap(w.srcBuffer) {
+		w.srcBuffer = append(w.srcBuffer, p...)
+		return len(p), nil
+	}
+	// Large writes are handed to zstd without going through srcBuffer
+	if err := w.compress(p); err != nil {
+		// Same behaviour as zlib, we can't know how much data we wrote, only
+		// if there was an error
+		return 0, err
+	}
+	return len(p), nil
+}
 
-	// Write to underlying buffer
-	_, err := w.underlyingWriter.Write(w.dstBuffer[:written])
+// ReadFrom implements io.ReaderFrom, reading r until EOF straight into the
+// writer's input buffer and compressing it.  It does not end the frame.
+func (w *Writer) ReadFrom(r io.Reader) (int64, error) {
+	if w.firstError != nil {
+		return 0, w.firstError
+	}
+	var read int64
+	for {
+		if len(w.srcBuffer) == cap(w.srcBuffer) {
+			if err := w.compressBuffered(); err != nil {
+				return read, err
+			}
+		}
+		n, err := r.Read(w.srcBuffer[len(w.srcBuffer):cap(w.srcBuffer)])
+		w.srcBuffer = w.srcBuffer[:len(w.srcBuffer)+n]
+		read += int64(n)
+		if err == io.EOF {
+			return read, nil
+		} else if err != nil {
+			return read, err
+		}
+	}
+}
 
-	// Same behaviour as zlib, we can't know how much data we wrote, only
-	// if there was an error
-	if err != nil {
-		return 0, err
+// Flush compresses any buffered data and writes it, as a complete block, to
+// the underlying io.Writer.  This is useful for stream protocols where the
+// peer needs to decode what has been written so far; flushing often hurts
+// the compression ratio.
+func (w *Writer) Flush() error {
+	if w.firstError != nil {
+		return w.firstError
 	}
-	return len(p), err
+	if err := w.compressBuffered(); err != nil {
+		return err
+	}
+	return w.drain(C.ZSTD1_e_flush)
 }
 
 // Close closes the Writer, flushing any unwritten data to the underlying
 // io.Writer and freeing objects, but does not close the underlying io.Writer.
 func (w *Writer) Close() error {
-	retCode := C.ZSTD1_compressEnd(
-		w.ctx,
-		unsafe.Pointer(&w.dstBuffer[0]),
-		C.size_t(len(w.dstBuffer)),
-		unsafe.Pointer(nil),
-		C.size_t(0))
-
-	if err := getError(int(retCode)); err != nil {
+	if w.ctx == nil || w.closed {
+		return nil
+	}
+	defer w.release()
+	if w.firstError != nil {
+		return w.firstError
+	}
+	if err := w.compressBuffered(); err != nil {
 		return err
 	}
-	written := int(retCode)
-	retCode = C.ZSTD1_freeCCtx(w.ctx) // Safely close buffer before writing the end
+	return w.drain(C.ZSTD1_e_end)
+}
 
-	if err := getError(int(retCode)); err != nil {
-		return err
+// release marks w closed and frees its context, unless it is kept for Reset
+func (w *Writer) release() {
+	w.closed = true
+	if w.firstError == nil {
+		w.firstError = errWriterClosed
+	}
+	if !w.reusable {
+		w.free()
+	}
+}
+
+func (w *Writer) free() {
+	C.ZSTD1_freeCCtx(w.ctx)
+	w.ctx = nil
+}
+
+// compressBuffered hands the content of srcBuffer to zstd.
+func (w *Writer) compressBuffered() error {
+	if len(w.srcBuffer) == 0 {
+		return nil
+	}
+	err := w.compress(w.srcBuffer)
+	w.srcBuffer = w.srcBuffer[:0]
+	return err
+}
+
+// compress feeds src to zstd, writing compressed output to the underlying
+// writer as it is produced.  Errors are sticky.
+func (w *Writer) compress(src []byte) error {
+	for len(src) > 0 {
+		var start time.Time
+		if w.adapt != nil {
+			start = time.Now()
+		}
+		C.ZSTD1_compress_generic_wrapper(
+			&w.result,
+			C.uintptr_t(uintptr(unsafe.Pointer(w.ctx))),
+			C.uintptr_t(uintptr(unsafe.Pointer(&w.dstBuffer[0]))),
+			C.size_t(len(w.dstBuffer)),
+			C.uintptr_t(uintptr(unsafe.Pointer(&src[0]))),
+			C.size_t(len(src)),
+			C.ZSTD1_e_continue)
+		runtime.KeepAlive(src)
+		w.frameOpen = true
+		consumed := int(w.result.bytes_consumed)
+		if w.adapt != nil {
+			w.adapt.compressTime += time.Since(start)
+			w.adapt.consumed += consumed
+		}
+		if err := w.writeResult(); err != nil {
+			return err
+		}
+		src = src[consumed:]
+		if w.adapt != nil {
+			if err := w.adjustLevel(); err != nil {
+				return err
+			}
+		}
+	}
+	return nil
+}
+
+// drain calls ZSTD1_compress_generic with endOp and no further input until
+// zstd reports that nothing is left to write.
+func (w *Writer) drain(endOp C.ZSTD1_EndDirective) error {
+	for {
+		C.ZSTD1_compress_generic_wrapper(
+			&w.result,
+			C.uintptr_t(uintptr(unsafe.Pointer(w.ctx))),
+			C.uintptr_t(uintptr(unsafe.Pointer(&w.dstBuffer[0]))),
+			C.size_t(len(w.dstBuffer)),
+			0,
+			0,
+			endOp)
+		if err := w.writeResult(); err != nil {
+			return err
+		}
+		if w.result.return_code == 0 {
+			if endOp == C.ZSTD1_e_end {
+				w.frameOpen = false
+			}
+			return nil
+		}
 	}
+}
 
-	_, err := w.underlyingWriter.Write(w.dstBuffer[:written])
-	if err != nil {
+// writeResult checks the result of the last zstd call and writes the output
+// it produced.
+func (w *Writer) writeResult() error {
+	if err := getError(int(w.result.return_code)); err != nil {
+		w.firstError = err
 		return err
 	}
+	written := int(w.result.bytes_written)
+	if written == 0 {
+		return nil
+	}
+	var start time.Time
+	if w.adapt != nil {
+		start = time.Now()
+	}
+	if _, err := w.underlyingWriter.Write(w.dstBuffer[:written]); err != nil {
+		w.firstError = err
+		return err
+	}
+	if w.adapt != nil {
+		w.adapt.writeTime += time.Since(start)
+		w.adapt.written += written
+	}
 	return nil
 }
 
 // reader is an io.ReadCloser that decompresses when read from.
 type reader struct {
-	ctx                 *C.ZBUFF1_DCtx
+	ctx                 *C.ZSTD1_DStream
 	compressionBuffer   []byte
-	compressionLeft     int
+	compressionOff      int
+	compressionSize     int
 	decompressionBuffer []byte
 	decompOff           int
 	decompSize          int
 	dict                []byte
+	ddict               *DecompressionDict
+	registry            *DictRegistry
+	windowLogMax        int
 	firstError          error
-	recommendedSrcSize  int
+	frameDone           bool
+	underlyingEOF       bool
 	underlyingReader    io.Reader
+	result              C.stream_result
+	closed              bool
+	reusable            bool // Close keeps ctx for Reset
 }
 
 // NewReader creates a new io.ReadCloser.  Reads from the returned ReadCloser
 // read and decompress data from r.  It is the caller's responsibility to call
 // Close on the ReadCloser when done.  If this is not done, underlying objects
 // in the zstd library will not be freed.
+//
+// The returned ReadCloser also implements io.WriterTo, so io.Copy decompresses
+// straight from the reader's internal buffer to the destination, and Resetter,
+// to be reused for another stream.
 func NewReader(r io.Reader) io.ReadCloser {
 	return NewReaderDict(r, nil)
 }
@@ -170,105 +461,304 @@ func NewReader(r io.Reader) io.ReadCloser {
 // NewReaderDict is like NewReader but uses a preset dictionary.  NewReaderDict
 // ignores the dictionary if it is nil.
 func NewReaderDict(r io.Reader, dict []byte) io.ReadCloser {
-	var err error
-	ctx := C.ZBUFF1_createDCtx()
-	if len(dict) == 0 {
-		err = getError(int(C.ZBUFF1_decompressInit(ctx)))
-	} else {
-		err = getError(int(C.ZBUFF1_decompressInitDictionary(
-			ctx,
-			unsafe.Pointer(&dict[0]),
-			C.size_t(len(dict)))))
-	}
-	cSize := int(C.ZBUFF1_recommendedDInSize())
-	dSize := int(C.ZBUFF1_recommendedDOutSize())
+	zr := newReader(r)
+	zr.dict = dict
+	zr.firstError = zr.init()
+	return zr
+}
+
+// NewReaderWindowLogMax is like NewReader but accepts frames with a window of
+// up to 1<<windowLogMax bytes, instead of the default 1<<27.  Larger windows
+// are written by Params with a higher WindowLog, and decoding them allocates
+// a buffer of the window size.
+func NewReaderWindowLogMax(r io.Reader, windowLogMax int) io.ReadCloser {
+	zr := newReader(r)
+	zr.windowLogMax = windowLogMax
+	zr.firstError = zr.init()
+	return zr
+}
+
+// NewReaderDecompressionDict is like NewReaderDict but uses a prepared
+// dictionary, which avoids digesting the dictionary again for every stream.
+// The dictionary must not be closed until the reader is closed.
+func NewReaderDecompressionDict(r io.Reader, dict *DecompressionDict) io.ReadCloser {
+	zr := newReader(r)
+	zr.ddict = dict
+	zr.firstError = zr.init()
+	return zr
+}
+
+func newReader(r io.Reader) *reader {
+	cSize := int(C.ZSTD1_DStreamInSize())
+	dSize := int(C.ZSTD1_DStreamOutSize())
 	if cSize <= 0 {
-		panic(fmt.Errorf("ZBUFF1_recommendedDInSize() returned invalid size: %v", cSize))
+		panic(fmt.Errorf("ZSTD1_DStreamInSize() returned invalid size: %v", cSize))
 	}
 	if dSize <= 0 {
-		panic(fmt.Errorf("ZBUFF1_recommendedDOutSize() returned invalid size: %v", dSize))
+		panic(fmt.Errorf("ZSTD1_DStreamOutSize() returned invalid size: %v", dSize))
 	}
 
-	compressionBuffer := make([]byte, cSize)
-	decompressionBuffer := make([]byte, dSize)
 	return &reader{
-		ctx:                 ctx,
-		dict:                dict,
-		compressionBuffer:   compressionBuffer,
-		decompressionBuffer: decompressionBuffer,
-		firstError:          err,
-		recommendedSrcSize:  cSize,
+		compressionBuffer:   make([]byte, cSize),
+		decompressionBuffer: make([]byte, dSize),
+		frameDone:           true,
 		underlyingReader:    r,
 	}
 }
 
-// Close frees the allocated C objects
+// init creates the C context of r and loads its dictionary
+func (r *reader) init() error {
+	if r.windowLogMax != 0 && (r.windowLogMax < C.ZSTD1_WINDOWLOG_MIN || r.windowLogMax > C.ZSTD1_WINDOWLOG_MAX) {
+		return errParamOutOfBound
+	}
+	r.ctx = C.ZSTD1_createDStream()
+	if r.ctx == nil {
+		return ErrContextAllocation
+	}
+	var err error
+	if r.registry != nil {
+		// The dictionary is picked when a frame starts
+		r.ddict = nil
+		err = getError(int(C.ZSTD1_initDStream(r.ctx)))
+	} else if r.ddict != nil {
+		err = getError(int(C.ZSTD1_initDStream_usingDDict(r.ctx, r.ddict.ddict)))
+	} else if len(r.dict) > 0 {
+		err = getError(int(C.ZSTD1_initDStream_usingDict(
+			r.ctx,
+			unsafe.Pointer(&r.dict[0]),
+			C.size_t(len(r.dict)))))
+	} else {
+		err = getError(int(C.ZSTD1_initDStream(r.ctx)))
+	}
+	if err == nil && r.windowLogMax != 0 {
+		err = getError(int(C.ZSTD1_DCtx_setMaxWindowSize(r.ctx, C.size_t(1)<<uint(r.windowLogMax))))
+	}
+	return err
+}
+
+// Resetter is implemented by the io.ReadCloser returned by NewReader and the
+// other NewReader* functions, like the one of compress/zlib.  Reset discards
+// the state of the reader and switches to decompressing from r, with the
+// same options.  The C context, with the dictionary loaded in it, and the
+// buffers are reused, so pooling readers and resetting them for every stream
+// saves allocating them.
+//
+// Once a reader has been Reset, Close keeps the C context for the next Reset,
+// and the context is freed when the reader is garbage collected.  A reader
+// that was closed before its first Reset gets a new context.
+type Resetter interface {
+	Reset(r io.Reader) error
+}
+
+// Reset implements Resetter
+func (r *reader) Reset(underlying io.Reader) error {
+	r.underlyingReader = underlying
+	r.compressionOff, r.compressionSize = 0, 0
+	r.decompOff, r.decompSize = 0, 0
+	r.frameDone, r.underlyingEOF, r.closed = true, false, false
+	if !r.reusable {
+		r.reusable = true
+		runtime.SetFinalizer(r, (*reader).free)
+	}
+	if r.firstError != nil && r.firstError != errReaderClosed {
+		// The error may come from the settings: start over with a new context
+		r.free()
+	}
+	if r.ctx == nil {
+		r.firstError = r.init()
+	} else {
+		r.firstError = getError(int(C.ZSTD1_resetDStream_wrapper(C.uintptr_t(uintptr(unsafe.Pointer(r.ctx))))))
+	}
+	return r.firstError
+}
+
+// Close frees the allocated C objects, unless the reader was Reset
 func (r *reader) Close() error {
-	return getError(int(C.ZBUFF1_freeDCtx(r.ctx)))
+	if r.ctx == nil || r.closed {
+		return nil
+	}
+	r.closed = true
+	if r.firstError == nil {
+		r.firstError = errReaderClosed
+	}
+	if r.reusable {
+		return nil
+	}
+	return r.free()
 }
 
-func (r *reader) Read(p []byte) (int, error) {
+func (r *reader) free() error {
+	err := getError(int(C.ZSTD1_freeDStream(r.ctx)))
+	r.ctx = nil
+	return err
+}
 
-	// If we already have enough bytes, return
-	if r.decompSize-r.decompOff >= len(p) {
-		copy(p, r.decompressionBuffer[r.decompOff:])
-		r.decompOff += len(p)
-		return len(p), nil
+func (r *reader) Read(p []byte) (int, error) {
+	if r.firstError != nil {
+		return 0, r.firstError
 	}
 
-	copy(p, r.decompressionBuffer[r.decompOff:r.decompSize])
-	got := r.decompSize - r.decompOff
-	r.decompSize = 0
-	r.decompOff = 0
+	// Hand out what is left from the previous call first
+	got := copy(p, r.decompressionBuffer[r.decompOff:r.decompSize])
+	r.decompOff += got
 
 	for got < len(p) {
-		// Populate src
-		src := r.compressionBuffer
-		reader := r.underlyingReader
-		n, err := TryReadFull(reader, src[r.compressionLeft:])
-		if err != nil && err != errShortRead { // Handle underlying reader errors first
-			return 0, fmt.Errorf("failed to read from underlying reader: %s", err)
-		} else if n == 0 && r.compressionLeft == 0 {
-			return got, io.EOF
+		// Large reads are decompressed straight into p, smaller ones go
+		// through decompressionBuffer as zstd needs room for a full block
+		direct := len(p)-got >= len(r.decompressionBuffer)
+		dst := r.decompressionBuffer
+		if direct {
+			dst = p[got:]
+		}
+		// Once some data was produced, only the buffered input is
+		// decompressed: reading more could block on a stream the peer
+		// merely flushed
+		n, err := r.decompress(dst, got == 0)
+		if err != nil {
+			return got, err
+		}
+		if direct {
+			got += n
+		} else {
+			r.decompSize = n
+			r.decompOff = copy(p[got:], dst[:n])
+			got += r.decompOff
+		}
+		if n == 0 {
+			if got > 0 {
+				return got, nil
+			}
+			return 0, io.EOF
+		}
+	}
+	return got, nil
+}
+
+// WriteTo implements io.WriterTo, decompressing into the reader's output
+// buffer and writing it to w until the underlying reader is exhausted.
+func (r *reader) WriteTo(w io.Writer) (int64, error) {
+	if r.firstError != nil {
+		return 0, r.firstError
+	}
+	var written int64
+
+	if r.decompOff < r.decompSize {
+		n, err := w.Write(r.decompressionBuffer[r.decompOff:r.decompSize])
+		written += int64(n)
+		r.decompOff += n
+		if err == nil && r.decompOff < r.decompSize {
+			err = io.ErrShortWrite
 		}
-		src = src[:r.compressionLeft+n]
+		if err != nil {
+			return written, err
+		}
+	}
 
-		// C code
-		cSrcSize := C.size_t(len(src))
-		cDstSize := C.size_t(len(r.decompressionBuffer))
-		retCode := int(C.ZBUFF1_decompressContinue(
-			r.ctx,
-			unsafe.Pointer(&r.decompressionBuffer[0]),
-			&cDstSize,
-			unsafe.Pointer(&src[0]),
-			&cSrcSize))
+	for {
+		n, err := r.decompress(r.decompressionBuffer, true)
+		if err != nil {
+			return written, err
+		}
+		if n == 0 && r.underlyingEOF {
+			return written, nil
+		}
+		nw, err := w.Write(r.decompressionBuffer[:n])
+		written += int64(nw)
+		if err == nil && nw < n {
+			err = io.ErrShortWrite
+		}
+		if err != nil {
+			// Keep what w did not take for the next Read or WriteTo
+			r.decompOff, r.decompSize = nw, n
+			return written, err
+		}
+	}
+}
 
-		if err = getError(retCode); err != nil {
-			return 0, fmt.Errorf("failed to decompress: %s", err)
+// decompress fills dst with as much decompressed data as zstd can produce from
+// the buffered input, reading from the underlying reader when more input is
+// needed and fill is set.  It returns 0 without error once the underlying
+// reader is exhausted and all frames are complete, or, without fill, once the
+// buffered input is.
+func (r *reader) decompress(dst []byte, fill bool) (int, error) {
+	for {
+		if r.frameDone && r.registry != nil && r.compressionOff < r.compressionSize {
+			// A new frame starts: pick its dictionary
+			err := r.selectDict(r.compressionBuffer[r.compressionOff:r.compressionSize])
+			if err == errIncompleteFrame && r.underlyingEOF {
+				return 0, io.ErrUnexpectedEOF
+			} else if err == errIncompleteFrame && !fill {
+				return 0, nil
+			} else if err == errIncompleteFrame {
+				if err := r.fill(); err != nil {
+					return 0, err
+				}
+				continue
+			} else if err != nil {
+				r.firstError = err
+				return 0, err
+			}
+		}
+		if r.compressionOff < r.compressionSize || !r.frameDone {
+			src := r.compressionBuffer[r.compressionOff:r.compressionSize]
+			var srcPtr uintptr
+			if len(src) > 0 {
+				srcPtr = uintptr(unsafe.Pointer(&src[0]))
+			}
+			C.ZSTD1_decompressStream_wrapper(
+				&r.result,
+				C.uintptr_t(uintptr(unsafe.Pointer(r.ctx))),
+				C.uintptr_t(uintptr(unsafe.Pointer(&dst[0]))),
+				C.size_t(len(dst)),
+				C.uintptr_t(srcPtr),
+				C.size_t(len(src)))
+			runtime.KeepAlive(dst)
+			retCode := int(r.result.return_code)
+			if err := getError(retCode); err != nil {
+				// The context is unusable until Reset
+				r.firstError = fmt.Errorf("failed to decompress: %s", err)
+				return 0, r.firstError
+			}
+			consumed := int(r.result.bytes_consumed)
+			written := int(r.result.bytes_written)
+			r.compressionOff += consumed
+			r.frameDone = retCode == 0
+			if written > 0 {
+				return written, nil
+			}
+			if consumed > 0 {
+				continue
+			}
 		}
 
-		// Put everything in buffer
-		if int(cSrcSize) < len(src) {
-			left := src[int(cSrcSize):]
-			copy(r.compressionBuffer, left)
+		// zstd needs more input
+		if r.underlyingEOF {
+			if !r.frameDone {
+				return 0, io.ErrUnexpectedEOF
+			}
+			return 0, nil
 		}
-		r.compressionLeft = len(src) - int(cSrcSize)
-		r.decompSize = int(cDstSize)
-		r.decompOff = copy(p[got:], r.decompressionBuffer[:r.decompSize])
-		got += r.decompOff
-
-		// Resize buffers
-		nsize := retCode // Hint for next src buffer size
-		if nsize <= 0 {
-			// Reset to recommended size
-			nsize = r.recommendedSrcSize
+		if !fill {
+			return 0, nil
 		}
-		if nsize < r.compressionLeft {
-			nsize = r.compressionLeft
+		if err := r.fill(); err != nil {
+			return 0, err
 		}
-		r.compressionBuffer = resize(r.compressionBuffer, nsize)
 	}
-	return got, nil
+}
+
+// fill reads more input from the underlying reader after the buffered input
+func (r *reader) fill() error {
+	r.compressionSize = copy(r.compressionBuffer, r.compressionBuffer[r.compressionOff:r.compressionSize])
+	r.compressionOff = 0
+	n, err := r.underlyingReader.Read(r.compressionBuffer[r.compressionSize:])
+	r.compressionSize += n
+	if err == io.EOF {
+		r.underlyingEOF = true
+	} else if err != nil {
+		return fmt.Errorf("failed to read from underlying reader: %s", err)
+	}
+	return nil
 }
 
 // TryReadFull reads buffer just as ReadFull does
@@ -3,8 +3,10 @@ package zstd1
 import (
 	"bytes"
 	"io"
+	"io/ioutil"
 	"runtime/debug"
 	"testing"
+	"time"
 )
 
 func failOnError(t *testing.T, msg string, err error) {
@@ -172,6 +174,314 @@ func BenchmarkStreamDecompression(b *testing.B) {
 	}
 }
 
+func TestStreamReadSizes(t *testing.T) {
+	payload := makePayload(1 << 20)
+	compressed, err := Compress(nil, payload)
+	failOnError(t, "Failed to compress", err)
+
+	// Mix reads below and above the direct decompression threshold
+	r := NewReader(bytes.NewReader(compressed))
+	var out bytes.Buffer
+	sizes := []int{1, 300 << 10, 7, 128 << 10, 64 << 10, 200 << 10}
+	for i := 0; out.Len() < len(payload); i++ {
+		buf := make([]byte, sizes[i%len(sizes)])
+		n, err := r.Read(buf)
+		out.Write(buf[:n])
+		if err == io.EOF {
+			break
+		}
+		failOnError(t, "Failed to decompress", err)
+	}
+	if !bytes.Equal(payload, out.Bytes()) {
+		t.Fatalf("Payload did not match, lengths: %v & %v", len(payload), out.Len())
+	}
+	n, err := r.Read(make([]byte, 10))
+	if err != io.EOF {
+		t.Fatalf("Error should have been EOF, was %s instead: (%v bytes read)", err, n)
+	}
+	failOnError(t, "Failed to close decompress object", r.Close())
+}
+
+func TestStreamWriteTo(t *testing.T) {
+	payload := makePayload(1 << 20)
+	compressed, err := Compress(nil, payload)
+	failOnError(t, "Failed to compress", err)
+
+	r := NewReader(bytes.NewReader(compressed))
+	if _, ok := r.(io.WriterTo); !ok {
+		t.Fatal("Reader does not implement io.WriterTo")
+	}
+	// Start with a partial read so WriteTo has to flush buffered output
+	head := make([]byte, 10)
+	_, err = r.Read(head)
+	failOnError(t, "Failed to decompress", err)
+	var out bytes.Buffer
+	out.Write(head)
+	n, err := io.Copy(&out, r)
+	failOnError(t, "Failed to copy", err)
+	if int(n) != len(payload)-len(head) {
+		t.Fatalf("Copied %v bytes, expected %v", n, len(payload)-len(head))
+	}
+	if !bytes.Equal(payload, out.Bytes()) {
+		t.Fatalf("Payload did not match, lengths: %v & %v", len(payload), out.Len())
+	}
+	failOnError(t, "Failed to close decompress object", r.Close())
+}
+
+// limitedWriter takes at most limit bytes, then fails
+type limitedWriter struct {
+	bytes.Buffer
+	limit int
+}
+
+func (w *limitedWriter) Write(p []byte) (int, error) {
+	if len(p) > w.limit {
+		n, _ := w.Buffer.Write(p[:w.limit])
+		w.limit = 0
+		return n, io.ErrShortWrite
+	}
+	w.limit -= len(p)
+	return w.Buffer.Write(p)
+}
+
+func TestStreamWriteToShortWrite(t *testing.T) {
+	payload := makePayload(1 << 20)
+	compressed, err := Compress(nil, payload)
+	failOnError(t, "Failed to compress", err)
+
+	r := NewReader(bytes.NewReader(compressed)).(io.WriterTo)
+	out := &limitedWriter{limit: 100000}
+	if _, err := r.WriteTo(out); err != io.ErrShortWrite {
+		t.Fatalf("Expected a short write, got %v", err)
+	}
+	// What the writer did not take is handed out by the next call
+	rest, err := ioutil.ReadAll(r.(io.Reader))
+	failOnError(t, "Failed to decompress the rest", err)
+	out.Buffer.Write(rest)
+	if !bytes.Equal(payload, out.Bytes()) {
+		t.Fatalf("Payload did not match, lengths: %v & %v", len(payload), out.Len())
+	}
+}
+
+func TestStreamCorruptedStaysFailed(t *testing.T) {
+	compressed, err := Compress(nil, makePayload(1<<20))
+	failOnError(t, "Failed to compress", err)
+	for i := 100; i < len(compressed); i += 50 {
+		compressed[i] ^= 0xFF
+	}
+	r := NewReader(bytes.NewReader(compressed))
+	_, err = ioutil.ReadAll(r)
+	if err == nil {
+		t.Fatal("Corrupted data did not fail to decompress")
+	}
+	if _, again := r.Read(make([]byte, 1024)); again != err {
+		t.Fatalf("Decompression error is not sticky: %v then %v", err, again)
+	}
+}
+
+func TestStreamConcatenatedFrames(t *testing.T) {
+	var compressed, expected bytes.Buffer
+	for i := 0; i < 5; i++ {
+		payload := makePayload(1000 * (i + 1))
+		frame, err := Compress(nil, payload)
+		failOnError(t, "Failed to compress", err)
+		compressed.Write(frame)
+		expected.Write(payload)
+	}
+	r := NewReader(&compressed)
+	out, err := ioutil.ReadAll(r)
+	failOnError(t, "Failed to decompress", err)
+	if !bytes.Equal(expected.Bytes(), out) {
+		t.Fatalf("Payload did not match, lengths: %v & %v", expected.Len(), len(out))
+	}
+	failOnError(t, "Failed to close decompress object", r.Close())
+}
+
+func TestStreamTruncated(t *testing.T) {
+	compressed, err := Compress(nil, makePayload(10000))
+	failOnError(t, "Failed to compress", err)
+	r := NewReader(bytes.NewReader(compressed[:len(compressed)/2]))
+	_, err = ioutil.ReadAll(r)
+	if err != io.ErrUnexpectedEOF {
+		t.Fatalf("Error should have been ErrUnexpectedEOF, was %v instead", err)
+	}
+	failOnError(t, "Failed to close decompress object", r.Close())
+}
+
+func BenchmarkStreamDecompressionCopy(b *testing.B) {
+	payload := makePayload(4 << 20)
+	compressed, err := Compress(nil, payload)
+	if err != nil {
+		b.Fatalf("Failed to compress: %s", err)
+	}
+	b.SetBytes(int64(len(payload)))
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		r := NewReader(bytes.NewReader(compressed))
+		if _, err := io.Copy(ioutil.Discard, r); err != nil {
+			b.Fatalf("Failed to decompress: %s", err)
+		}
+		r.Close()
+	}
+}
+
+// countingWriter counts the writes made to it
+type countingWriter struct {
+	bytes.Buffer
+	writes int
+}
+
+func (w *countingWriter) Write(p []byte) (int, error) {
+	w.writes++
+	return w.Buffer.Write(p)
+}
+
+func TestStreamSmallWritesAreBuffered(t *testing.T) {
+	var out countingWriter
+	w := NewWriter(&out)
+	payload := makePayload(1 << 20)
+	for i := 0; i < len(payload); i += 128 {
+		_, err := w.Write(payload[i : i+128])
+		failOnError(t, "Failed writing to compress object", err)
+	}
+	failOnError(t, "Failed to close compress object", w.Close())
+	// One write per 128 KB block at most, plus the frame epilogue
+	if out.writes > len(payload)/(128<<10)+2 {
+		t.Fatalf("Too many writes to the underlying writer: %v", out.writes)
+	}
+	decompressed, err := Decompress(nil, out.Bytes())
+	failOnError(t, "Failed to decompress", err)
+	if !bytes.Equal(payload, decompressed) {
+		t.Fatalf("Payload did not match, lengths: %v & %v", len(payload), len(decompressed))
+	}
+}
+
+func TestStreamFlush(t *testing.T) {
+	var out bytes.Buffer
+	w := NewWriter(&out)
+	r := NewReader(&out)
+	for i := 0; i < 5; i++ {
+		payload := makePayload(100 * (i + 1))
+		_, err := w.Write(payload)
+		failOnError(t, "Failed writing to compress object", err)
+		failOnError(t, "Failed to flush compress object", w.Flush())
+		// Everything written so far must be decodable before Close
+		dst := make([]byte, len(payload))
+		_, err = io.ReadFull(r, dst)
+		failOnError(t, "Failed to decompress flushed data", err)
+		if !bytes.Equal(payload, dst) {
+			t.Fatalf("Flushed payload did not match")
+		}
+	}
+	failOnError(t, "Failed to close compress object", w.Close())
+	failOnError(t, "Failed to close decompress object", r.Close())
+}
+
+// stallingReader returns its data, then blocks like a connection whose peer
+// is idle until release is closed
+type stallingReader struct {
+	data    []byte
+	release chan struct{}
+}
+
+func (r *stallingReader) Read(p []byte) (int, error) {
+	if len(r.data) == 0 {
+		<-r.release
+		return 0, io.EOF
+	}
+	n := copy(p, r.data)
+	r.data = r.data[n:]
+	return n, nil
+}
+
+func TestStreamReadFlushedWithoutBlocking(t *testing.T) {
+	payload := makePayload(500)
+	var out bytes.Buffer
+	w := NewWriter(&out)
+	_, err := w.Write(payload)
+	failOnError(t, "Failed writing to compress object", err)
+	failOnError(t, "Failed to flush compress object", w.Flush())
+
+	underlying := &stallingReader{data: out.Bytes(), release: make(chan struct{})}
+	defer close(underlying.release)
+	r := NewReader(underlying)
+	type result struct {
+		n   int
+		err error
+	}
+	done := make(chan result, 1)
+	dst := make([]byte, 64<<10)
+	go func() {
+		n, err := r.Read(dst)
+		done <- result{n, err}
+	}()
+	select {
+	case res := <-done:
+		failOnError(t, "Failed to decompress flushed data", res.err)
+		if !bytes.Equal(payload, dst[:res.n]) {
+			t.Fatalf("Flushed payload did not match, lengths: %v & %v", len(payload), res.n)
+		}
+	case <-time.After(5 * time.Second):
+		t.Fatal("Read blocked on the underlying reader after decompressing flushed data")
+	}
+}
+
+func TestStreamReadFrom(t *testing.T) {
+	payload := makePayload(1 << 20)
+	var out bytes.Buffer
+	w := NewWriter(&out)
+	// io.Copy uses ReadFrom when the destination implements it
+	n, err := io.Copy(w, bytes.NewReader(payload))
+	failOnError(t, "Failed to copy", err)
+	if int(n) != len(payload) {
+		t.Fatalf("Copied %v bytes, expected %v", n, len(payload))
+	}
+	failOnError(t, "Failed to close compress object", w.Close())
+	decompressed, err := Decompress(nil, out.Bytes())
+	failOnError(t, "Failed to decompress", err)
+	if !bytes.Equal(payload, decompressed) {
+		t.Fatalf("Payload did not match, lengths: %v & %v", len(payload), len(decompressed))
+	}
+}
+
+func TestStreamLargeWriteBoundedMemory(t *testing.T) {
+	w := NewWriter(ioutil.Discard)
+	dstSize, srcCap := len(w.dstBuffer), cap(w.srcBuffer)
+	_, err := w.Write(makePayload(16 << 20))
+	failOnError(t, "Failed writing to compress object", err)
+	if len(w.dstBuffer) != dstSize || cap(w.srcBuffer) != srcCap {
+		t.Fatalf("Writer buffers grew with the write size: %v, %v", len(w.dstBuffer), cap(w.srcBuffer))
+	}
+	failOnError(t, "Failed to close compress object", w.Close())
+}
+
+func TestStreamWriteAfterClose(t *testing.T) {
+	var out bytes.Buffer
+	w := NewWriter(&out)
+	failOnError(t, "Failed to close compress object", w.Close())
+	failOnError(t, "Failed to close compress object twice", w.Close())
+	if _, err := w.Write([]byte("Hello")); err == nil {
+		t.Fatal("Write after Close should fail")
+	}
+}
+
+func BenchmarkStreamSmallWrites(b *testing.B) {
+	payload := makePayload(1 << 20)
+	b.SetBytes(int64(len(payload)))
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		w := NewWriter(ioutil.Discard)
+		for off := 0; off < len(payload); off += 64 {
+			if _, err := w.Write(payload[off : off+64]); err != nil {
+				b.Fatalf("Failed writing to compress object: %s", err)
+			}
+		}
+		if err := w.Close(); err != nil {
+			b.Fatalf("Failed to close compress object: %s", err)
+		}
+	}
+}
+
 type breakingReader struct {
 }
 
@@ -186,3 +496,195 @@ func TestUnexpectedEOFHandling(t *testing.T) {
 		t.Error("Underlying error was handled silently")
 	}
 }
+
+func TestStreamWriterReset(t *testing.T) {
+	payload := makePayload(3 << 20)
+	cdict, err := NewCompressionDict(testDict, DefaultCompression)
+	failOnError(t, "Failed to create compression dictionary", err)
+	defer cdict.Close()
+	for _, c := range []struct {
+		name   string
+		writer func(io.Writer) *Writer
+		dict   []byte
+	}{
+		{"Level", func(w io.Writer) *Writer { return NewWriterLevel(w, 5) }, nil},
+		{"Dict", func(w io.Writer) *Writer { return NewWriterLevelDict(w, DefaultCompression, testDict) }, testDict},
+		{"CompressionDict", func(w io.Writer) *Writer { return NewWriterCompressionDict(w, cdict) }, testDict},
+		{"Parallel", func(w io.Writer) *Writer { return NewWriterParallel(w, DefaultCompression, 2) }, nil},
+		{"Adaptive", func(w io.Writer) *Writer { return NewWriterAdaptive(w, 1, 9, 0) }, nil},
+	} {
+		t.Run(c.name, func(t *testing.T) {
+			var first, second bytes.Buffer
+			w := c.writer(&first)
+			level := w.CompressionLevel
+			// Drop a frame in progress
+			_, err := w.Write(payload)
+			failOnError(t, "Failed writing to compress object", err)
+			for i := 0; i < 3; i++ {
+				second.Reset()
+				w.Reset(&second)
+				if w.CompressionLevel != level {
+					t.Fatalf("Reset should restore level %v, got %v", level, w.CompressionLevel)
+				}
+				_, err = w.Write(payload)
+				failOnError(t, "Failed writing to compress object", err)
+				failOnError(t, "Failed to close compress object", w.Close())
+				if _, err := w.Write(payload); err == nil {
+					t.Fatalf("Write after Close should fail")
+				}
+				r := NewReaderDict(bytes.NewReader(second.Bytes()), c.dict)
+				decompressed, err := ioutil.ReadAll(r)
+				failOnError(t, "Failed to decompress", err)
+				r.Close()
+				if !bytes.Equal(payload, decompressed) {
+					t.Fatalf("Payload did not match after %v resets, lengths: %v & %v", i+1, len(payload), len(decompressed))
+				}
+			}
+		})
+	}
+
+	// Errors of the settings stick, and Reset after Close before any Reset
+	// starts with a new context
+	w := NewWriterParams(ioutil.Discard, Params{WindowLog: 100})
+	w.Reset(ioutil.Discard)
+	if _, err := w.Write(payload); err == nil {
+		t.Fatalf("Invalid parameters should fail after Reset")
+	}
+	w = NewWriter(ioutil.Discard)
+	failOnError(t, "Failed to close compress object", w.Close())
+	var out bytes.Buffer
+	w.Reset(&out)
+	_, err = w.Write(payload)
+	failOnError(t, "Failed writing to compress object", err)
+	failOnError(t, "Failed to close compress object", w.Close())
+	decompressed, err := Decompress(nil, out.Bytes())
+	failOnError(t, "Failed to decompress", err)
+	if !bytes.Equal(payload, decompressed) {
+		t.Fatalf("Payload did not match, lengths: %v & %v", len(payload), len(decompressed))
+	}
+}
+
+func TestStreamReaderReset(t *testing.T) {
+	payload := makePayload(1 << 20)
+	compressed, err := Compress(nil, payload)
+	failOnError(t, "Failed to compress", err)
+	ddict, err := NewDecompressionDict(testDict)
+	failOnError(t, "Failed to create decompression dictionary", err)
+	defer ddict.Close()
+	cdict, err := NewCompressionDict(testDict, DefaultCompression)
+	failOnError(t, "Failed to create compression dictionary", err)
+	defer cdict.Close()
+	withDict, err := CompressDict(nil, payload, cdict)
+	failOnError(t, "Failed to compress with dictionary", err)
+
+	for _, c := range []struct {
+		name       string
+		reader     func(io.Reader) io.ReadCloser
+		compressed []byte
+	}{
+		{"Plain", NewReader, compressed},
+		{"Dict", func(r io.Reader) io.ReadCloser { return NewReaderDict(r, testDict) }, withDict},
+		{"DecompressionDict", func(r io.Reader) io.ReadCloser { return NewReaderDecompressionDict(r, ddict) }, withDict},
+		{"WindowLogMax", func(r io.Reader) io.ReadCloser { return NewReaderWindowLogMax(r, 20) }, compressed},
+	} {
+		t.Run(c.name, func(t *testing.T) {
+			r := c.reader(bytes.NewReader(c.compressed))
+			// Drop a frame in progress
+			_, err := r.Read(make([]byte, 1000))
+			failOnError(t, "Failed to read", err)
+			for i := 0; i < 3; i++ {
+				failOnError(t, "Failed to reset reader", r.(Resetter).Reset(bytes.NewReader(c.compressed)))
+				decompressed, err := ioutil.ReadAll(r)
+				failOnError(t, "Failed to decompress", err)
+				if !bytes.Equal(payload, decompressed) {
+					t.Fatalf("Payload did not match after %v resets, lengths: %v & %v", i+1, len(payload), len(decompressed))
+				}
+				failOnError(t, "Failed to close decompress object", r.Close())
+				if _, err := r.Read(make([]byte, 10)); err == nil {
+					t.Fatalf("Read after Close should fail")
+				}
+			}
+		})
+	}
+
+	r := NewReaderWindowLogMax(bytes.NewReader(compressed), 100)
+	if err := r.(Resetter).Reset(bytes.NewReader(compressed)); err != errParamOutOfBound {
+		t.Fatalf("Invalid window size should fail after Reset, got %v", err)
+	}
+	r = NewReader(bytes.NewReader(compressed))
+	failOnError(t, "Failed to close decompress object", r.Close())
+	failOnError(t, "Failed to reset reader", r.(Resetter).Reset(bytes.NewReader(compressed)))
+	decompressed, err := ioutil.ReadAll(r)
+	failOnError(t, "Failed to decompress", err)
+	if !bytes.Equal(payload, decompressed) {
+		t.Fatalf("Payload did not match, lengths: %v & %v", len(payload), len(decompressed))
+	}
+	failOnError(t, "Failed to close decompress object", r.Close())
+}
+
+func TestStreamResetAllocations(t *testing.T) {
+	payload := makePayload(64 << 10)
+	var out bytes.Buffer
+	w := NewWriter(&out)
+	decompressed := make([]byte, len(payload))
+	src := bytes.NewReader(nil)
+	r := NewReader(src)
+	roundTrip := func() {
+		out.Reset()
+		w.Reset(&out)
+		if _, err := w.Write(payload); err != nil {
+			t.Fatalf("Failed writing to compress object: %s", err)
+		}
+		if err := w.Close(); err != nil {
+			t.Fatalf("Failed to close compress object: %s", err)
+		}
+		src.Reset(out.Bytes())
+		if err := r.(Resetter).Reset(src); err != nil {
+			t.Fatalf("Failed to reset reader: %s", err)
+		}
+		if _, err := io.ReadFull(r, decompressed); err != nil {
+			t.Fatalf("Failed to decompress: %s", err)
+		}
+		if err := r.Close(); err != nil {
+			t.Fatalf("Failed to close decompress object: %s", err)
+		}
+	}
+	roundTrip()
+	if !bytes.Equal(payload, decompressed) {
+		t.Fatalf("Payload did not match")
+	}
+	if allocs := testing.AllocsPerRun(10, roundTrip); allocs > 0 {
+		t.Fatalf("Resetting streams should not allocate, got %v allocations", allocs)
+	}
+}
+
+func BenchmarkStreamReset(b *testing.B) {
+	payload := makePayload(4 << 10)
+	b.Run("New", func(b *testing.B) {
+		b.SetBytes(int64(len(payload)))
+		b.ReportAllocs()
+		for i := 0; i < b.N; i++ {
+			w := NewWriter(ioutil.Discard)
+			if _, err := w.Write(payload); err != nil {
+				b.Fatalf("Failed writing to compress object: %s", err)
+			}
+			if err := w.Close(); err != nil {
+				b.Fatalf("Failed to close compress object: %s", err)
+			}
+		}
+	})
+	b.Run("Reset", func(b *testing.B) {
+		b.SetBytes(int64(len(payload)))
+		b.ReportAllocs()
+		w := NewWriter(ioutil.Discard)
+		for i := 0; i < b.N; i++ {
+			w.Reset(ioutil.Discard)
+			if _, err := w.Write(payload); err != nil {
+				b.Fatalf("Failed writing to compress object: %s", err)
+			}
+			if err := w.Close(); err != nil {
+				b.Fatalf("Failed to close compress object: %s", err)
+			}
+		}
+	})
+}
@@ -5,6 +5,7 @@ import (
 	"errors"
 	"fmt"
 	"io/ioutil"
+	"math/rand"
 	"os"
 	"testing"
 )
@@ -119,6 +120,47 @@ func TestTooSmall(t *testing.T) {
 	}
 }
 
+func TestDecompressUnknownSize(t *testing.T) {
+	// Frames written by the stream API do not declare their content size
+	payload := bytes.Repeat([]byte("Hellow World!"), 100000)
+	var compressed bytes.Buffer
+	w := NewWriter(&compressed)
+	if _, err := w.Write(payload); err != nil {
+		t.Fatalf("Failed writing to compress object: %s", err)
+	}
+	if err := w.Close(); err != nil {
+		t.Fatalf("Failed to close compress object: %s", err)
+	}
+	for _, dst := range [][]byte{nil, make([]byte, 1), make([]byte, 0, len(payload))} {
+		rein, err := Decompress(dst, compressed.Bytes())
+		if err != nil {
+			t.Fatalf("Failed decompressing: %s", err)
+		}
+		if !bytes.Equal(payload, rein) {
+			t.Fatalf("Cannot compress and decompress (lengths: %v & %v)", len(payload), len(rein))
+		}
+		if cap(dst) >= len(payload) && &dst[:1][0] != &rein[0] {
+			t.Fatalf("Large enough dst buffer was not reused")
+		}
+	}
+}
+
+func TestDecompressReusesDst(t *testing.T) {
+	payload := bytes.Repeat([]byte("Hellow World!"), 1000)
+	out, err := Compress(nil, payload)
+	if err != nil {
+		t.Fatalf("Error while compressing: %v", err)
+	}
+	dst := make([]byte, 0, len(payload))
+	rein, err := Decompress(dst, out)
+	if err != nil {
+		t.Fatalf("Failed decompressing: %s", err)
+	}
+	if !bytes.Equal(payload, rein) || &dst[:1][0] != &rein[0] {
+		t.Fatalf("Large enough dst buffer was not reused")
+	}
+}
+
 func TestRealPayload(t *testing.T) {
 	if raw == nil {
 		t.Skip(ErrNoPayloadEnv)
@@ -175,3 +217,187 @@ func BenchmarkDecompression(b *testing.B) {
 		b.StartTimer()
 	}
 }
+
+func TestNegativeLevels(t *testing.T) {
+	payload := makePayload(1 << 20)
+	previous := 0
+	for _, level := range []int{1, -1, -5, -50, -1000, MinCompressionLevel} {
+		compressed, err := CompressLevel(nil, payload, level)
+		failOnError(t, fmt.Sprintf("Failed to compress at level %v", level), err)
+		decompressed, err := Decompress(nil, compressed)
+		failOnError(t, "Failed to decompress", err)
+		if !bytes.Equal(payload, decompressed) {
+			t.Fatalf("Payload did not match at level %v", level)
+		}
+		if len(compressed) < previous {
+			t.Fatalf("Level %v compressed better than a higher level: %v < %v", level, len(compressed), previous)
+		}
+		previous = len(compressed)
+	}
+	if _, err := CompressLevel(nil, payload, MinCompressionLevel-1); err == nil {
+		t.Fatalf("Levels below MinCompressionLevel should fail")
+	}
+	if err := (Params{Level: MinCompressionLevel - 1}).Validate(); err == nil {
+		t.Fatalf("Levels below MinCompressionLevel should fail")
+	}
+}
+
+// BenchmarkCompressionLevels compresses the PAYLOAD, or log lines if it is
+// not set, at the negative levels and BestSpeed.  It reports the ratio of
+// every level in the log.
+func BenchmarkCompressionLevels(b *testing.B) {
+	payload := raw
+	if payload == nil {
+		payload = makePayload(8 << 20)
+	}
+	dst := make([]byte, CompressBound(len(payload)))
+	for _, level := range []int{-50, -20, -10, -5, -3, -2, -1, 1} {
+		b.Run(fmt.Sprintf("Level%d", level), func(b *testing.B) {
+			compressed, err := CompressLevel(dst, payload, level)
+			if err != nil {
+				b.Fatalf("Failed compressing: %s", err)
+			}
+			b.Logf("ratio %.3f", float64(len(payload))/float64(len(compressed)))
+			b.SetBytes(int64(len(payload)))
+			b.ResetTimer()
+			for i := 0; i < b.N; i++ {
+				if _, err := CompressLevel(dst, payload, level); err != nil {
+					b.Fatalf("Failed compressing: %s", err)
+				}
+			}
+		})
+	}
+}
+
+// makeLiterals returns size bytes of a skewed alphabet, with few enough
+// repeats that zstd stores them as Huffman coded literals.  The larger the
+// spread, the more symbols and the longer the codes.
+func makeLiterals(size int, spread float64) []byte {
+	rng := rand.New(rand.NewSource(int64(size)))
+	b := make([]byte, size)
+	for i := range b {
+		b[i] = byte(rng.ExpFloat64()*spread) % 200
+	}
+	return b
+}
+
+func TestDecompressLiterals(t *testing.T) {
+	for _, size := range []int{1, 17, 300, 4 << 10, 40<<10 + 3, 128 << 10, 1<<20 + 7} {
+		for _, spread := range []float64{2, 20} {
+			payload := makeLiterals(size, spread)
+			for _, level := range []int{1, 19} {
+				compressed, err := CompressLevel(nil, payload, level)
+				failOnError(t, "Failed to compress", err)
+				decompressed, err := Decompress(nil, compressed)
+				failOnError(t, "Failed to decompress", err)
+				if !bytes.Equal(payload, decompressed) {
+					t.Fatalf("Literals of size %v, spread %v did not match at level %v", size, spread, level)
+				}
+			}
+		}
+	}
+}
+
+func TestDecompressCorruptedLiterals(t *testing.T) {
+	payload := makeLiterals(128<<10, 20)
+	compressed, err := Compress(nil, payload)
+	failOnError(t, "Failed to compress", err)
+	rng := rand.New(rand.NewSource(1))
+	dst := make([]byte, len(payload))
+	for i := 0; i < 500; i++ {
+		corrupted := append([]byte{}, compressed...)
+		corrupted[rng.Intn(len(corrupted))] ^= byte(1 << uint(rng.Intn(8)))
+		// Any result will do as long as decoding stays within the buffers
+		Decompress(dst, corrupted)
+	}
+}
+
+func BenchmarkDecompressLiterals(b *testing.B) {
+	for _, spread := range []float64{2, 20} {
+		payload := makeLiterals(1<<20, spread)
+		compressed, err := Compress(nil, payload)
+		if err != nil {
+			b.Fatalf("Failed compressing: %s", err)
+		}
+		dst := make([]byte, len(payload))
+		b.Run(fmt.Sprintf("Spread%v", spread), func(b *testing.B) {
+			b.Logf("ratio %.3f", float64(len(payload))/float64(len(compressed)))
+			b.SetBytes(int64(len(payload)))
+			for i := 0; i < b.N; i++ {
+				if _, err := Decompress(dst, compressed); err != nil {
+					b.Fatalf("Failed decompressing: %s", err)
+				}
+			}
+		})
+	}
+}
+
+// makeRepeats returns size bytes of short random patterns, of periods up to
+// maxPeriod, each repeated a random number of times, with literals between
+// them: matches at every short offset.
+func makeRepeats(size, maxPeriod int) []byte {
+	rng := rand.New(rand.NewSource(int64(size + maxPeriod)))
+	b := make([]byte, 0, size+maxPeriod+300)
+	for len(b) < size {
+		pattern := make([]byte, 1+rng.Intn(maxPeriod))
+		rng.Read(pattern)
+		for n := 3 + rng.Intn(300); n > 0; n -= len(pattern) {
+			b = append(b, pattern...)
+		}
+		for n := rng.Intn(40); n > 0; n-- {
+			b = append(b, byte(rng.Intn(256)))
+		}
+	}
+	return b[:size]
+}
+
+func TestDecompressRepeats(t *testing.T) {
+	for _, size := range []int{1, 7, 31, 33, 100, 1000, 40<<10 + 3, 1<<20 + 7} {
+		for _, maxPeriod := range []int{1, 7, 15, 40} {
+			payload := makeRepeats(size, maxPeriod)
+			for _, level := range []int{1, 19} {
+				compressed, err := CompressLevel(nil, payload, level)
+				failOnError(t, "Failed to compress", err)
+				decompressed, err := Decompress(nil, compressed)
+				failOnError(t, "Failed to decompress", err)
+				if !bytes.Equal(payload, decompressed) {
+					t.Fatalf("Repeats of size %v, period %v did not match at level %v", size, maxPeriod, level)
+				}
+				// The stream decoder writes to a ring buffer of the window
+				decompressed, err = ioutil.ReadAll(NewReader(bytes.NewReader(compressed)))
+				failOnError(t, "Failed to read", err)
+				if !bytes.Equal(payload, decompressed) {
+					t.Fatalf("Streamed repeats of size %v, period %v did not match at level %v", size, maxPeriod, level)
+				}
+			}
+		}
+	}
+}
+
+func BenchmarkDecompressMatches(b *testing.B) {
+	payloads := []struct {
+		name    string
+		payload []byte
+	}{
+		{"JSON", makePayload(1 << 20)},
+		{"Repeats", makeRepeats(1<<20, 40)},
+	}
+	for _, p := range payloads {
+		for _, level := range []int{1, 19} {
+			compressed, err := CompressLevel(nil, p.payload, level)
+			if err != nil {
+				b.Fatalf("Failed compressing: %s", err)
+			}
+			dst := make([]byte, len(p.payload))
+			b.Run(fmt.Sprintf("%s/Level%d", p.name, level), func(b *testing.B) {
+				b.Logf("ratio %.3f", float64(len(p.payload))/float64(len(compressed)))
+				b.SetBytes(int64(len(p.payload)))
+				for i := 0; i < b.N; i++ {
+					if _, err := Decompress(dst, compressed); err != nil {
+						b.Fatalf("Failed decompressing: %s", err)
+					}
+				}
+			})
+		}
+	}
+}
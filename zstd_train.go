@@ -0,0 +1,394 @@
+package zstd1
+
+/*
+#define ZDICT_STATIC_LINKING_ONLY
+#include "zdict.h"
+#include "zstd_errors.h"
+#include "stdint.h"  // for uintptr_t
+#include "stdlib.h"  // for calloc, free
+
+// See zstd_ctx.go for why these *_wrapper functions take uintptr_t.
+
+static size_t ZDICT_trainFromBuffer_cover_wrapper(uintptr_t dict, size_t dictCapacity, uintptr_t samples, uintptr_t samplesSizes, unsigned nbSamples, ZDICT_cover_params_t params) {
+	return ZDICT_trainFromBuffer_cover((void*)dict, dictCapacity, (const void*)samples, (const size_t*)samplesSizes, nbSamples, params);
+}
+
+static size_t ZDICT_optimizeTrainFromBuffer_cover_wrapper(uintptr_t dict, size_t dictCapacity, uintptr_t samples, uintptr_t samplesSizes, unsigned nbSamples, ZDICT_cover_params_t* params, ZDICT_cover_control_t* control) {
+	return ZDICT_optimizeTrainFromBuffer_cover_control((void*)dict, dictCapacity, (const void*)samples, (const size_t*)samplesSizes, nbSamples, params, control);
+}
+
+// The trainer updates the control block from its threads while Go polls it
+static unsigned ZDICT_cover_control_completed(ZDICT_cover_control_t* control) {
+	return __atomic_load_n(&control->completed, __ATOMIC_SEQ_CST);
+}
+
+static unsigned ZDICT_cover_control_total(ZDICT_cover_control_t* control) {
+	return __atomic_load_n(&control->total, __ATOMIC_SEQ_CST);
+}
+
+static void ZDICT_cover_control_stop(ZDICT_cover_control_t* control) {
+	__atomic_store_n(&control->stop, 1, __ATOMIC_SEQ_CST);
+}
+*/
+import "C"
+import (
+	"container/heap"
+	"errors"
+	"math"
+	"math/rand"
+	"runtime"
+	"strconv"
+	"sync"
+	"time"
+	"unsafe"
+)
+
+var (
+	// ErrNoSamples is returned when training a dictionary without any sample
+	// data, or with a MaxMemory too small for any sample
+	ErrNoSamples = errors.New("No samples to train a dictionary on")
+	// ErrDictionarySize is returned when asking for a dictionary smaller than
+	// the 256 bytes taken by its headers and entropy tables
+	ErrDictionarySize = errors.New("Dictionary size is too small")
+	// ErrTrainingCanceled is returned by OptimizeDictionary when its Progress
+	// function stops it
+	ErrTrainingCanceled = errors.New("Dictionary training canceled")
+)
+
+const (
+	// trainProgressInterval is how often OptimizeDictionary reports progress
+	trainProgressInterval = 100 * time.Millisecond
+
+	// Memory used by training, per sample byte: the copy handed to C, and the
+	// suffix and dmer arrays of cover.c.  Every concurrent trial of
+	// OptimizeDictionary adds a copy of the frequencies.
+	trainBytesPerSample = 1 + 8
+	trialBytesPerSample = 4
+
+	// maxCoverSamples is the most sample bytes cover.c accepts: suffixes are
+	// 32 bits positions, and it allows less than 1 GB on 32 bits platforms
+	maxCoverSamples = (strconv.IntSize/64)*(1<<32-2) + (1-strconv.IntSize/64)*(1<<30-1)
+)
+
+// CoverParams are the parameters of the COVER dictionary training algorithm.
+//
+// The dictionary is made of segments of K bytes picked from the samples, each
+// scored by how many samples contain its D byte substrings (dmers).  K should
+// be around the size of the repeated structures in the samples, and D smaller
+// than K.  Steps and Progress are only used by OptimizeDictionary.
+type CoverParams struct {
+	K       int // Segment size, reasonable values go from 16 to 2048
+	D       int // Dmer size, from 6 to 16
+	Steps   int // Number of values of K tried by OptimizeDictionary, 0 means 40
+	Threads int // Threads sorting the samples and trying parameters, 0 or 1 means one
+
+	Level  int    // Compression level the dictionary is tuned for, 0 means the default
+	DictID uint32 // ID stored in the dictionary, 0 picks a random one
+
+	// MaxMemory bounds the memory used by training, in bytes.  It takes
+	// about 9 bytes per sample byte, plus 4 per thread of OptimizeDictionary.
+	// Threads is lowered to fit, and if a single one does not, training uses
+	// a random subset of the samples, as a DictionarySampler would pick.
+	// Samples beyond the 4 GB cover.c can index are always subsampled.
+	// 0 means no limit.
+	MaxMemory int
+	// Progress, if set, is called by OptimizeDictionary from another goroutine
+	// as parameter sets are tried, with the number tried and the total.
+	// Returning false cancels the training, which then fails with
+	// ErrTrainingCanceled.
+	Progress func(done, total int) bool
+}
+
+// maxSamples returns the most sample bytes that fit in p.MaxMemory, when
+// training takes bytesPerSample bytes for each
+func (p CoverParams) maxSamples(bytesPerSample int) int {
+	if p.MaxMemory == 0 || p.MaxMemory/bytesPerSample > maxCoverSamples {
+		return maxCoverSamples
+	}
+	return p.MaxMemory / bytesPerSample
+}
+
+// cParams returns the C version of p, checking it fits
+func (p CoverParams) cParams() (C.ZDICT_cover_params_t, error) {
+	var cp C.ZDICT_cover_params_t
+	if p.K < 0 || p.D < 0 || p.Steps < 0 || p.Threads < 0 || p.MaxMemory < 0 {
+		return cp, errParamOutOfBound
+	}
+	if err := checkLevel(p.Level); err != nil {
+		return cp, err
+	}
+	cp.k = C.unsigned(p.K)
+	cp.d = C.unsigned(p.D)
+	cp.steps = C.unsigned(p.Steps)
+	cp.nbThreads = C.unsigned(p.Threads)
+	if p.Threads == 0 {
+		cp.nbThreads = 1
+	}
+	cp.zParams.compressionLevel = C.int(p.Level)
+	cp.zParams.dictID = C.unsigned(p.DictID)
+	return cp, nil
+}
+
+// flattenSamples concatenates samples into the single buffer and array of
+// sizes taken by the trainers, keeping a random subset of at most maxBytes
+// bytes if needed
+func flattenSamples(samples [][]byte, maxBytes int) ([]byte, []C.size_t, error) {
+	total := 0
+	for _, s := range samples {
+		total += len(s)
+	}
+	if total == 0 {
+		return nil, nil, ErrNoSamples
+	}
+	if total > maxBytes {
+		sampler := NewDictionarySampler(maxBytes)
+		for _, s := range samples {
+			sampler.add(s, false)
+		}
+		samples = sampler.Samples()
+		total = sampler.size
+		if total == 0 {
+			return nil, nil, ErrNoSamples
+		}
+	}
+	flat := make([]byte, 0, total)
+	sizes := make([]C.size_t, len(samples))
+	for i, s := range samples {
+		flat = append(flat, s...)
+		sizes[i] = C.size_t(len(s))
+	}
+	return flat, sizes, nil
+}
+
+// TrainDictionary builds a dictionary of at most size bytes from samples with
+// the COVER algorithm, for use with NewCompressionDict, NewDecompressionDict
+// and the *Dict functions.
+//
+// Samples should look like the payloads the dictionary will compress: a few
+// thousand of them, totalling about 100 times the dictionary size, is a good
+// start.  If p.K or p.D is 0, it searches for them like the zstd command line
+// tool does, trying a few values of K with D = 8.
+func TrainDictionary(samples [][]byte, size int, p CoverParams) ([]byte, error) {
+	if p.K == 0 || p.D == 0 {
+		p.D, p.Steps = 8, 4
+		if p.Level == 0 {
+			p.Level = 6 // like ZDICT_trainFromBuffer
+		}
+		dict, _, err := OptimizeDictionary(samples, size, p)
+		return dict, err
+	}
+	cp, err := p.cParams()
+	if err != nil {
+		return nil, err
+	}
+	flat, sizes, err := flattenSamples(samples, p.maxSamples(trainBytesPerSample))
+	if err != nil {
+		return nil, err
+	}
+	if size < C.ZDICT_DICTSIZE_MIN {
+		return nil, ErrDictionarySize
+	}
+	dict := make([]byte, size)
+
+	written := int(C.ZDICT_trainFromBuffer_cover_wrapper(
+		C.uintptr_t(uintptr(unsafe.Pointer(&dict[0]))),
+		C.size_t(size),
+		C.uintptr_t(uintptr(unsafe.Pointer(&flat[0]))),
+		C.uintptr_t(uintptr(unsafe.Pointer(&sizes[0]))),
+		C.unsigned(len(sizes)),
+		cp))
+	runtime.KeepAlive(dict)
+	runtime.KeepAlive(flat)
+	runtime.KeepAlive(sizes)
+	if err := getError(written); err != nil {
+		return nil, err
+	}
+	return dict[:written], nil
+}
+
+// OptimizeDictionary is like TrainDictionary but tries several values of the
+// parameters and keeps the dictionary compressing the samples best.  Values of
+// p.K and p.D other than 0 are kept as is.  Otherwise D goes over 6 and 8, and
+// K over p.Steps values from 50 to 2000.  With p.Threads > 1, that many
+// parameter sets are tried at the same time, within p.MaxMemory.
+//
+// It returns the dictionary along with the parameters that built it, which
+// can be given to TrainDictionary to train again on new samples quickly.
+// Threads is set to the number of threads actually used.
+func OptimizeDictionary(samples [][]byte, size int, p CoverParams) ([]byte, CoverParams, error) {
+	cp, err := p.cParams()
+	if err != nil {
+		return nil, p, err
+	}
+	flat, sizes, err := flattenSamples(samples, p.maxSamples(trainBytesPerSample+trialBytesPerSample))
+	if err != nil {
+		return nil, p, err
+	}
+	if size < C.ZDICT_DICTSIZE_MIN {
+		return nil, p, ErrDictionarySize
+	}
+	dict := make([]byte, size)
+	// Allocated in C as the trainer threads write to it
+	control := (*C.ZDICT_cover_control_t)(C.calloc(1, C.sizeof_ZDICT_cover_control_t))
+	if control == nil {
+		return nil, p, ErrorCode(-C.ZSTD1_error_memory_allocation)
+	}
+	defer C.free(unsafe.Pointer(control))
+	control.maxMemory = C.size_t(p.MaxMemory)
+
+	done := make(chan struct{})
+	var canceled bool
+	var reported sync.WaitGroup
+	if p.Progress != nil {
+		reported.Add(1)
+		go func() {
+			defer reported.Done()
+			canceled = !reportProgress(control, p.Progress, done)
+		}()
+	}
+	written := int(C.ZDICT_optimizeTrainFromBuffer_cover_wrapper(
+		C.uintptr_t(uintptr(unsafe.Pointer(&dict[0]))),
+		C.size_t(size),
+		C.uintptr_t(uintptr(unsafe.Pointer(&flat[0]))),
+		C.uintptr_t(uintptr(unsafe.Pointer(&sizes[0]))),
+		C.unsigned(len(sizes)),
+		&cp, control))
+	close(done)
+	reported.Wait()
+	runtime.KeepAlive(dict)
+	runtime.KeepAlive(flat)
+	runtime.KeepAlive(sizes)
+	if canceled {
+		return nil, p, ErrTrainingCanceled
+	}
+	if err := getError(written); err != nil {
+		return nil, p, err
+	}
+	p.K, p.D, p.Steps = int(cp.k), int(cp.d), int(cp.steps)
+	p.Threads = int(control.threads)
+	return dict[:written], p, nil
+}
+
+// reportProgress calls progress whenever more parameter sets were tried, until
+// done is closed or progress returns false, in which case it stops the
+// training and returns false
+func reportProgress(control *C.ZDICT_cover_control_t, progress func(done, total int) bool, done chan struct{}) bool {
+	ticker := time.NewTicker(trainProgressInterval)
+	defer ticker.Stop()
+	last := -1
+	for {
+		var finished bool
+		select {
+		case <-done:
+			finished = true
+		case <-ticker.C:
+		}
+		completed := int(C.ZDICT_cover_control_completed(control))
+		total := int(C.ZDICT_cover_control_total(control))
+		if total > 0 && completed != last {
+			last = completed
+			if !progress(completed, total) {
+				C.ZDICT_cover_control_stop(control)
+				return false
+			}
+		}
+		if finished {
+			return true
+		}
+	}
+}
+
+// DictionarySampler picks the samples to train a dictionary on from a stream
+// of them too large to hold in memory or to train on.  It keeps a uniform
+// random subset of the samples added, of at most maxBytes bytes in total: every
+// sample gets a random key, exponentially distributed, and the samples with
+// the lowest keys are kept.  The choice is deterministic for a given stream.
+//
+// A DictionarySampler is not safe for concurrent use.
+type DictionarySampler struct {
+	maxBytes int
+	rng      *rand.Rand
+	kept     sampleHeap
+	size     int
+	// Samples with keys from this one on were dropped, or would have been
+	cutoff float64
+	seen   int
+}
+
+// sampleHeap is a max heap of samples by key
+type sampleHeap []keyedSample
+
+type keyedSample struct {
+	key  float64
+	data []byte
+}
+
+func (h sampleHeap) Len() int            { return len(h) }
+func (h sampleHeap) Less(i, j int) bool  { return h[i].key > h[j].key }
+func (h sampleHeap) Swap(i, j int)       { h[i], h[j] = h[j], h[i] }
+func (h *sampleHeap) Push(x interface{}) { *h = append(*h, x.(keyedSample)) }
+func (h *sampleHeap) Pop() interface{} {
+	old := *h
+	x := old[len(old)-1]
+	*h = old[:len(old)-1]
+	return x
+}
+
+// NewDictionarySampler returns a sampler keeping at most maxBytes bytes of
+// samples.
+func NewDictionarySampler(maxBytes int) *DictionarySampler {
+	return &DictionarySampler{
+		maxBytes: maxBytes,
+		rng:      rand.New(rand.NewSource(1)),
+		cutoff:   math.Inf(1),
+	}
+}
+
+// Add offers sample to the sampler, which copies it if it is kept.
+func (s *DictionarySampler) Add(sample []byte) {
+	s.add(sample, true)
+}
+
+// add offers sample to the sampler, copying it if it may be kept
+func (s *DictionarySampler) add(sample []byte, copySample bool) {
+	s.seen++
+	key := s.rng.ExpFloat64()
+	if key >= s.cutoff || len(sample) == 0 {
+		return
+	}
+	if copySample {
+		sample = append([]byte(nil), sample...)
+	}
+	heap.Push(&s.kept, keyedSample{key: key, data: sample})
+	s.size += len(sample)
+	for s.size > s.maxBytes {
+		dropped := heap.Pop(&s.kept).(keyedSample)
+		s.size -= len(dropped.data)
+		s.cutoff = dropped.key
+	}
+}
+
+// age halves the weight of the samples kept so far against the ones added
+// next.  Dividing the exponential keys of samples by their weight samples them
+// proportionally to it: doubling the keys keeps the order of the heap.
+func (s *DictionarySampler) age() {
+	for i := range s.kept {
+		s.kept[i].key *= 2
+	}
+	s.cutoff *= 2
+}
+
+// Seen returns the number of samples added so far.
+func (s *DictionarySampler) Seen() int {
+	return s.seen
+}
+
+// Samples returns the samples kept so far, to give to TrainDictionary or
+// OptimizeDictionary.
+func (s *DictionarySampler) Samples() [][]byte {
+	samples := make([][]byte, len(s.kept))
+	for i := range s.kept {
+		samples[i] = s.kept[i].data
+	}
+	return samples
+}
@@ -0,0 +1,320 @@
+package zstd1
+
+import (
+	"bytes"
+	"fmt"
+	"math/rand"
+	"sync"
+	"testing"
+	"time"
+)
+
+// makeEvents returns count JSON events of about 300 bytes sharing a schema,
+// the kind of payloads dictionaries are made for
+func makeEvents(count int, seed int64) [][]byte {
+	rng := rand.New(rand.NewSource(seed))
+	regions := []string{"us-east-1", "us-west-2", "eu-west-1", "ap-south-1"}
+	actions := []string{"login", "logout", "purchase", "view", "search", "add_to_cart"}
+	events := make([][]byte, count)
+	for i := range events {
+		events[i] = []byte(fmt.Sprintf(`{"event_id":"%016x","timestamp":%d,"user":{"id":%d,"name":"user%d",`+
+			`"plan":"%s"},"action":"%s","region":"%s","client":{"version":"2.%d.%d","platform":"%s"},`+
+			`"latency_ms":%d,"status":%d,"tags":["%s","%s"]}`,
+			rng.Int63(), 1500000000+rng.Intn(100000000), rng.Intn(1000000), rng.Intn(1000),
+			[]string{"free", "pro", "enterprise"}[rng.Intn(3)], actions[rng.Intn(len(actions))],
+			regions[rng.Intn(len(regions))], rng.Intn(20), rng.Intn(10),
+			[]string{"ios", "android", "web"}[rng.Intn(3)], rng.Intn(2000),
+			[]int{200, 201, 404, 500}[rng.Intn(4)], actions[rng.Intn(len(actions))], regions[rng.Intn(len(regions))]))
+	}
+	return events
+}
+
+// dictCompressedSize returns the total size of samples compressed one by one
+// with dict, or without a dictionary if dict is nil
+func dictCompressedSize(t *testing.T, samples [][]byte, dict []byte) int {
+	var cdict *CompressionDict
+	if dict != nil {
+		var err error
+		cdict, err = NewCompressionDict(dict, DefaultCompression)
+		failOnError(t, "Failed to create compression dictionary", err)
+		defer cdict.Close()
+	}
+	total := 0
+	for _, s := range samples {
+		var compressed []byte
+		var err error
+		if cdict != nil {
+			compressed, err = CompressDict(nil, s, cdict)
+		} else {
+			compressed, err = Compress(nil, s)
+		}
+		failOnError(t, "Failed to compress", err)
+		total += len(compressed)
+	}
+	return total
+}
+
+func TestTrainDictionary(t *testing.T) {
+	samples := makeEvents(2000, 1)
+	dict, err := TrainDictionary(samples, 8<<10, CoverParams{K: 200, D: 8, DictID: 1234})
+	failOnError(t, "Failed to train dictionary", err)
+	if len(dict) == 0 || len(dict) > 8<<10 {
+		t.Fatalf("Unexpected dictionary size %v", len(dict))
+	}
+
+	ddict, err := NewDecompressionDict(dict)
+	failOnError(t, "Failed to create decompression dictionary", err)
+	defer ddict.Close()
+	if ddict.ID() != 1234 {
+		t.Fatalf("Dictionary ID should be 1234, got %v", ddict.ID())
+	}
+
+	// Sorting the samples on several threads gives the same dictionary
+	parallel, err := TrainDictionary(samples, 8<<10, CoverParams{K: 200, D: 8, DictID: 1234, Threads: 4})
+	failOnError(t, "Failed to train dictionary", err)
+	if !bytes.Equal(parallel, dict) {
+		t.Fatalf("Dictionary trained on 4 threads differs")
+	}
+
+	// Compress events not used for training
+	events := makeEvents(200, 2)
+	with, without := dictCompressedSize(t, events, dict), dictCompressedSize(t, events, nil)
+	t.Logf("Compressed 200 events to %v bytes with dictionary, %v bytes without", with, without)
+	if with*2 > without {
+		t.Fatalf("Dictionary should at least halve the size: %v vs %v", with, without)
+	}
+
+	cdict, err := NewCompressionDict(dict, DefaultCompression)
+	failOnError(t, "Failed to create compression dictionary", err)
+	defer cdict.Close()
+	compressed, err := CompressDict(nil, events[0], cdict)
+	failOnError(t, "Failed to compress with dictionary", err)
+	decompressed, err := DecompressDict(nil, compressed, ddict)
+	failOnError(t, "Failed to decompress with dictionary", err)
+	if !bytes.Equal(events[0], decompressed) {
+		t.Fatalf("Payload did not match, lengths: %v & %v", len(events[0]), len(decompressed))
+	}
+}
+
+func TestTrainDictionaryDefaults(t *testing.T) {
+	samples := makeEvents(2000, 1)
+	dict, err := TrainDictionary(samples, 4<<10, CoverParams{})
+	failOnError(t, "Failed to train dictionary", err)
+	events := makeEvents(200, 2)
+	if with, without := dictCompressedSize(t, events, dict), dictCompressedSize(t, events, nil); with >= without {
+		t.Fatalf("Dictionary did not improve compression: %v >= %v", with, without)
+	}
+}
+
+func TestOptimizeDictionary(t *testing.T) {
+	samples := makeEvents(2000, 1)
+	for _, threads := range []int{1, 4} {
+		dict, p, err := OptimizeDictionary(samples, 8<<10, CoverParams{Steps: 8, Threads: threads})
+		failOnError(t, "Failed to optimize dictionary", err)
+		t.Logf("Best parameters with %v threads: k=%v d=%v", threads, p.K, p.D)
+		if p.K < 50 || p.K > 2000 || (p.D != 6 && p.D != 8) {
+			t.Fatalf("Unexpected parameters: %+v", p)
+		}
+
+		// The parameters found train the same dictionary
+		again, err := TrainDictionary(samples, 8<<10, p)
+		failOnError(t, "Failed to train dictionary", err)
+		if len(again) != len(dict) {
+			t.Fatalf("Dictionaries trained with the same parameters differ: %v vs %v bytes", len(again), len(dict))
+		}
+	}
+}
+
+func TestOptimizeDictionaryMemory(t *testing.T) {
+	samples := makeEvents(2000, 1)
+	total := 0
+	for _, s := range samples {
+		total += len(s)
+	}
+	p := CoverParams{Steps: 4, Threads: 4}
+	_, best, err := OptimizeDictionary(samples, 8<<10, p)
+	failOnError(t, "Failed to optimize dictionary", err)
+	if best.Threads != 4 {
+		t.Fatalf("Should use 4 threads without a budget, got %v", best.Threads)
+	}
+	// Enough for every sample with one thread, not two
+	p.MaxMemory = 14 * total
+	_, best, err = OptimizeDictionary(samples, 8<<10, p)
+	failOnError(t, "Failed to optimize dictionary", err)
+	if best.Threads != 1 {
+		t.Fatalf("Should use 1 thread with a small budget, got %v", best.Threads)
+	}
+	// Not even enough for a single sample
+	p.MaxMemory = 1 << 10
+	if _, _, err := OptimizeDictionary(samples, 8<<10, p); err != ErrNoSamples {
+		t.Fatalf("Expected ErrNoSamples, got %v", err)
+	}
+}
+
+func TestTrainDictionaryMaxMemory(t *testing.T) {
+	samples := makeEvents(20000, 1)
+	total := 0
+	for _, s := range samples {
+		total += len(s)
+	}
+	events := makeEvents(200, 2)
+	full, err := TrainDictionary(samples, 8<<10, CoverParams{K: 200, D: 8})
+	failOnError(t, "Failed to train dictionary", err)
+	// A tenth of the samples still make a good dictionary
+	subset, err := TrainDictionary(samples, 8<<10, CoverParams{K: 200, D: 8, MaxMemory: total})
+	failOnError(t, "Failed to train dictionary", err)
+	withFull, withSubset := dictCompressedSize(t, events, full), dictCompressedSize(t, events, subset)
+	t.Logf("Compressed 200 events to %v bytes with all samples, %v with a tenth", withFull, withSubset)
+	if withSubset > withFull*11/10 {
+		t.Fatalf("Subsampling lost more than 10%%: %v vs %v", withSubset, withFull)
+	}
+}
+
+func TestDictionarySampler(t *testing.T) {
+	s := NewDictionarySampler(100 << 10)
+	events := makeEvents(10000, 1)
+	total := 0
+	for _, e := range events {
+		s.Add(e)
+		total += len(e)
+	}
+	kept := s.Samples()
+	size := 0
+	for _, k := range kept {
+		size += len(k)
+	}
+	if s.Seen() != len(events) {
+		t.Fatalf("Should have seen %v samples, got %v", len(events), s.Seen())
+	}
+	if size > 100<<10 || size < 90<<10 {
+		t.Fatalf("Should keep close to 100 KB, got %v", size)
+	}
+	// Uniform: about as many samples from both halves of the stream
+	index := make(map[string]int, len(events))
+	for i, e := range events {
+		index[string(e)] = i
+	}
+	first := 0
+	for _, k := range kept {
+		i := index[string(k)]
+		if &k[0] == &events[i][0] {
+			t.Fatalf("Kept samples must be copies")
+		}
+		if i < len(events)/2 {
+			first++
+		}
+	}
+	if first < len(kept)*4/10 || first > len(kept)*6/10 {
+		t.Fatalf("%v of %v kept samples come from the first half", first, len(kept))
+	}
+
+	// After aging, old samples weigh half as much as new ones: as many new
+	// samples make up about 2/3 of the kept ones
+	s.age()
+	for _, e := range makeOrders(len(events), 1) {
+		s.Add(e)
+	}
+	old := 0
+	for _, k := range s.Samples() {
+		if _, ok := index[string(k)]; ok {
+			old++
+		}
+	}
+	if n := len(s.Samples()); old < n*20/100 || old > n*45/100 {
+		t.Fatalf("%v of %v kept samples are old after aging", old, n)
+	}
+}
+
+func TestOptimizeDictionaryProgress(t *testing.T) {
+	samples := makeEvents(2000, 1)
+	var calls, last, total int
+	p := CoverParams{Steps: 20, Threads: 2, Progress: func(done, tot int) bool {
+		if done < last {
+			t.Errorf("Progress went back from %v to %v", last, done)
+		}
+		calls, last, total = calls+1, done, tot
+		return true
+	}}
+	_, _, err := OptimizeDictionary(samples, 8<<10, p)
+	failOnError(t, "Failed to optimize dictionary", err)
+	// d in {6, 8} and k in 20 steps from 50 to 2000
+	if calls == 0 || total != 2*21 || last != total {
+		t.Fatalf("Unexpected progress: %v calls, last %v/%v", calls, last, total)
+	}
+
+	// Cancel after the first report
+	start := time.Now()
+	p.Progress = func(done, total int) bool { return false }
+	if _, _, err := OptimizeDictionary(samples, 8<<10, p); err != ErrTrainingCanceled {
+		t.Fatalf("Expected ErrTrainingCanceled, got %v", err)
+	}
+	t.Logf("Canceled after %v", time.Since(start))
+}
+
+func TestTrainDictionaryConcurrently(t *testing.T) {
+	samples := makeEvents(1000, 1)
+	want, err := TrainDictionary(samples, 4<<10, CoverParams{K: 200, D: 8, DictID: 1})
+	failOnError(t, "Failed to train dictionary", err)
+	var wg sync.WaitGroup
+	for i := 0; i < 4; i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			dict, err := TrainDictionary(samples, 4<<10, CoverParams{K: 200, D: 8, DictID: 1})
+			if err != nil {
+				t.Errorf("Failed to train dictionary: %s", err)
+			} else if !bytes.Equal(dict, want) {
+				t.Errorf("Concurrent training gave a different dictionary")
+			}
+		}()
+	}
+	wg.Wait()
+}
+
+func TestTrainDictionaryErrors(t *testing.T) {
+	if _, err := TrainDictionary(nil, 8<<10, CoverParams{K: 200, D: 8}); err != ErrNoSamples {
+		t.Fatalf("Expected ErrNoSamples, got %v", err)
+	}
+	if _, err := TrainDictionary([][]byte{{}, {}}, 8<<10, CoverParams{K: 200, D: 8}); err != ErrNoSamples {
+		t.Fatalf("Expected ErrNoSamples, got %v", err)
+	}
+	samples := makeEvents(100, 1)
+	if _, err := TrainDictionary(samples, 100, CoverParams{K: 200, D: 8}); err != ErrDictionarySize {
+		t.Fatalf("Expected ErrDictionarySize, got %v", err)
+	}
+	if _, _, err := OptimizeDictionary(samples, 8<<10, CoverParams{K: -1}); err == nil {
+		t.Fatalf("Negative parameters should fail")
+	}
+	// D larger than K is rejected by zstd
+	if _, err := TrainDictionary(samples, 8<<10, CoverParams{K: 8, D: 16}); err == nil {
+		t.Fatalf("D larger than K should fail")
+	}
+}
+
+func BenchmarkTrainDictionary(b *testing.B) {
+	samples := makeEvents(5000, 1)
+	size := 0
+	for _, s := range samples {
+		size += len(s)
+	}
+	b.SetBytes(int64(size))
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if _, err := TrainDictionary(samples, 16<<10, CoverParams{K: 200, D: 8}); err != nil {
+			b.Fatalf("Failed to train dictionary: %s", err)
+		}
+	}
+}
+
+func BenchmarkOptimizeDictionary(b *testing.B) {
+	samples := makeEvents(5000, 1)
+	for _, threads := range []int{1, 4} {
+		b.Run(fmt.Sprintf("Threads%d", threads), func(b *testing.B) {
+			for i := 0; i < b.N; i++ {
+				if _, _, err := OptimizeDictionary(samples, 16<<10, CoverParams{Steps: 8, Threads: threads}); err != nil {
+					b.Fatalf("Failed to optimize dictionary: %s", err)
+				}
+			}
+		})
+	}
+}
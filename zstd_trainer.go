@@ -0,0 +1,168 @@
+package zstd1
+
+/*
+#define ZDICT_STATIC_LINKING_ONLY
+#include "zdict.h"
+#include "zstd_errors.h"
+#include "stdint.h"  // for uintptr_t
+
+// See zstd_ctx.go for why these *_wrapper functions take uintptr_t.
+
+static void ZDICT_coverState_update_wrapper(ZDICT_cover_state_t* state, uintptr_t sample, size_t size) {
+	ZDICT_coverState_update(state, (const void*)sample, &size, 1);
+}
+
+static size_t ZDICT_trainFromCoverState_wrapper(uintptr_t dict, size_t dictCapacity, const ZDICT_cover_state_t* state, uintptr_t samples, uintptr_t samplesSizes, unsigned nbSamples, ZDICT_cover_params_t params) {
+	return ZDICT_trainFromCoverState((void*)dict, dictCapacity, state, (const void*)samples, (const size_t*)samplesSizes, nbSamples, params);
+}
+*/
+import "C"
+import (
+	"runtime"
+	"unsafe"
+)
+
+const (
+	// trainerHashLog sizes the dmer counters of a DictionaryTrainer: 4 MB
+	trainerHashLog = 20
+	// trainerDefaultK is the segment size of a DictionaryTrainer if not set
+	trainerDefaultK = 1024
+	// trainerDefaultID is the first dictionary ID of a DictionaryTrainer if
+	// not set, the lowest one not reserved by the zstd format
+	trainerDefaultID = 1 << 15
+)
+
+// DictionaryTrainer builds dictionaries incrementally, for samples that
+// change over time.  Samples are added in batches, and only the new ones are
+// processed: the trainer counts the D byte substrings (dmers) of every sample
+// in a table of fixed size, and keeps a random subset of the samples, of at
+// most maxBytes bytes, out of which dictionaries are made.  Each dictionary is
+// built from that subset and the counts of all the samples, so its cost does
+// not grow with the number of samples seen.
+//
+// Dictionaries get consecutive IDs, from p.DictID (0 means 32768), so that
+// the ID of a frame tells which dictionary version it needs.  IDs are not
+// persisted: a process that restarts the trainer must save NextID and restore
+// it with SetNextID, or dictionaries already in use get their IDs reissued.
+//
+// A DictionaryTrainer is not safe for concurrent use.  Call Close to free it
+// once it is no longer used; it is otherwise freed when garbage collected.
+type DictionaryTrainer struct {
+	state   *C.ZDICT_cover_state_t
+	params  C.ZDICT_cover_params_t
+	samples *DictionarySampler
+	nextID  uint32
+}
+
+// NewDictionaryTrainer returns a trainer building dictionaries with segments
+// of p.K bytes (0 means 1024) scored by dmers of p.D bytes (0 means 8, at
+// most 8) for p.Level, keeping at most maxBytes of samples.  Its other
+// parameters are ignored.  maxBytes should be about 100 times the size of the
+// dictionaries.
+func NewDictionaryTrainer(p CoverParams, maxBytes int) (*DictionaryTrainer, error) {
+	if p.K == 0 {
+		p.K = trainerDefaultK
+	}
+	if p.D == 0 {
+		p.D = 8
+	}
+	if p.D < C.ZDICT_COVER_STATE_DMIN || p.D > C.ZDICT_COVER_STATE_DMAX || maxBytes <= 0 {
+		return nil, errParamOutOfBound
+	}
+	if p.DictID == 0 {
+		p.DictID = trainerDefaultID
+	}
+	cp, err := p.cParams()
+	if err != nil {
+		return nil, err
+	}
+	state := C.ZDICT_createCoverState(C.unsigned(p.D), trainerHashLog)
+	if state == nil {
+		return nil, ErrorCode(-C.ZSTD1_error_memory_allocation)
+	}
+	t := &DictionaryTrainer{
+		state:   state,
+		params:  cp,
+		samples: NewDictionarySampler(maxBytes),
+		nextID:  p.DictID,
+	}
+	runtime.SetFinalizer(t, (*DictionaryTrainer).Close)
+	return t, nil
+}
+
+// Add merges samples into the trainer.
+func (t *DictionaryTrainer) Add(samples ...[]byte) {
+	for _, s := range samples {
+		if len(s) == 0 {
+			continue
+		}
+		C.ZDICT_coverState_update_wrapper(t.state, C.uintptr_t(uintptr(unsafe.Pointer(&s[0]))), C.size_t(len(s)))
+		runtime.KeepAlive(s)
+		t.samples.Add(s)
+	}
+}
+
+// Age halves the weight of the samples added so far against the ones added
+// next.  Calling it between batches, e.g. every week, lets dictionaries follow
+// samples that drift.
+func (t *DictionaryTrainer) Age() {
+	C.ZDICT_coverState_age(t.state)
+	t.samples.age()
+}
+
+// Dictionary builds a dictionary of at most size bytes from the samples added
+// so far.  Every successful call uses the next dictionary ID.
+func (t *DictionaryTrainer) Dictionary(size int) ([]byte, error) {
+	if size < C.ZDICT_DICTSIZE_MIN {
+		return nil, ErrDictionarySize
+	}
+	flat, sizes, err := flattenSamples(t.samples.Samples(), maxCoverSamples)
+	if err != nil {
+		return nil, err
+	}
+	dict := make([]byte, size)
+	params := t.params
+	params.zParams.dictID = C.unsigned(t.nextID)
+	written := int(C.ZDICT_trainFromCoverState_wrapper(
+		C.uintptr_t(uintptr(unsafe.Pointer(&dict[0]))),
+		C.size_t(size),
+		t.state,
+		C.uintptr_t(uintptr(unsafe.Pointer(&flat[0]))),
+		C.uintptr_t(uintptr(unsafe.Pointer(&sizes[0]))),
+		C.unsigned(len(sizes)),
+		params))
+	runtime.KeepAlive(dict)
+	runtime.KeepAlive(flat)
+	runtime.KeepAlive(sizes)
+	runtime.KeepAlive(t)
+	if err := getError(written); err != nil {
+		return nil, err
+	}
+	t.nextID++
+	return dict[:written], nil
+}
+
+// NextID returns the ID the next dictionary will get.
+func (t *DictionaryTrainer) NextID() uint32 {
+	return t.nextID
+}
+
+// SetNextID sets the ID of the next dictionary, 0 meaning 32768, e.g. to
+// continue the IDs of a previous process.
+func (t *DictionaryTrainer) SetNextID(id uint32) {
+	if id == 0 {
+		id = trainerDefaultID
+	}
+	t.nextID = id
+}
+
+// Close frees the allocated C objects.
+func (t *DictionaryTrainer) Close() error {
+	if t.state == nil {
+		return nil
+	}
+	C.ZDICT_freeCoverState(t.state)
+	t.state = nil
+	runtime.SetFinalizer(t, nil)
+	return nil
+}
@@ -0,0 +1,146 @@
+package zstd1
+
+import (
+	"fmt"
+	"math/rand"
+	"testing"
+)
+
+// makeOrders returns count JSON events of a schema other than makeEvents
+func makeOrders(count int, seed int64) [][]byte {
+	rng := rand.New(rand.NewSource(seed))
+	currencies := []string{"USD", "EUR", "GBP", "JPY"}
+	states := []string{"pending", "paid", "shipped", "delivered", "refunded"}
+	orders := make([][]byte, count)
+	for i := range orders {
+		orders[i] = []byte(fmt.Sprintf(`{"order":{"number":"ORD-%08d","created_at":"2018-%02d-%02dT%02d:%02d:00Z",`+
+			`"customer_id":%d,"currency":"%s","total_cents":%d,"state":"%s"},"shipping":{"carrier":"%s",`+
+			`"tracking":"%012d","address":{"country":"%s","zip":"%05d"}},"items_count":%d}`,
+			rng.Intn(100000000), 1+rng.Intn(12), 1+rng.Intn(28), rng.Intn(24), rng.Intn(60),
+			rng.Intn(1000000), currencies[rng.Intn(len(currencies))], rng.Intn(100000),
+			states[rng.Intn(len(states))], []string{"ups", "fedex", "dhl"}[rng.Intn(3)],
+			rng.Int63n(1000000000000), []string{"US", "FR", "DE", "JP"}[rng.Intn(4)],
+			rng.Intn(100000), 1+rng.Intn(9)))
+	}
+	return orders
+}
+
+func TestDictionaryTrainer(t *testing.T) {
+	trainer, err := NewDictionaryTrainer(CoverParams{K: 200, DictID: 100}, 1<<20)
+	failOnError(t, "Failed to create trainer", err)
+	defer trainer.Close()
+	if _, err := trainer.Dictionary(8 << 10); err != ErrNoSamples {
+		t.Fatalf("Expected ErrNoSamples without samples, got %v", err)
+	}
+
+	// In batches, as good as training on everything at once
+	samples := makeEvents(2000, 1)
+	for i := 0; i < len(samples); i += 500 {
+		trainer.Add(samples[i : i+500]...)
+	}
+	dict, err := trainer.Dictionary(8 << 10)
+	failOnError(t, "Failed to build dictionary", err)
+	full, err := TrainDictionary(samples, 8<<10, CoverParams{K: 200, D: 8})
+	failOnError(t, "Failed to train dictionary", err)
+	events := makeEvents(200, 2)
+	incremental, retrained := dictCompressedSize(t, events, dict), dictCompressedSize(t, events, full)
+	t.Logf("Compressed 200 events to %v bytes incrementally, %v retraining", incremental, retrained)
+	if incremental > retrained*11/10 {
+		t.Fatalf("Incremental dictionary is more than 10%% worse: %v vs %v", incremental, retrained)
+	}
+
+	ddict, err := NewDecompressionDict(dict)
+	failOnError(t, "Failed to create decompression dictionary", err)
+	defer ddict.Close()
+	if ddict.ID() != 100 {
+		t.Fatalf("First dictionary ID should be 100, got %v", ddict.ID())
+	}
+
+	// The schema changes: after a few weeks the dictionary follows
+	orders := makeOrders(200, 2)
+	before := dictCompressedSize(t, orders, dict)
+	for week := 0; week < 3; week++ {
+		trainer.Age()
+		trainer.Add(makeOrders(1000, int64(10+week))...)
+	}
+	dict, err = trainer.Dictionary(8 << 10)
+	failOnError(t, "Failed to build dictionary", err)
+	after := dictCompressedSize(t, orders, dict)
+	t.Logf("Compressed 200 orders to %v bytes before the drift, %v after", before, after)
+	if after*2 > before {
+		t.Fatalf("Dictionary did not follow the new samples: %v vs %v", after, before)
+	}
+	ddict2, err := NewDecompressionDict(dict)
+	failOnError(t, "Failed to create decompression dictionary", err)
+	defer ddict2.Close()
+	if ddict2.ID() != 101 {
+		t.Fatalf("Second dictionary ID should be 101, got %v", ddict2.ID())
+	}
+
+	// A trainer of another process continues the IDs
+	restarted, err := NewDictionaryTrainer(CoverParams{K: 200, DictID: 100}, 1<<20)
+	failOnError(t, "Failed to create trainer", err)
+	defer restarted.Close()
+	restarted.SetNextID(trainer.NextID())
+	restarted.Add(orders...)
+	dict, err = restarted.Dictionary(8 << 10)
+	failOnError(t, "Failed to build dictionary", err)
+	ddict3, err := NewDecompressionDict(dict)
+	failOnError(t, "Failed to create decompression dictionary", err)
+	defer ddict3.Close()
+	if ddict3.ID() != 102 || restarted.NextID() != 103 {
+		t.Fatalf("Restarted trainer should continue at 102, got %v then %v", ddict3.ID(), restarted.NextID())
+	}
+}
+
+func TestDictionaryTrainerErrors(t *testing.T) {
+	if _, err := NewDictionaryTrainer(CoverParams{D: 16}, 1<<20); err == nil {
+		t.Fatalf("D larger than 8 should fail")
+	}
+	if _, err := NewDictionaryTrainer(CoverParams{}, 0); err == nil {
+		t.Fatalf("A trainer without room for samples should fail")
+	}
+	trainer, err := NewDictionaryTrainer(CoverParams{}, 1<<20)
+	failOnError(t, "Failed to create trainer", err)
+	trainer.Add(makeEvents(100, 1)...)
+	if _, err := trainer.Dictionary(100); err != ErrDictionarySize {
+		t.Fatalf("Expected ErrDictionarySize, got %v", err)
+	}
+	failOnError(t, "Failed to close trainer", trainer.Close())
+	failOnError(t, "Failed to close trainer twice", trainer.Close())
+}
+
+// BenchmarkDictionaryRefresh compares adding a week of samples to a trainer
+// and building a dictionary, to retraining on all the samples kept
+func BenchmarkDictionaryRefresh(b *testing.B) {
+	const weeks = 8
+	history := make([][]byte, 0, weeks*2000)
+	trainer, err := NewDictionaryTrainer(CoverParams{K: 200}, 1<<20)
+	if err != nil {
+		b.Fatalf("Failed to create trainer: %s", err)
+	}
+	defer trainer.Close()
+	for week := 0; week < weeks; week++ {
+		batch := makeEvents(2000, int64(week))
+		history = append(history, batch...)
+		trainer.Add(batch...)
+	}
+	batch := makeEvents(2000, weeks)
+
+	b.Run("Incremental", func(b *testing.B) {
+		for i := 0; i < b.N; i++ {
+			trainer.Add(batch...)
+			if _, err := trainer.Dictionary(16 << 10); err != nil {
+				b.Fatalf("Failed to build dictionary: %s", err)
+			}
+		}
+	})
+	b.Run("Retrain", func(b *testing.B) {
+		samples := append(history, batch...)
+		for i := 0; i < b.N; i++ {
+			if _, err := TrainDictionary(samples, 16<<10, CoverParams{K: 200, D: 8}); err != nil {
+				b.Fatalf("Failed to train dictionary: %s", err)
+			}
+		}
+	})
+}
@@ -961,6 +961,7 @@ static ZSTD1_CCtx_params ZSTDMT_initJobCCtxParams(ZSTD1_CCtx_params const params
     jobParams.fParams = params.fParams;
     jobParams.compressionLevel = params.compressionLevel;
     jobParams.disableLiteralCompression = params.disableLiteralCompression;
+    jobParams.attachDictPref = params.attachDictPref;
 
     return jobParams;
 }